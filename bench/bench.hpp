@@ -0,0 +1,85 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <entwine/third/json/json.hpp>
+
+namespace entwine
+{
+namespace bench
+{
+
+// Perform an operation _n_ times, returning the number of items processed,
+// which may differ from _n_ if each operation handles many items.  Anything
+// that should not be timed belongs in the Setup that produced this function.
+typedef std::function<std::size_t(std::size_t n)> Run;
+typedef std::function<Run()> Setup;
+
+class Suite
+{
+public:
+    Suite();
+
+    void add(std::string name, Setup setup);
+
+    // Run each benchmark whose name contains _filter_.  Each is repeated
+    // until a single sample lasts at least _minSeconds_, and the median of
+    // _samples_ samples is reported.
+    void run(
+            const std::string& filter,
+            double minSeconds,
+            std::size_t samples) const;
+
+    // Optional path of a pre-built index, for benchmarks that read one.
+    void index(std::string path) { m_index = path; }
+    const std::string& index() const { return m_index; }
+
+private:
+    struct Entry
+    {
+        Entry(std::string name, Setup setup) : name(name), setup(setup) { }
+
+        std::string name;
+        Setup setup;
+    };
+
+    std::vector<Entry> m_entries;
+    std::string m_index;
+};
+
+void addClimber(Suite& suite);
+void addRegistry(Suite& suite);
+void addTube(Suite& suite);
+void addCompression(Suite& suite);
+void addChunkReader(Suite& suite);
+void addQuery(Suite& suite);
+void addHierarchy(Suite& suite);
+void addSplicePool(Suite& suite);
+
+// Drive pooled GETs and PUTs, and completed and failed S3 multipart uploads,
+// against a local stand-in server.  Fails if kept-alive connections are not
+// reused, or if a failed upload is left behind.
+void addHttp(Suite& suite);
+
+// Build an index from synthetic sources beneath _options.dir_, then replay a
+// fixed mix of queries against it.  Returns build throughput, output size,
+// peak memory, and query latency percentiles.  Options are "distribution",
+// "points", "files", "threads", "queries", and "cacheSize".
+Json::Value endToEnd(const Json::Value& options);
+
+} // namespace bench
+} // namespace entwine
+
@@ -0,0 +1,172 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include "bench.hpp"
+#include "fixtures.hpp"
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <entwine/compression/util.hpp>
+#include <entwine/reader/chunk-reader.hpp>
+#include <entwine/tree/chunk.hpp>
+
+namespace entwine
+{
+namespace bench
+{
+
+namespace
+{
+    // Roughly the size of a cold chunk.
+    const std::size_t chunkPoints(1 << 16);
+
+    // The depth of the first cold chunks with the default structure.
+    const std::size_t chunkDepth(10);
+
+    struct CompressionState
+    {
+        explicit CompressionState(const Schema& schema)
+            : schema(schema)
+            , bbox(bench::bbox())
+            , data(pack(schema, points(bbox, chunkPoints)))
+            , compressed(*Compression::compress(data, schema))
+        {
+            Chunk::pushTail(
+                    compressed,
+                    Chunk::Tail(chunkPoints, Chunk::Contiguous));
+        }
+
+        // Without the tail, as stored by Compression alone.
+        std::vector<char> raw() const
+        {
+            return std::vector<char>(
+                    compressed.begin(),
+                    compressed.end() - sizeof(uint64_t) - 1);
+        }
+
+        const Schema schema;
+        const BBox bbox;
+        const std::vector<char> data;
+        std::vector<char> compressed;
+    };
+
+    void addSchema(Suite& suite, const std::string name, const Schema& s)
+    {
+        auto schema(std::make_shared<Schema>(s));
+
+        suite.add("Compression::compress/" + name, [schema]()
+        {
+            auto state(std::make_shared<CompressionState>(*schema));
+
+            return Run([state](std::size_t n)
+            {
+                for (std::size_t i(0); i < n; ++i)
+                {
+                    Compression::compress(state->data, state->schema);
+                }
+
+                return n * chunkPoints;
+            });
+        });
+
+        suite.add("Compression::decompress/" + name, [schema]()
+        {
+            auto state(std::make_shared<CompressionState>(*schema));
+            auto raw(std::make_shared<std::vector<char>>(state->raw()));
+
+            return Run([state, raw](std::size_t n)
+            {
+                for (std::size_t i(0); i < n; ++i)
+                {
+                    Compression::decompress(*raw, state->schema, chunkPoints);
+                }
+
+                return n * chunkPoints;
+            });
+        });
+    }
+}
+
+void addCompression(Suite& suite)
+{
+    addSchema(suite, "xyz", xyzSchema());
+    addSchema(suite, "las", lasSchema());
+}
+
+void addChunkReader(Suite& suite)
+{
+    suite.add("ChunkReader::ChunkReader", []()
+    {
+        auto state(std::make_shared<CompressionState>(lasSchema()));
+
+        return Run([state](std::size_t n)
+        {
+            for (std::size_t i(0); i < n; ++i)
+            {
+                ChunkReader reader(
+                        state->schema,
+                        state->bbox,
+                        Id(0),
+                        chunkDepth,
+                        state->compressed.data(),
+                        state->compressed.size());
+            }
+
+            return n * chunkPoints;
+        });
+    });
+
+    suite.add("ChunkReader::candidates", []()
+    {
+        auto state(std::make_shared<CompressionState>(lasSchema()));
+        auto reader(
+                std::make_shared<ChunkReader>(
+                    state->schema,
+                    state->bbox,
+                    Id(0),
+                    chunkDepth,
+                    state->compressed.data(),
+                    state->compressed.size()));
+
+        auto qboxes(std::make_shared<std::vector<BBox>>());
+
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<double> corner(0, 896);
+
+        for (std::size_t i(0); i < 256; ++i)
+        {
+            const Point min(corner(gen), corner(gen), corner(gen));
+            const Point max(min.x + 128, min.y + 128, min.z + 128);
+            qboxes->emplace_back(min, max, true);
+        }
+
+        return Run([state, reader, qboxes](std::size_t n)
+        {
+            Cycle<BBox> cycle(*qboxes);
+            std::size_t items(0);
+
+            for (std::size_t i(0); i < n; ++i)
+            {
+                for (const auto& range : reader->candidates(cycle.next()))
+                {
+                    items += std::distance(range.begin, range.end);
+                }
+            }
+
+            return items;
+        });
+    });
+}
+
+} // namespace bench
+} // namespace entwine
+
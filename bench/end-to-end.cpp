@@ -0,0 +1,332 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include "bench.hpp"
+
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <entwine/reader/cache.hpp>
+#include <entwine/reader/query.hpp>
+#include <entwine/reader/query-stats.hpp>
+#include <entwine/reader/reader.hpp>
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/tree/builder.hpp>
+#include <entwine/tree/config-parser.hpp>
+#include <entwine/tree/manifest.hpp>
+#include <entwine/types/bbox.hpp>
+#include <entwine/types/dim-info.hpp>
+#include <entwine/types/schema.hpp>
+#include <entwine/util/synthetic.hpp>
+
+namespace entwine
+{
+namespace bench
+{
+
+namespace
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    double secondsSince(const Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    std::size_t peakRss()
+    {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss * 1024;  // Reported in kilobytes on Linux.
+    }
+
+    // Total size of the regular files beneath _dir_.
+    std::size_t diskUsage(const std::string& dir)
+    {
+        std::size_t bytes(0);
+
+        if (DIR* d = opendir(dir.c_str()))
+        {
+            while (dirent* entry = readdir(d))
+            {
+                const std::string name(entry->d_name);
+                if (name == "." || name == "..") continue;
+
+                const std::string path(dir + "/" + name);
+                struct stat s;
+
+                if (stat(path.c_str(), &s) == 0)
+                {
+                    if (S_ISDIR(s.st_mode)) bytes += diskUsage(path);
+                    else if (S_ISREG(s.st_mode)) bytes += s.st_size;
+                }
+            }
+
+            closedir(d);
+        }
+
+        return bytes;
+    }
+
+    Json::Value percentiles(std::vector<double> ms)
+    {
+        Json::Value json;
+        if (ms.empty()) return json;
+
+        std::sort(ms.begin(), ms.end());
+
+        auto at([&ms](const double p)
+        {
+            return ms[std::min<std::size_t>(ms.size() * p, ms.size() - 1)];
+        });
+
+        json["count"] = static_cast<Json::UInt64>(ms.size());
+        json["p50"] = at(0.50);
+        json["p99"] = at(0.99);
+        json["max"] = ms.back();
+        return json;
+    }
+
+    // The dimensions of a synthetic source, plus an origin.
+    Schema syntheticSchema()
+    {
+        DimList dims;
+        dims.emplace_back("X", "floating", 8);
+        dims.emplace_back("Y", "floating", 8);
+        dims.emplace_back("Z", "floating", 8);
+        dims.emplace_back("Intensity", "unsigned", 2);
+        dims.emplace_back("Classification", "unsigned", 1);
+        dims.emplace_back("Origin", "unsigned", 4);
+        return Schema(dims);
+    }
+
+    // A named kind of query, selecting a random window covering _fraction_
+    // of the XY extents down to _depthEnd_ (zero for all depths).
+    struct QueryType
+    {
+        QueryType(std::string name, double fraction, std::size_t depthEnd)
+            : name(name)
+            , fraction(fraction)
+            , depthEnd(depthEnd)
+        { }
+
+        std::string name;
+        double fraction;
+        std::size_t depthEnd;
+    };
+}
+
+Json::Value endToEnd(const Json::Value& options)
+{
+    const std::string dir(
+            arbiter::fs::expandTilde(options["dir"].asString()));
+    const std::string outPath(dir + "/out");
+
+    const Synthetic::Distribution distribution(
+            Synthetic::toDistribution(options["distribution"].asString()));
+    const std::size_t numPoints(options["points"].asUInt64());
+    const std::size_t numFiles(std::max<Json::UInt64>(
+                options["files"].asUInt64(), 1));
+    const std::size_t numQueries(options["queries"].asUInt64());
+
+    if (diskUsage(outPath))
+    {
+        throw std::runtime_error("Output directory is not empty: " + outPath);
+    }
+
+    if (!arbiter::fs::mkdirp(dir + "/input"))
+    {
+        throw std::runtime_error("Could not create " + dir + "/input");
+    }
+
+    auto arbiter(std::make_shared<arbiter::Arbiter>());
+
+    // Each file is an independently generated tile, one slab of X each.
+    const BBox bounds(Point(0, 0, 0), Point(16384, 16384, 1024), true);
+    const double slab(bounds.width() / numFiles);
+
+    Json::Value json;
+
+    for (std::size_t i(0); i < numFiles; ++i)
+    {
+        const BBox tile(
+                Point(bounds.min().x + slab * i, bounds.min().y, 0),
+                Point(bounds.min().x + slab * (i + 1), bounds.max().y, 1024),
+                true);
+
+        const Synthetic synthetic(
+                distribution,
+                numPoints / numFiles + (i < numPoints % numFiles ? 1 : 0),
+                tile,
+                i);
+
+        const std::string path(
+                dir + "/input/" + std::to_string(i) + ".synthetic");
+
+        arbiter->put(path, synthetic.toJson().toStyledString());
+        json["input"]["manifest"].append(path);
+    }
+
+    // With the bounds, schema, and point count given, no inference is run.
+    json["input"]["threads"] = options["threads"];
+    json["input"]["trustHeaders"] = true;
+
+    json["output"]["path"] = outPath;
+    json["output"]["tmp"] = dir + "/tmp";
+    json["output"]["compress"] = true;
+    json["output"]["force"] = true;
+
+    json["structure"]["numPointsHint"] = static_cast<Json::UInt64>(numPoints);
+    json["structure"]["nullDepth"] = 6;
+    json["structure"]["baseDepth"] = 10;
+    json["structure"]["pointsPerChunk"] = 262144;
+    json["structure"]["dynamicChunks"] = true;
+    json["structure"]["type"] = "hybrid";
+    json["structure"]["prefixIds"] = false;
+
+    json["geometry"]["bbox"] = bounds.toJson();
+    json["geometry"]["schema"] = syntheticSchema().toJson();
+
+    Json::Value results;
+    results["input"]["distribution"] = Synthetic::toString(distribution);
+    results["input"]["points"] = static_cast<Json::UInt64>(numPoints);
+    results["input"]["files"] = static_cast<Json::UInt64>(numFiles);
+
+    {
+        std::unique_ptr<Builder> builder(
+                ConfigParser::getBuilder(
+                    json,
+                    arbiter,
+                    ConfigParser::getManifest(json, *arbiter)));
+
+        std::cout << "Building " << numPoints << " points..." << std::endl;
+
+        const auto start(Clock::now());
+        builder->go();
+        const double seconds(secondsSince(start));
+
+        const std::size_t inserts(
+                builder->manifest().pointStats().inserts());
+
+        Json::Value& build(results["build"]);
+        build["seconds"] = seconds;
+        build["pointsInserted"] = static_cast<Json::UInt64>(inserts);
+        build["pointsPerSecond"] = inserts / seconds;
+        build["bytesWritten"] = static_cast<Json::UInt64>(diskUsage(outPath));
+        build["peakRss"] = static_cast<Json::UInt64>(peakRss());
+    }
+
+    // Replay a fixed mix of broad overviews and narrower, deeper windows
+    // against a cold cache.
+    arbiter::Endpoint endpoint(arbiter->getEndpoint(outPath));
+    Cache cache(options["cacheSize"].asUInt64());
+    cache.profile(true);
+    Reader reader(endpoint, cache);
+
+    const Structure& structure(reader.structure());
+    const BBox& full(reader.bboxConforming());
+
+    const std::vector<QueryType> types {
+        QueryType("overview", 1.0, structure.baseDepthBegin() + 2),
+        QueryType("window", 1.0 / 16.0, structure.coldDepthBegin() + 2),
+        QueryType("window", 1.0 / 16.0, structure.coldDepthBegin() + 2),
+        QueryType("detail", 1.0 / 256.0, 0),
+        QueryType("detail", 1.0 / 256.0, 0)
+    };
+
+    DimList xyz;
+    xyz.emplace_back("X", "floating", 8);
+    xyz.emplace_back("Y", "floating", 8);
+    xyz.emplace_back("Z", "floating", 8);
+    const Schema schema(xyz);
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> unit(0, 1);
+
+    std::vector<double> all;
+    std::map<std::string, std::vector<double>> byType;
+    std::size_t queriedPoints(0);
+    QueryStats totals;
+    std::vector<char> buffer;
+
+    std::cout << "Querying..." << std::endl;
+    const auto queryStart(Clock::now());
+
+    for (std::size_t i(0); i < numQueries; ++i)
+    {
+        const QueryType& type(types[i % types.size()]);
+
+        const double scale(std::sqrt(type.fraction));
+        const double w(full.width() * scale);
+        const double d(full.depth() * scale);
+
+        const Point min(
+                full.min().x + (full.width() - w) * unit(gen),
+                full.min().y + (full.depth() - d) * unit(gen),
+                full.min().z);
+        const Point max(min.x + w, min.y + d, full.max().z);
+
+        const auto start(Clock::now());
+
+        std::unique_ptr<Query> query(
+                reader.query(
+                    schema,
+                    BBox(min, max, true),
+                    0,
+                    type.depthEnd));
+
+        bool more(true);
+
+        while (more)
+        {
+            buffer.clear();
+            more = query->next(buffer);
+        }
+
+        const double ms(secondsSince(start) * 1000.0);
+
+        queriedPoints += query->numPoints();
+        totals.add(*query->stats());
+        all.push_back(ms);
+        byType[type.name].push_back(ms);
+    }
+
+    Json::Value& queries(results["query"]);
+    queries["seconds"] = secondsSince(queryStart);
+    queries["points"] = static_cast<Json::UInt64>(queriedPoints);
+    queries["latencyMs"] = percentiles(all);
+
+    for (const auto& p : byType)
+    {
+        queries["byType"][p.first] = percentiles(p.second);
+    }
+
+    queries["totals"] = totals.toJson();
+    queries["distributions"] = cache.queryStats();
+
+    results["peakRss"] = static_cast<Json::UInt64>(peakRss());
+
+    return results;
+}
+
+} // namespace bench
+} // namespace entwine
+
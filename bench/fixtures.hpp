@@ -0,0 +1,143 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include <pdal/PointRef.hpp>
+
+#include <entwine/types/bbox.hpp>
+#include <entwine/types/dim-info.hpp>
+#include <entwine/types/point.hpp>
+#include <entwine/types/pooled-point-table.hpp>
+#include <entwine/types/schema.hpp>
+#include <entwine/types/structure.hpp>
+
+namespace entwine
+{
+namespace bench
+{
+
+// Every benchmark draws its inputs from generators seeded with this value, so
+// repeated runs operate on identical data.
+const std::size_t seed(42);
+
+inline Schema xyzSchema()
+{
+    DimList dims;
+    dims.emplace_back("X", "floating", 8);
+    dims.emplace_back("Y", "floating", 8);
+    dims.emplace_back("Z", "floating", 8);
+    return Schema(dims);
+}
+
+// A typical LAS-derived schema.
+inline Schema lasSchema()
+{
+    DimList dims;
+    dims.emplace_back("X", "floating", 8);
+    dims.emplace_back("Y", "floating", 8);
+    dims.emplace_back("Z", "floating", 8);
+    dims.emplace_back("Intensity", "unsigned", 2);
+    dims.emplace_back("ReturnNumber", "unsigned", 1);
+    dims.emplace_back("NumberOfReturns", "unsigned", 1);
+    dims.emplace_back("Classification", "unsigned", 1);
+    dims.emplace_back("GpsTime", "floating", 8);
+    dims.emplace_back("Red", "unsigned", 2);
+    dims.emplace_back("Green", "unsigned", 2);
+    dims.emplace_back("Blue", "unsigned", 2);
+    dims.emplace_back("Origin", "unsigned", 4);
+    return Schema(dims);
+}
+
+// The defaults of the build kernel.
+inline Structure structure()
+{
+    return Structure(6, 10, 0, 262144, 2, 0, true, true, false, false);
+}
+
+inline BBox bbox()
+{
+    return BBox(Point(0, 0, 0), Point(1024, 1024, 1024), true);
+}
+
+inline std::vector<Point> points(const BBox& bbox, const std::size_t n)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> x(bbox.min().x, bbox.max().x);
+    std::uniform_real_distribution<double> y(bbox.min().y, bbox.max().y);
+    std::uniform_real_distribution<double> z(bbox.min().z, bbox.max().z);
+
+    std::vector<Point> results;
+    results.reserve(n);
+
+    for (std::size_t i(0); i < n; ++i)
+    {
+        results.emplace_back(x(gen), y(gen), z(gen));
+    }
+
+    return results;
+}
+
+// Pack points into the binary format of _schema_, filling non-spatial
+// dimensions with random values.
+inline std::vector<char> pack(
+        const Schema& schema,
+        const std::vector<Point>& points)
+{
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    std::vector<char> data(points.size() * schema.pointSize());
+    for (char& c : data) c = byte(gen);
+
+    BinaryPointTable table(schema);
+    pdal::PointRef pointRef(table, 0);
+
+    char* pos(data.data());
+
+    for (const Point& p : points)
+    {
+        table.setPoint(pos);
+        pointRef.setField(pdal::Dimension::Id::X, p.x);
+        pointRef.setField(pdal::Dimension::Id::Y, p.y);
+        pointRef.setField(pdal::Dimension::Id::Z, p.z);
+
+        pos += schema.pointSize();
+    }
+
+    return data;
+}
+
+// Iterate cyclically over a fixed set of inputs.
+template<typename T>
+class Cycle
+{
+public:
+    explicit Cycle(const std::vector<T>& values) : m_values(values), m_i(0) { }
+
+    const T& next()
+    {
+        const T& v(m_values[m_i]);
+        if (++m_i == m_values.size()) m_i = 0;
+        return v;
+    }
+
+private:
+    const std::vector<T>& m_values;
+    std::size_t m_i;
+};
+
+} // namespace bench
+} // namespace entwine
+
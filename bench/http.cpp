@@ -0,0 +1,665 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include "bench.hpp"
+#include "fixtures.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+
+namespace entwine
+{
+namespace bench
+{
+
+namespace
+{
+    const std::size_t concurrent(4);
+    const std::size_t objectSize(64 * 1024);
+
+    // Three parts at the S3 minimum part size, the last of them partial.
+    const std::size_t partSize(5 * 1024 * 1024);
+    const std::size_t multipartSize(partSize * 2 + partSize / 2);
+
+    std::string toLower(std::string s)
+    {
+        std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+        return s;
+    }
+
+    std::string etag(const std::vector<char>& data)
+    {
+        const std::string s(data.data(), data.size());
+        return "\"" + std::to_string(std::hash<std::string>()(s)) + "\"";
+    }
+
+    // Returns the text between each <_tag_> and </_tag_> in _xml_, in order.
+    std::vector<std::string> xmlValues(
+            const std::string& xml,
+            const std::string& tag)
+    {
+        std::vector<std::string> values;
+
+        const std::string open("<" + tag + ">");
+        const std::string close("</" + tag + ">");
+
+        std::size_t pos(xml.find(open));
+        while (pos != std::string::npos)
+        {
+            const std::size_t begin(pos + open.size());
+            const std::size_t end(xml.find(close, begin));
+            if (end == std::string::npos) break;
+
+            values.push_back(xml.substr(begin, end - begin));
+            pos = xml.find(open, end);
+        }
+
+        return values;
+    }
+
+    // A minimal HTTP/1.1 stand-in for an object store on the loopback
+    // interface.  It serves plain GETs and PUTs, and the initiate, part
+    // upload, complete, and abort calls of an S3 multipart upload, holding
+    // objects in memory.  Parts uploaded beneath "rejected/" after the first
+    // are refused.  Connections are kept alive between requests, and accepted
+    // connections are counted so that clients may check their reuse.
+    class LocalServer
+    {
+    public:
+        LocalServer()
+            : m_socket(::socket(AF_INET, SOCK_STREAM, 0))
+            , m_port(0)
+            , m_done(false)
+            , m_connections(0)
+            , m_requests(0)
+            , m_mutex()
+            , m_objects()
+            , m_uploads()
+            , m_nextUpload(0)
+            , m_clients()
+            , m_threads()
+            , m_acceptor()
+        {
+            if (m_socket < 0) throw std::runtime_error("Could not open socket");
+
+            sockaddr_in addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = 0;
+
+            socklen_t len(sizeof(addr));
+            sockaddr* raw(reinterpret_cast<sockaddr*>(&addr));
+
+            if (
+                    ::bind(m_socket, raw, len) ||
+                    ::listen(m_socket, 64) ||
+                    ::getsockname(m_socket, raw, &len))
+            {
+                ::close(m_socket);
+                throw std::runtime_error("Could not listen on loopback");
+            }
+
+            m_port = ntohs(addr.sin_port);
+            m_acceptor = std::thread([this]() { accept(); });
+        }
+
+        ~LocalServer()
+        {
+            m_done = true;
+            ::shutdown(m_socket, SHUT_RDWR);
+            ::close(m_socket);
+            m_acceptor.join();
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                for (const int client : m_clients)
+                {
+                    ::shutdown(client, SHUT_RDWR);
+                }
+            }
+
+            for (auto& t : m_threads) t.join();
+        }
+
+        std::string endpoint() const
+        {
+            return "http://127.0.0.1:" + std::to_string(m_port) + "/";
+        }
+
+        std::size_t connections() const { return m_connections; }
+        std::size_t requests() const { return m_requests; }
+
+        // The number of multipart uploads neither completed nor aborted.
+        std::size_t uploads() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_uploads.size();
+        }
+
+        std::vector<char> object(const std::string& path) const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it(m_objects.find(path));
+            return it != m_objects.end() ? it->second : std::vector<char>();
+        }
+
+    private:
+        struct Request
+        {
+            std::string method;
+            std::string path;
+            std::map<std::string, std::string> query;
+            std::map<std::string, std::string> headers;
+            std::vector<char> body;
+        };
+
+        struct Response
+        {
+            explicit Response(int code = 200, std::string body = "")
+                : code(code), body(body.begin(), body.end()), etag()
+            { }
+
+            int code;
+            std::vector<char> body;
+            std::string etag;
+        };
+
+        typedef std::map<std::size_t, std::vector<char>> Parts;
+
+        void accept()
+        {
+            while (!m_done)
+            {
+                const int client(::accept(m_socket, nullptr, nullptr));
+                if (client < 0) continue;
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_done)
+                {
+                    ::close(client);
+                    break;
+                }
+
+                ++m_connections;
+                m_clients.push_back(client);
+                m_threads.emplace_back([this, client]() { serve(client); });
+            }
+        }
+
+        void serve(const int client)
+        {
+            std::string buffer;
+            Request req;
+
+            while (read(client, buffer, req))
+            {
+                ++m_requests;
+                write(client, handle(req));
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_clients.erase(
+                    std::find(m_clients.begin(), m_clients.end(), client));
+            ::close(client);
+        }
+
+        // Reads one request from _client_ into _req_, leaving any bytes of
+        // the next request in _buffer_.  Returns false once the client has
+        // closed its connection.
+        bool read(const int client, std::string& buffer, Request& req)
+        {
+            std::vector<char> chunk(64 * 1024);
+            std::size_t end(0);
+
+            auto fill([&]()
+            {
+                const ssize_t n(::recv(client, chunk.data(), chunk.size(), 0));
+                if (n <= 0) return false;
+                buffer.append(chunk.data(), n);
+                return true;
+            });
+
+            while ((end = buffer.find("\r\n\r\n")) == std::string::npos)
+            {
+                if (!fill()) return false;
+            }
+
+            const std::string head(buffer.substr(0, end));
+            buffer.erase(0, end + 4);
+
+            req = Request();
+
+            std::size_t pos(head.find("\r\n"));
+            const std::string line(head.substr(0, pos));
+            const std::size_t a(line.find(' '));
+            const std::size_t b(line.find(' ', a + 1));
+            req.method = line.substr(0, a);
+
+            std::string target(line.substr(a + 1, b - a - 1));
+            const std::size_t q(target.find('?'));
+
+            if (q != std::string::npos)
+            {
+                std::string query(target.substr(q + 1) + "&");
+                target.erase(q);
+
+                std::size_t p(0);
+                while ((end = query.find('&', p)) != std::string::npos)
+                {
+                    const std::string keyVal(query.substr(p, end - p));
+                    const std::size_t eq(keyVal.find('='));
+
+                    if (!keyVal.empty())
+                    {
+                        req.query[keyVal.substr(0, eq)] =
+                            eq == std::string::npos ?
+                                "" : keyVal.substr(eq + 1);
+                    }
+
+                    p = end + 1;
+                }
+            }
+
+            req.path = target.substr(1);
+
+            while (pos != std::string::npos)
+            {
+                const std::size_t next(head.find("\r\n", pos + 2));
+                const std::string h(head.substr(pos + 2, next - pos - 2));
+                const std::size_t colon(h.find(':'));
+
+                if (colon != std::string::npos)
+                {
+                    std::size_t v(colon + 1);
+                    while (v < h.size() && h[v] == ' ') ++v;
+                    req.headers[toLower(h.substr(0, colon))] = h.substr(v);
+                }
+
+                pos = next;
+            }
+
+            if (toLower(req.headers["expect"]) == "100-continue")
+            {
+                send(client, "HTTP/1.1 100 Continue\r\n\r\n");
+            }
+
+            const std::size_t size(
+                    req.headers.count("content-length") ?
+                        std::stoul(req.headers["content-length"]) : 0);
+
+            while (buffer.size() < size)
+            {
+                if (!fill()) return false;
+            }
+
+            req.body.assign(buffer.begin(), buffer.begin() + size);
+            buffer.erase(0, size);
+
+            return true;
+        }
+
+        Response handle(const Request& req)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (req.method == "GET")
+            {
+                auto it(m_objects.find(req.path));
+                if (it == m_objects.end()) return Response(404);
+
+                Response res;
+                res.body = it->second;
+                return res;
+            }
+            else if (req.method == "PUT" && req.query.count("uploadId"))
+            {
+                auto it(m_uploads.find(req.query.at("uploadId")));
+                if (it == m_uploads.end()) return Response(404);
+
+                const std::size_t part(std::stoul(req.query.at("partNumber")));
+                const bool rejected(
+                        req.path.find("/rejected/") != std::string::npos);
+
+                if (rejected && part > 1)
+                {
+                    return Response(403, "<Error>Rejected</Error>");
+                }
+
+                it->second[part] = req.body;
+
+                Response res;
+                res.etag = etag(req.body);
+                return res;
+            }
+            else if (req.method == "PUT")
+            {
+                m_objects[req.path] = req.body;
+                return Response();
+            }
+            else if (req.method == "POST" && req.query.count("uploads"))
+            {
+                const std::string id(std::to_string(++m_nextUpload));
+                m_uploads[id] = Parts();
+
+                return Response(
+                        200,
+                        "<InitiateMultipartUploadResult>"
+                            "<Key>" + req.path + "</Key>"
+                            "<UploadId>" + id + "</UploadId>"
+                        "</InitiateMultipartUploadResult>");
+            }
+            else if (req.method == "POST" && req.query.count("uploadId"))
+            {
+                auto it(m_uploads.find(req.query.at("uploadId")));
+                if (it == m_uploads.end()) return Response(404);
+
+                return complete(req, it->second);
+            }
+            else if (req.method == "DELETE" && req.query.count("uploadId"))
+            {
+                if (!m_uploads.erase(req.query.at("uploadId")))
+                {
+                    return Response(404);
+                }
+
+                return Response(204);
+            }
+
+            return Response(400);
+        }
+
+        // Assemble the parts listed by a completion request, which must be
+        // numbered consecutively from one and carry the ETags returned when
+        // each part was uploaded.
+        Response complete(const Request& req, const Parts& parts)
+        {
+            const std::string xml(req.body.data(), req.body.size());
+            const auto numbers(xmlValues(xml, "PartNumber"));
+            const auto etags(xmlValues(xml, "ETag"));
+
+            if (numbers.size() != parts.size() || etags.size() != parts.size())
+            {
+                return Response(400, "<Error>Part count mismatch</Error>");
+            }
+
+            std::vector<char> data;
+
+            for (std::size_t i(0); i < numbers.size(); ++i)
+            {
+                auto part(parts.find(std::stoul(numbers[i])));
+
+                if (
+                        part == parts.end() ||
+                        part->first != i + 1 ||
+                        etag(part->second) != etags[i])
+                {
+                    return Response(400, "<Error>Invalid part</Error>");
+                }
+
+                const std::vector<char>& bytes(part->second);
+                data.insert(data.end(), bytes.begin(), bytes.end());
+            }
+
+            m_uploads.erase(req.query.at("uploadId"));
+            m_objects[req.path] = data;
+
+            return Response(200, "<CompleteMultipartUploadResult/>");
+        }
+
+        void write(const int client, const Response& res)
+        {
+            std::string head(
+                    "HTTP/1.1 " + std::to_string(res.code) +
+                    (res.code / 100 == 2 ? " OK" : " Error") + "\r\n" +
+                    "Content-Length: " + std::to_string(res.body.size()) +
+                    "\r\n");
+
+            if (!res.etag.empty()) head += "ETag: " + res.etag + "\r\n";
+            head += "\r\n";
+
+            send(client, head);
+            send(client, std::string(res.body.data(), res.body.size()));
+        }
+
+        void send(const int client, const std::string& data)
+        {
+            std::size_t sent(0);
+
+            while (sent < data.size())
+            {
+                const ssize_t n(
+                        ::send(
+                            client,
+                            data.data() + sent,
+                            data.size() - sent,
+                            MSG_NOSIGNAL));
+
+                if (n <= 0) return;
+                sent += n;
+            }
+        }
+
+        int m_socket;
+        int m_port;
+        std::atomic_bool m_done;
+        std::atomic_size_t m_connections;
+        std::atomic_size_t m_requests;
+
+        mutable std::mutex m_mutex;
+        std::map<std::string, std::vector<char>> m_objects;
+        std::map<std::string, Parts> m_uploads;
+        std::size_t m_nextUpload;
+
+        std::vector<int> m_clients;
+        std::vector<std::thread> m_threads;
+        std::thread m_acceptor;
+    };
+
+    struct HttpState
+    {
+        HttpState()
+            : server()
+            , source(config(server.endpoint()))
+        { }
+
+        static Json::Value config(const std::string& endpoint)
+        {
+            Json::Value json;
+            json["http"]["concurrent"] = static_cast<Json::UInt64>(concurrent);
+
+            json["s3"]["access"] = "bench";
+            json["s3"]["hidden"] = "bench";
+            json["s3"]["region"] = "us-east-1";
+            json["s3"]["endpoint"] = endpoint;
+            json["s3"]["multipartSize"] = static_cast<Json::UInt64>(partSize);
+            json["s3"]["multipartThreads"] = 2;
+            return json;
+        }
+
+        std::string path(const std::string name) const
+        {
+            return server.endpoint() + "bench/" + name;
+        }
+
+        // Pooled handles should each hold a single kept-alive connection, no
+        // matter how many requests have been made.
+        void checkReuse() const
+        {
+            if (server.connections() > concurrent)
+            {
+                throw std::runtime_error(
+                        std::to_string(server.connections()) +
+                        " connections for " +
+                        std::to_string(server.requests()) + " requests");
+            }
+        }
+
+        LocalServer server;
+        arbiter::Arbiter source;
+    };
+
+    std::vector<char> makeData(const std::size_t size)
+    {
+        std::mt19937 gen(seed);
+        std::uniform_int_distribution<int> dist(0, 255);
+
+        std::vector<char> data(size);
+        for (char& c : data) c = static_cast<char>(dist(gen));
+        return data;
+    }
+
+    // Perform _n_ operations spread across the pool's worth of threads,
+    // rethrowing the first error encountered, if any.
+    void inParallel(const std::size_t n, const std::function<void()>& op)
+    {
+        std::atomic_size_t next(0);
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::vector<std::thread> threads;
+
+        for (std::size_t i(0); i < concurrent; ++i)
+        {
+            threads.emplace_back([&]()
+            {
+                try
+                {
+                    while (next++ < n) op();
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!error) error = std::current_exception();
+                    next = n;
+                }
+            });
+        }
+
+        for (auto& t : threads) t.join();
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+void addHttp(Suite& suite)
+{
+    suite.add("Http::get/pooled", []()
+    {
+        auto state(std::make_shared<HttpState>());
+        const std::string path(state->path("get"));
+
+        auto data(std::make_shared<std::vector<char>>(makeData(objectSize)));
+        state->source.put(path, *data);
+
+        return Run([state, path, data](std::size_t n)
+        {
+            inParallel(n, [&]()
+            {
+                if (state->source.getBinary(path) != *data)
+                {
+                    throw std::runtime_error("GET returned the wrong data");
+                }
+            });
+
+            state->checkReuse();
+            return n * data->size();
+        });
+    });
+
+    suite.add("Http::put/pooled", []()
+    {
+        auto state(std::make_shared<HttpState>());
+        const std::string path(state->path("put"));
+        auto data(std::make_shared<std::vector<char>>(makeData(objectSize)));
+
+        return Run([state, path, data](std::size_t n)
+        {
+            inParallel(n, [&]() { state->source.put(path, *data); });
+
+            state->checkReuse();
+            return n * data->size();
+        });
+    });
+
+    suite.add("S3::put/multipart", []()
+    {
+        auto state(std::make_shared<HttpState>());
+        auto data(std::make_shared<std::vector<char>>(makeData(multipartSize)));
+
+        return Run([state, data](std::size_t n)
+        {
+            for (std::size_t i(0); i < n; ++i)
+            {
+                state->source.put("s3://bench/multipart", *data);
+
+                if (state->server.object("bench/multipart") != *data)
+                {
+                    throw std::runtime_error("Multipart upload was corrupted");
+                }
+            }
+
+            state->checkReuse();
+            return n * data->size();
+        });
+    });
+
+    suite.add("S3::put/multipart-abort", []()
+    {
+        auto state(std::make_shared<HttpState>());
+        auto data(std::make_shared<std::vector<char>>(makeData(multipartSize)));
+
+        return Run([state, data](std::size_t n)
+        {
+            for (std::size_t i(0); i < n; ++i)
+            {
+                bool failed(false);
+
+                try
+                {
+                    state->source.put("s3://bench/rejected/multipart", *data);
+                }
+                catch (arbiter::ArbiterError&)
+                {
+                    failed = true;
+                }
+
+                if (!failed || state->server.uploads())
+                {
+                    throw std::runtime_error("Failed upload was not aborted");
+                }
+            }
+
+            state->checkReuse();
+            return n * data->size();
+        });
+    });
+}
+
+} // namespace bench
+} // namespace entwine
+
@@ -0,0 +1,151 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include "bench.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace entwine;
+
+namespace
+{
+    std::string getUsageString()
+    {
+        return
+            "\tUsage: entwine-bench <options>\n"
+            "\tOptions:\n"
+
+            "\t-f <filter>\n"
+            "\t\tOnly run benchmarks whose names contain this string.\n\n"
+
+            "\t-m <seconds>\n"
+            "\t\tMinimum duration of each sample.  Default: 0.5.\n\n"
+
+            "\t-n <samples>\n"
+            "\t\tNumber of samples, of which the median is reported.\n"
+            "\t\tDefault: 5.\n\n"
+
+            "\t-i <index path>\n"
+            "\t\tAn existing index for the Query benchmarks, which are\n"
+            "\t\tskipped otherwise.\n\n"
+
+            "\t-e <directory>\n"
+            "\t\tInstead of the micro-benchmarks, build an index from\n"
+            "\t\tsynthetic data within this directory, run a fixed mix of\n"
+            "\t\tqueries against it, and print the results as JSON.  The\n"
+            "\t\tfollowing options apply only to this mode.\n\n"
+
+            "\t-d <distribution>\n"
+            "\t\tOne of uniform, terrain, urban, or clustered.\n"
+            "\t\tDefault: terrain.\n\n"
+
+            "\t-p <points>\n"
+            "\t\tTotal number of points.  Default: 4194304.\n\n"
+
+            "\t-s <files>\n"
+            "\t\tNumber of synthetic source files.  Default: 8.\n\n"
+
+            "\t-t <threads>\n"
+            "\t\tBuild threads.  Default: the number of hardware threads.\n\n"
+
+            "\t-q <queries>\n"
+            "\t\tNumber of queries to replay.  Default: 200.\n\n";
+    }
+
+    Json::UInt64 count(const std::string& arg)
+    {
+        return std::stoull(arg);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    std::string filter;
+    double minSeconds(0.5);
+    std::size_t samples(5);
+
+    bench::Suite suite;
+
+    Json::Value endToEnd;
+    endToEnd["distribution"] = "terrain";
+    endToEnd["points"] = 1 << 22;
+    endToEnd["files"] = 8;
+    endToEnd["threads"] = std::max(std::thread::hardware_concurrency(), 2u);
+    endToEnd["queries"] = 200;
+    endToEnd["cacheSize"] = 64;
+
+    try
+    {
+        std::size_t a(0);
+
+        while (a < args.size())
+        {
+            const std::string arg(args[a]);
+
+            if (arg == "-h" || arg == "--help")
+            {
+                std::cout << getUsageString() << std::flush;
+                return 0;
+            }
+            else if (a + 1 >= args.size())
+            {
+                throw std::runtime_error("Missing value for " + arg);
+            }
+            else if (arg == "-f") filter = args[++a];
+            else if (arg == "-m") minSeconds = std::stod(args[++a]);
+            else if (arg == "-n") samples = std::stoul(args[++a]);
+            else if (arg == "-i") suite.index(args[++a]);
+            else if (arg == "-e") endToEnd["dir"] = args[++a];
+            else if (arg == "-d") endToEnd["distribution"] = args[++a];
+            else if (arg == "-p") endToEnd["points"] = count(args[++a]);
+            else if (arg == "-s") endToEnd["files"] = count(args[++a]);
+            else if (arg == "-t") endToEnd["threads"] = count(args[++a]);
+            else if (arg == "-q") endToEnd["queries"] = count(args[++a]);
+            else throw std::runtime_error("Invalid argument: " + arg);
+
+            ++a;
+        }
+
+        if (endToEnd.isMember("dir"))
+        {
+            const Json::Value results(bench::endToEnd(endToEnd));
+            std::cout << results.toStyledString() << std::flush;
+            return 0;
+        }
+
+        bench::addClimber(suite);
+        bench::addRegistry(suite);
+        bench::addTube(suite);
+        bench::addCompression(suite);
+        bench::addChunkReader(suite);
+        bench::addQuery(suite);
+        bench::addHierarchy(suite);
+        bench::addSplicePool(suite);
+        bench::addHttp(suite);
+
+        suite.run(filter, minSeconds, std::max<std::size_t>(samples, 1));
+    }
+    catch (std::exception& e)
+    {
+        std::cout << "Encountered an error: " << e.what() << std::endl;
+        std::cout << getUsageString() << std::flush;
+        return 1;
+    }
+
+    return 0;
+}
+
@@ -0,0 +1,128 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include "bench.hpp"
+#include "fixtures.hpp"
+
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <entwine/reader/cache.hpp>
+#include <entwine/reader/query.hpp>
+#include <entwine/reader/reader.hpp>
+#include <entwine/third/arbiter/arbiter.hpp>
+
+namespace entwine
+{
+namespace bench
+{
+
+namespace
+{
+    struct QueryState
+    {
+        explicit QueryState(const std::string& path)
+            : source()
+            , endpoint(source.getEndpoint(path))
+            , cache(1024)
+            , reader(endpoint, cache)
+        { }
+
+        arbiter::Arbiter source;
+        arbiter::Endpoint endpoint;
+        Cache cache;
+        Reader reader;
+    };
+
+    // Query the central quarter of the index, transcoding each point into
+    // _schema_.  The first query warms the cache, so timed queries measure
+    // Query::processPoint rather than chunk fetches.
+    void addTranscode(
+            Suite& suite,
+            const std::string name,
+            const Schema& s,
+            const double scale)
+    {
+        auto schema(std::make_shared<Schema>(s));
+
+        suite.add("Query::processPoint/" + name, [&suite, schema, scale]()
+        {
+            if (suite.index().empty())
+            {
+                throw std::runtime_error("requires --index");
+            }
+
+            auto state(std::make_shared<QueryState>(suite.index()));
+            const BBox& full(state->reader.bboxConforming());
+
+            auto qbox(std::make_shared<BBox>(
+                        Point(
+                            full.min().x + full.width() / 4,
+                            full.min().y + full.depth() / 4,
+                            full.min().z),
+                        Point(
+                            full.max().x - full.width() / 4,
+                            full.max().y - full.depth() / 4,
+                            full.max().z),
+                        true));
+
+            const std::size_t depthEnd(
+                    state->reader.structure().coldDepthBegin() + 2);
+
+            auto query([state, schema, qbox, scale, depthEnd]()
+            {
+                std::unique_ptr<Query> q(
+                        state->reader.query(
+                            *schema,
+                            *qbox,
+                            0,
+                            depthEnd,
+                            scale,
+                            state->reader.bboxConforming().mid()));
+
+                std::vector<char> buffer;
+                bool more(true);
+
+                while (more)
+                {
+                    buffer.clear();
+                    more = q->next(buffer);
+                }
+
+                return q->numPoints();
+            });
+
+            query();
+
+            return Run([query](std::size_t n)
+            {
+                std::size_t items(0);
+                for (std::size_t i(0); i < n; ++i) items += query();
+                return items;
+            });
+        });
+    }
+}
+
+void addQuery(Suite& suite)
+{
+    DimList scaled;
+    scaled.emplace_back("X", "signed", 4);
+    scaled.emplace_back("Y", "signed", 4);
+    scaled.emplace_back("Z", "signed", 4);
+
+    addTranscode(suite, "native-xyz", xyzSchema(), 0);
+    addTranscode(suite, "scaled-int32", Schema(scaled), 0.01);
+}
+
+} // namespace bench
+} // namespace entwine
+
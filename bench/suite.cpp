@@ -0,0 +1,135 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include "bench.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+namespace entwine
+{
+namespace bench
+{
+
+namespace
+{
+    double secondsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        const auto end(std::chrono::high_resolution_clock::now());
+        return std::chrono::duration<double>(end - start).count();
+    }
+
+    struct Sample
+    {
+        Sample(double seconds, std::size_t n, std::size_t items)
+            : seconds(seconds), n(n), items(items)
+        { }
+
+        double nsPerOp() const { return seconds * 1e9 / n; }
+        double itemsPerSecond() const { return items / seconds; }
+
+        double seconds;
+        std::size_t n;
+        std::size_t items;
+    };
+
+    Sample time(const Run& run, const std::size_t n)
+    {
+        const auto start(std::chrono::high_resolution_clock::now());
+        const std::size_t items(run(n));
+        return Sample(secondsSince(start), n, items);
+    }
+}
+
+Suite::Suite()
+    : m_entries()
+    , m_index()
+{ }
+
+void Suite::add(const std::string name, const Setup setup)
+{
+    m_entries.emplace_back(name, setup);
+}
+
+void Suite::run(
+        const std::string& filter,
+        const double minSeconds,
+        const std::size_t samples) const
+{
+    std::cout <<
+        std::left << std::setw(40) << "Benchmark" <<
+        std::right << std::setw(16) << "ns/op" <<
+        std::setw(16) << "items/s" <<
+        std::setw(12) << "ops" << std::endl;
+
+    for (const Entry& entry : m_entries)
+    {
+        if (entry.name.find(filter) == std::string::npos) continue;
+
+        Run run;
+
+        try
+        {
+            run = entry.setup();
+        }
+        catch (std::exception& e)
+        {
+            std::cout << std::left << std::setw(40) << entry.name <<
+                "skipped: " << e.what() << std::endl;
+            continue;
+        }
+
+        // Grow the operation count until a single sample is long enough to
+        // be measured reliably.
+        std::size_t n(1);
+        Sample sample(time(run, n));
+
+        while (sample.seconds < minSeconds && n < (1ULL << 40))
+        {
+            const double ratio(
+                    sample.seconds > 0 ?
+                        minSeconds / sample.seconds * 1.2 : 10.0);
+
+            n = std::max<std::size_t>(
+                    n + 1,
+                    n * std::min(std::max(ratio, 1.5), 100.0));
+
+            sample = time(run, n);
+        }
+
+        std::vector<Sample> results(1, sample);
+        while (results.size() < samples) results.push_back(time(run, n));
+
+        std::sort(
+                results.begin(),
+                results.end(),
+                [](const Sample& a, const Sample& b)
+                {
+                    return a.nsPerOp() < b.nsPerOp();
+                });
+
+        const Sample& median(results[results.size() / 2]);
+
+        std::cout <<
+            std::left << std::setw(40) << entry.name <<
+            std::right << std::fixed << std::setprecision(1) <<
+            std::setw(16) << median.nsPerOp() <<
+            std::setprecision(0) <<
+            std::setw(16) << median.itemsPerSecond() <<
+            std::setw(12) << n << std::endl;
+    }
+}
+
+} // namespace bench
+} // namespace entwine
+
@@ -0,0 +1,360 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include "bench.hpp"
+#include "fixtures.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/tree/builder.hpp>
+#include <entwine/tree/cell.hpp>
+#include <entwine/tree/climber.hpp>
+#include <entwine/tree/clipper.hpp>
+#include <entwine/tree/hierarchy.hpp>
+#include <entwine/tree/manifest.hpp>
+#include <entwine/tree/point-info.hpp>
+#include <entwine/tree/registry.hpp>
+
+namespace entwine
+{
+namespace bench
+{
+
+namespace
+{
+    const std::size_t numPoints(1 << 16);
+
+    std::size_t numThreads()
+    {
+        return std::max<std::size_t>(std::thread::hardware_concurrency(), 2);
+    }
+
+    // Run _f(thread, count)_ on each of _threads_ threads, dividing _n_
+    // operations between them.
+    template<typename F>
+    void parallel(const std::size_t threads, const std::size_t n, F f)
+    {
+        std::vector<std::thread> workers;
+
+        for (std::size_t t(0); t < threads; ++t)
+        {
+            const std::size_t count(n / threads + (t < n % threads ? 1 : 0));
+            workers.emplace_back([&f, t, count]() { f(t, count); });
+        }
+
+        for (auto& w : workers) w.join();
+    }
+
+    struct RegistryState
+    {
+        RegistryState()
+            : schema(lasSchema())
+            , structure(bench::structure())
+            , tmp(arbiter::fs::getTempPath() + "/entwine-bench")
+            , builder(
+                    new Builder(
+                        std::unique_ptr<Manifest>(
+                            new Manifest(std::vector<std::string>())),
+                        tmp + "/out",
+                        tmp + "/tmp",
+                        true,
+                        true,
+                        nullptr,
+                        nullptr,
+                        bench::bbox(),
+                        schema,
+                        numThreads(),
+                        structure))
+            , endpoint(new arbiter::Endpoint(
+                        builder->arbiter().getEndpoint(tmp + "/out")))
+            , registry(new Registry(*endpoint, *builder, 1))
+            , hierarchy(new Hierarchy(builder->bbox(), builder->nodePool()))
+            , points(bench::points(builder->bboxConforming(), numPoints))
+            , data(pack(schema, points))
+        { }
+
+        // Insert _count_ points, starting at _offset_ and striding by
+        // _stride_, with storage acquired from the pool as the Builder would.
+        // Points are kept within the base depths so no cold chunks are
+        // created.
+        void insert(
+                const std::size_t offset,
+                const std::size_t stride,
+                const std::size_t count)
+        {
+            PointPool& pointPool(builder->pointPool());
+            const std::size_t pointSize(schema.pointSize());
+
+            Shard shard(hierarchy->shard());
+            Climber climber(builder->bbox(), structure, shard.get());
+            Clipper clipper(*builder, 0);
+
+            for (std::size_t n(0); n < count; ++n)
+            {
+                const std::size_t i((offset + n * stride) % points.size());
+                const Point& point(points[i]);
+
+                PooledDataNode dataNode(pointPool.dataPool().acquireOne());
+                const char* pos(data.data() + i * pointSize);
+                std::copy(pos, pos + pointSize, dataNode->val());
+
+                PooledInfoNode info(
+                        pointPool.infoPool().acquireOne(
+                            point,
+                            std::move(dataNode)));
+
+                climber.reset();
+                climber.magnifyTo(point, structure.baseDepthBegin());
+
+                registry->addPoint(
+                        info,
+                        climber,
+                        clipper,
+                        structure.baseDepthEnd());
+            }
+        }
+
+        Schema schema;
+        Structure structure;
+        std::string tmp;
+
+        std::unique_ptr<Builder> builder;
+        std::unique_ptr<arbiter::Endpoint> endpoint;
+        std::unique_ptr<Registry> registry;
+        std::unique_ptr<Hierarchy> hierarchy;
+
+        std::vector<Point> points;
+        std::vector<char> data;
+    };
+}
+
+void addClimber(Suite& suite)
+{
+    suite.add("Climber::magnify/depth-20", []()
+    {
+        auto state(std::make_shared<std::vector<Point>>(
+                    points(bench::bbox(), numPoints)));
+        auto structure(std::make_shared<Structure>(bench::structure()));
+        auto bbox(std::make_shared<BBox>(bench::bbox()));
+
+        return Run([state, structure, bbox](std::size_t n)
+        {
+            Climber climber(*bbox, *structure);
+            Cycle<Point> cycle(*state);
+
+            for (std::size_t i(0); i < n; ++i)
+            {
+                const Point& p(cycle.next());
+                climber.reset();
+                for (std::size_t d(0); d < 20; ++d) climber.magnify(p);
+            }
+
+            return n * 20;
+        });
+    });
+
+    suite.add("Climber::magnifyTo/base", []()
+    {
+        auto state(std::make_shared<std::vector<Point>>(
+                    points(bench::bbox(), numPoints)));
+        auto structure(std::make_shared<Structure>(bench::structure()));
+        auto bbox(std::make_shared<BBox>(bench::bbox()));
+
+        return Run([state, structure, bbox](std::size_t n)
+        {
+            Climber climber(*bbox, *structure);
+            Cycle<Point> cycle(*state);
+
+            for (std::size_t i(0); i < n; ++i)
+            {
+                climber.reset();
+                climber.magnifyTo(cycle.next(), structure->baseDepthBegin());
+            }
+
+            return n;
+        });
+    });
+}
+
+void addRegistry(Suite& suite)
+{
+    auto add([&suite](const std::size_t threads)
+    {
+        suite.add(
+                "Registry::addPoint/threads-" + std::to_string(threads),
+                [threads]()
+        {
+            auto state(std::make_shared<RegistryState>());
+
+            // Fill the base once, so that timed insertions see a steady
+            // state of comparisons and swaps rather than an empty tree.
+            parallel(threads, numPoints, [&](std::size_t t, std::size_t c)
+            {
+                state->insert(t, threads, c);
+            });
+
+            return Run([state, threads](std::size_t n)
+            {
+                parallel(threads, n, [&](std::size_t t, std::size_t c)
+                {
+                    state->insert(t, threads, c);
+                });
+
+                return n;
+            });
+        });
+    });
+
+    add(1);
+    add(numThreads());
+}
+
+void addTube(Suite& suite)
+{
+    suite.add("Tube::getCell", []()
+    {
+        auto tube(std::make_shared<Tube>());
+        auto ticks(std::make_shared<std::vector<std::size_t>>());
+
+        std::mt19937 gen(seed);
+        std::uniform_int_distribution<std::size_t> tick(0, 63);
+
+        for (std::size_t i(0); i < 4096; ++i) ticks->push_back(tick(gen));
+
+        return Run([tube, ticks](std::size_t n)
+        {
+            Cycle<std::size_t> cycle(*ticks);
+            for (std::size_t i(0); i < n; ++i) tube->getCell(cycle.next());
+            return n;
+        });
+    });
+}
+
+void addHierarchy(Suite& suite)
+{
+    suite.add("Hierarchy::query/depth-6-16", []()
+    {
+        struct State
+        {
+            State()
+                : bbox(bench::bbox())
+                , structure(bench::structure())
+                , nodePool()
+                , hierarchy(bbox, nodePool)
+                , qboxes()
+            {
+                Climber climber(bbox, structure, &hierarchy);
+
+                for (const Point& p : points(bbox, numPoints))
+                {
+                    climber.reset();
+
+                    for (std::size_t d(0); d < 16; ++d)
+                    {
+                        climber.magnify(p);
+                        climber.count();
+                    }
+                }
+
+                std::mt19937 gen(seed);
+                std::uniform_real_distribution<double> corner(0, 768);
+
+                for (std::size_t i(0); i < 64; ++i)
+                {
+                    const Point min(corner(gen), corner(gen), 0);
+                    const Point max(min.x + 256, min.y + 256, 1024);
+                    qboxes.emplace_back(min, max, true);
+                }
+            }
+
+            BBox bbox;
+            Structure structure;
+            Node::NodePool nodePool;
+            Hierarchy hierarchy;
+            std::vector<BBox> qboxes;
+        };
+
+        auto state(std::make_shared<State>());
+
+        return Run([state](std::size_t n)
+        {
+            Cycle<BBox> cycle(state->qboxes);
+
+            for (std::size_t i(0); i < n; ++i)
+            {
+                state->hierarchy.query(cycle.next(), 6, 16);
+            }
+
+            return n;
+        });
+    });
+}
+
+void addSplicePool(Suite& suite)
+{
+    auto add([&suite](const std::size_t threads)
+    {
+        const std::string suffix("/threads-" + std::to_string(threads));
+
+        suite.add("SplicePool::acquireOne" + suffix, [threads]()
+        {
+            auto schema(std::make_shared<Schema>(lasSchema()));
+            auto pool(std::make_shared<PointPool>(*schema));
+
+            return Run([schema, pool, threads](std::size_t n)
+            {
+                parallel(threads, n, [&](std::size_t, std::size_t count)
+                {
+                    for (std::size_t i(0); i < count; ++i)
+                    {
+                        PooledInfoNode info(
+                                pool->infoPool().acquireOne(
+                                    Point(),
+                                    pool->dataPool().acquireOne()));
+                    }
+                });
+
+                return n;
+            });
+        });
+
+        suite.add("SplicePool::acquire-1024" + suffix, [threads]()
+        {
+            auto schema(std::make_shared<Schema>(lasSchema()));
+            auto pool(std::make_shared<PointPool>(*schema));
+
+            return Run([schema, pool, threads](std::size_t n)
+            {
+                parallel(threads, n, [&](std::size_t, std::size_t count)
+                {
+                    for (std::size_t i(0); i < count; ++i)
+                    {
+                        PooledDataStack stack(
+                                pool->dataPool().acquire(1024));
+                    }
+                });
+
+                return n * 1024;
+            });
+        });
+    });
+
+    add(1);
+    add(numThreads());
+}
+
+} // namespace bench
+} // namespace entwine
+
@@ -51,35 +51,46 @@ private:
     std::unique_ptr<std::vector<char>> m_data;
 };
 
+// Reads from a span of compressed bytes which must outlive the stream, so
+// that compressed data may be decompressed wherever it resides - for example
+// directly from a memory-mapped file.
 class DecompressionStream
 {
 public:
-    DecompressionStream(const std::vector<char>& data)
+    DecompressionStream(const char* data, std::size_t size)
         : m_data(data)
+        , m_size(size)
         , m_index(0)
     { }
 
+    DecompressionStream(const std::vector<char>& data)
+        : DecompressionStream(data.data(), data.size())
+    { }
+
     uint8_t getByte()
     {
-        const uint8_t val(reinterpret_cast<const uint8_t&>(m_data.at(m_index)));
+        if (m_index >= m_size)
+        {
+            throw std::out_of_range("Compressed data exhausted");
+        }
+
+        const uint8_t val(reinterpret_cast<const uint8_t&>(m_data[m_index]));
         ++m_index;
         return val;
     }
 
     void getBytes(uint8_t* bytes, std::size_t length)
     {
-        assert(m_index + length <= m_data.size());
+        assert(m_index + length <= m_size);
 
-        std::copy(
-                m_data.data() + m_index,
-                m_data.data() + m_index + length,
-                bytes);
+        std::copy(m_data + m_index, m_data + m_index + length, bytes);
 
         m_index += length;
     }
 
 private:
-    const std::vector<char>& m_data;
+    const char* m_data;
+    const std::size_t m_size;
     std::size_t m_index;
 };
 
@@ -45,10 +45,19 @@ std::unique_ptr<std::vector<char>> Compression::decompress(
         const std::vector<char>& data,
         const Schema& schema,
         const std::size_t numPoints)
+{
+    return decompress(data.data(), data.size(), schema, numPoints);
+}
+
+std::unique_ptr<std::vector<char>> Compression::decompress(
+        const char* data,
+        const std::size_t size,
+        const Schema& schema,
+        const std::size_t numPoints)
 {
     const std::size_t decompressedSize(numPoints * schema.pointSize());
 
-    DecompressionStream decompressionStream(data);
+    DecompressionStream decompressionStream(data, size);
     pdal::LazPerfDecompressor<DecompressionStream> decompressor(
             decompressionStream,
             schema.pdalLayout().dimTypes());
@@ -66,14 +75,29 @@ std::unique_ptr<std::vector<char>> Compression::decompress(
         const Schema& nativeSchema,
         const Schema* const wantedSchema,
         const std::size_t numPoints)
+{
+    return decompress(
+            data.data(),
+            data.size(),
+            nativeSchema,
+            wantedSchema,
+            numPoints);
+}
+
+std::unique_ptr<std::vector<char>> Compression::decompress(
+        const char* data,
+        const std::size_t size,
+        const Schema& nativeSchema,
+        const Schema* const wantedSchema,
+        const std::size_t numPoints)
 {
     if (!wantedSchema || *wantedSchema == nativeSchema)
     {
-        return decompress(data, nativeSchema, numPoints);
+        return decompress(data, size, nativeSchema, numPoints);
     }
 
     // Get decompressor in the native schema.
-    DecompressionStream decompressionStream(data);
+    DecompressionStream decompressionStream(data, size);
     pdal::LazPerfDecompressor<DecompressionStream> decompressor(
             decompressionStream,
             nativeSchema.pdalLayout().dimTypes());
@@ -83,6 +107,13 @@ std::unique_ptr<std::vector<char>> Compression::decompress(
     BinaryPointTable table(nativeSchema, nativePoint.data());
     pdal::PointRef pointRef(table, 0);
 
+    // If either schema is quantized, XYZ are converted through their real
+    // values rather than copied.
+    const bool requantize(
+            nativeSchema.quantized() || wantedSchema->quantized());
+    BinaryPointTable wantedTable(*wantedSchema);
+    pdal::PointRef wantedRef(wantedTable, 0);
+
     // Get our result space, in the desired schema, ready.
     std::unique_ptr<std::vector<char>> decompressed(
             new std::vector<char>(numPoints * wantedSchema->pointSize(), 0));
@@ -93,9 +124,19 @@ std::unique_ptr<std::vector<char>> Compression::decompress(
     {
         decompressor.decompress(nativePoint.data(), nativePoint.size());
 
+        if (requantize)
+        {
+            wantedTable.setPoint(pos);
+            wantedSchema->setPoint(wantedRef, nativeSchema.point(pointRef));
+        }
+
         for (const auto& d : wantedSchema->dims())
         {
-            pointRef.getField(pos, d.id(), d.type());
+            if (!requantize || !Schema::isXyz(d.id()))
+            {
+                pointRef.getField(pos, d.id(), d.type());
+            }
+
             pos += d.size();
         }
     }
@@ -107,6 +148,15 @@ PooledInfoStack Compression::decompress(
         const std::vector<char>& data,
         const std::size_t numPoints,
         PointPool& pointPool)
+{
+    return decompress(data.data(), data.size(), numPoints, pointPool);
+}
+
+PooledInfoStack Compression::decompress(
+        const char* data,
+        const std::size_t size,
+        const std::size_t numPoints,
+        PointPool& pointPool)
 {
     PooledDataStack dataStack(pointPool.dataPool().acquire(numPoints));
     PooledInfoStack infoStack(pointPool.infoPool().acquire(numPoints));
@@ -116,7 +166,7 @@ PooledInfoStack Compression::decompress(
 
     const std::size_t pointSize(pointPool.schema().pointSize());
 
-    DecompressionStream decompressionStream(data);
+    DecompressionStream decompressionStream(data, size);
     pdal::LazPerfDecompressor<DecompressionStream> decompressor(
             decompressionStream,
             pointPool.schema().pdalLayout().dimTypes());
@@ -132,7 +182,7 @@ PooledInfoStack Compression::decompress(
         decompressor.decompress(pos, pointSize);
 
         table.setPoint(pos);
-        info->val().point(pointRef);
+        info->val().point(pointPool.schema(), pointRef);
 
         info = info->next();
     }
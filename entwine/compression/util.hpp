@@ -42,6 +42,12 @@ public:
             const Schema& schema,
             std::size_t numPoints);
 
+    static std::unique_ptr<std::vector<char>> decompress(
+            const char* data,
+            std::size_t size,
+            const Schema& schema,
+            std::size_t numPoints);
+
     // If wantedSchema is nullptr, then the result will be in the native schema.
     static std::unique_ptr<std::vector<char>> decompress(
             const std::vector<char>& data,
@@ -49,10 +55,23 @@ public:
             const Schema* const wantedSchema,
             std::size_t numPoints);
 
+    static std::unique_ptr<std::vector<char>> decompress(
+            const char* data,
+            std::size_t size,
+            const Schema& nativeSchema,
+            const Schema* const wantedSchema,
+            std::size_t numPoints);
+
     static PooledInfoStack decompress(
             const std::vector<char>& data,
             std::size_t numPoints,
             PointPool& pointPool);
+
+    static PooledInfoStack decompress(
+            const char* data,
+            std::size_t size,
+            std::size_t numPoints,
+            PointPool& pointPool);
 };
 
 class Compressor
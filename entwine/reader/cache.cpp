@@ -11,21 +11,63 @@
 #include <entwine/reader/cache.hpp>
 
 #include <entwine/reader/chunk-reader.hpp>
+#include <entwine/tree/block-directory.hpp>
 #include <entwine/types/schema.hpp>
+#include <entwine/util/mapped-file.hpp>
+#include <entwine/util/metrics.hpp>
 #include <entwine/util/pool.hpp>
+#include <entwine/util/storage.hpp>
 
 namespace entwine
 {
 
+namespace
+{
+    // Queries are interactive, so give up on a chunk much sooner than a
+    // build would.
+    const std::size_t fetchRetries(4);
+
+    // When first reading the directory of a blocked chunk, also read this
+    // many bytes of the blocks just before it.
+    const std::size_t readahead(64 * 1024);
+
+    Gauge& activeChunks(
+            Metrics::gauge(
+                "entwine_cache_chunks_active",
+                "Cached chunks referenced by a running query"));
+
+    Gauge& idleChunks(
+            Metrics::gauge(
+                "entwine_cache_chunks_idle",
+                "Cached chunks not referenced by any query"));
+
+    Counter& hits(
+            Metrics::counter(
+                "entwine_cache_hits_total",
+                "Chunk fetches answered from the cache"));
+
+    Counter& misses(
+            Metrics::counter(
+                "entwine_cache_misses_total",
+                "Chunk fetches requiring a remote read"));
+
+    Counter& bytesFetched(
+            Metrics::counter(
+                "entwine_cache_fetched_bytes_total",
+                "Compressed chunk bytes read from remote storage"));
+}
+
 FetchInfo::FetchInfo(
         const Reader& reader,
         const Id& id,
         const Id& numPoints,
-        const std::size_t depth)
+        const std::size_t depth,
+        const BBox& qbox)
     : reader(reader)
     , id(id)
     , numPoints(numPoints)
     , depth(depth)
+    , qbox(qbox)
 { }
 
 Block::Block(
@@ -72,15 +114,20 @@ Cache::Cache(const std::size_t maxChunks)
     , m_activeCount(0)
     , m_mutex()
     , m_cv()
+    , m_profiling(false)
+    , m_queryHistograms()
 { }
 
 std::unique_ptr<Block> Cache::acquire(
         const std::string& readerPath,
-        const FetchInfoSet& fetches)
+        const FetchInfoSet& fetches,
+        QueryStats* stats)
 {
+    PhaseTimer timer(stats ? &stats->reserveSeconds : nullptr);
     std::unique_ptr<Block> block(reserve(readerPath, fetches));
+    timer.stop();
 
-    if (!populate(readerPath, fetches, *block))
+    if (!populate(readerPath, fetches, *block, stats))
     {
         throw std::runtime_error("Invalid remote index state: " + readerPath);
     }
@@ -124,10 +171,8 @@ void Cache::release(const Block& block)
         }
     }
 
-    std::cout <<
-        "\tActive size: " << m_activeCount <<
-        "\tIdle size: " << m_inactiveList.size() <<
-        "\tThis query: " << block.chunkMap().size() << std::endl;
+    activeChunks.set(m_activeCount);
+    idleChunks.set(m_inactiveList.size());
 
     if (notify)
     {
@@ -200,7 +245,8 @@ std::unique_ptr<Block> Cache::reserve(
 bool Cache::populate(
         const std::string& readerPath,
         const FetchInfoSet& fetches,
-        Block& block)
+        Block& block,
+        QueryStats* stats)
 {
     bool success(true);
     std::mutex mutex;
@@ -208,12 +254,17 @@ bool Cache::populate(
 
     for (const auto& f : fetches)
     {
-        pool.add([this, &readerPath, &f, &block, &mutex, &success]()->void
+        pool.add([this, &readerPath, &f, &block, &mutex, &success, stats]()
         {
-            if (const ChunkReader* chunkReader = fetch(readerPath, f))
+            std::unique_ptr<QueryStats> local(
+                    stats ? new QueryStats() : nullptr);
+
+            if (const ChunkReader* chunkReader =
+                    fetch(readerPath, f, local.get()))
             {
                 std::lock_guard<std::mutex> lock(mutex);
                 block.set(f.id, chunkReader);
+                if (stats) stats->add(*local);
             }
             else
             {
@@ -229,7 +280,8 @@ bool Cache::populate(
 
 const ChunkReader* Cache::fetch(
         const std::string& readerPath,
-        const FetchInfo& fetchInfo)
+        const FetchInfo& fetchInfo,
+        QueryStats* stats)
 {
     std::unique_lock<std::mutex> globalLock(m_mutex);
     ChunkState& chunkState(*m_chunkManager.at(readerPath).at(fetchInfo.id));
@@ -237,24 +289,211 @@ const ChunkReader* Cache::fetch(
 
     std::lock_guard<std::mutex> lock(chunkState.mutex);
 
+    const arbiter::Endpoint& endpoint(fetchInfo.reader.endpoint());
+    const std::string path(
+            fetchInfo.reader.structure().maybePrefix(fetchInfo.id));
+
+    std::size_t fetched(0);
+    bool miss(false);
+
     if (!chunkState.chunkReader)
     {
-        std::unique_ptr<std::vector<char>> rawData(
-                new std::vector<char>(
-                    fetchInfo.reader.endpoint().getSubpathBinary(
-                        fetchInfo.reader.structure().maybePrefix(
-                            fetchInfo.id))));
-
-        chunkState.chunkReader.reset(
-                new ChunkReader(
-                    fetchInfo.reader.schema(),
-                    fetchInfo.reader.bbox(),
-                    fetchInfo.id,
-                    fetchInfo.depth,
-                    std::move(rawData)));
+        PhaseTimer timer(stats ? &stats->fetchSeconds : nullptr);
+        miss = true;
+
+        const std::size_t blocks(fetchInfo.reader.structure().chunkBlocks());
+
+        // Local chunks are decompressed directly from a mapping of the file,
+        // rather than first being copied into memory.
+        std::unique_ptr<MappedFile> mapped(MappedFile::map(endpoint, path));
+        std::unique_ptr<std::vector<char>> rawData;
+
+        if (!mapped && blocks > 1)
+        {
+            // Read the directory of a blocked chunk, and speculatively the
+            // blocks just before it, so that only the blocks overlapping
+            // each query need to be fetched.
+            const std::size_t request(
+                    BlockDirectory::maxSize(blocks) + readahead);
+
+            rawData = Storage::getSuffix(
+                    endpoint, path, request, fetchRetries).get();
+            fetched += rawData->size();
+
+            const std::size_t dirSize(
+                    BlockDirectory::size(rawData->data(), rawData->size()));
+
+            if (!dirSize)
+            {
+                // Not blocked - if the suffix was truncated, then it is
+                // already the entire file.
+                if (rawData->size() == request)
+                {
+                    rawData = Storage::get(endpoint, path, fetchRetries).get();
+                    fetched += rawData->size();
+                }
+            }
+            else
+            {
+                if (dirSize > rawData->size())
+                {
+                    rawData = Storage::getSuffix(
+                            endpoint, path, dirSize, fetchRetries).get();
+                    fetched += rawData->size();
+                }
+
+                const char* end(rawData->data() + rawData->size());
+
+                std::unique_ptr<BlockDirectory> directory(
+                        new BlockDirectory(rawData->data(), rawData->size()));
+
+                const std::size_t fileSize(
+                        directory->blockBytes() + directory->bytes());
+                const std::size_t suffixBegin(fileSize - rawData->size());
+
+                std::unique_ptr<ChunkReader> chunkReader(
+                        new ChunkReader(
+                            fetchInfo.reader.schema(),
+                            fetchInfo.reader.bbox(),
+                            fetchInfo.id,
+                            fetchInfo.depth,
+                            std::move(directory)));
+
+                const auto& entries(chunkReader->directory()->entries());
+
+                for (std::size_t i(0); i < entries.size(); ++i)
+                {
+                    const auto& entry(entries[i]);
+
+                    if (entry.offset >= suffixBegin)
+                    {
+                        chunkReader->load(
+                                i,
+                                end - (fileSize - entry.offset),
+                                entry.size,
+                                stats);
+                    }
+                }
+
+                chunkState.chunkReader = std::move(chunkReader);
+            }
+        }
+        else if (!mapped)
+        {
+            rawData = Storage::get(endpoint, path, fetchRetries).get();
+            fetched += rawData->size();
+        }
+
+        timer.stop();
+
+        if (!chunkState.chunkReader)
+        {
+            const char* data(mapped ? mapped->data() : rawData->data());
+            const std::size_t size(mapped ? mapped->size() : rawData->size());
+
+            if (mapped) fetched += size;
+
+            chunkState.chunkReader.reset(
+                    new ChunkReader(
+                        fetchInfo.reader.schema(),
+                        fetchInfo.reader.bbox(),
+                        fetchInfo.id,
+                        fetchInfo.depth,
+                        data,
+                        size,
+                        stats));
+        }
+    }
+
+    ChunkReader& chunkReader(*chunkState.chunkReader);
+
+    if (const BlockDirectory* directory = chunkReader.directory())
+    {
+        const std::vector<std::size_t> missing(
+                chunkReader.missing(fetchInfo.qbox));
+
+        if (!missing.empty())
+        {
+            PhaseTimer timer(stats ? &stats->fetchSeconds : nullptr);
+            miss = true;
+
+            const auto& entries(directory->entries());
+
+            // Coalesce runs of adjacent blocks into single range requests.
+            typedef std::pair<std::size_t, std::size_t> Run;
+            std::vector<Run> runs;
+
+            for (const std::size_t i : missing)
+            {
+                if (runs.empty() || runs.back().second != i)
+                {
+                    runs.emplace_back(i, i);
+                }
+
+                ++runs.back().second;
+            }
+
+            std::vector<std::future<Storage::Data>> futures;
+
+            for (const Run& run : runs)
+            {
+                const auto& first(entries[run.first]);
+                const auto& last(entries[run.second - 1]);
+
+                futures.push_back(
+                        Storage::getRange(
+                            endpoint,
+                            path,
+                            first.offset,
+                            last.offset + last.size,
+                            fetchRetries));
+            }
+
+            for (std::size_t r(0); r < runs.size(); ++r)
+            {
+                Storage::Data data(futures[r].get());
+                fetched += data->size();
+
+                const std::size_t base(entries[runs[r].first].offset);
+
+                for (std::size_t i(runs[r].first); i < runs[r].second; ++i)
+                {
+                    const auto& entry(entries[i]);
+
+                    if (entry.offset + entry.size - base > data->size())
+                    {
+                        throw std::runtime_error(
+                                "Truncated block read at " + path);
+                    }
+
+                    chunkReader.load(
+                            i,
+                            data->data() + entry.offset - base,
+                            entry.size,
+                            stats);
+                }
+            }
+        }
+    }
+
+    if (miss)
+    {
+        misses.add();
+        bytesFetched.add(fetched);
+
+        if (stats)
+        {
+            ++stats->chunkMisses;
+            stats->bytesFetched += fetched;
+        }
+    }
+    else
+    {
+        hits.add();
+        if (stats) ++stats->chunkHits;
     }
 
-    return chunkState.chunkReader.get();
+    return &chunkReader;
 }
 
 } // namespace entwine
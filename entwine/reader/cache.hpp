@@ -20,6 +20,7 @@
 #include <set>
 #include <string>
 
+#include <entwine/reader/query-stats.hpp>
 #include <entwine/reader/reader.hpp>
 #include <entwine/types/structure.hpp>
 #include <entwine/third/arbiter/arbiter.hpp>
@@ -37,12 +38,16 @@ struct FetchInfo
             const Reader& reader,
             const Id& id,
             const Id& numPoints,
-            std::size_t depth);
+            std::size_t depth,
+            const BBox& qbox);
 
     const Reader& reader;
     const Id id;
     const Id numPoints;
     const std::size_t depth;
+
+    // Only the blocks of a blocked chunk which overlap this are fetched.
+    const BBox& qbox;
 };
 
 inline bool operator<(const FetchInfo& lhs, const FetchInfo& rhs)
@@ -120,9 +125,22 @@ class Cache
 public:
     Cache(std::size_t maxChunks);
 
+    // If _stats_ is non-null, the cache hits, misses, and time spent
+    // fetching the chunks of _fetches_ are added to it.
     std::unique_ptr<Block> acquire(
             const std::string& readerPath,
-            const FetchInfoSet& fetches);
+            const FetchInfoSet& fetches,
+            QueryStats* stats = nullptr);
+
+    // While profiling, each Query collects its own QueryStats, which are
+    // aggregated here when the query completes.
+    void profile(bool enable) { m_profiling = enable; }
+    bool profiling() const { return m_profiling; }
+
+    void record(const QueryStats& stats) { m_queryHistograms.observe(stats); }
+
+    // Histograms of the stats of all profiled queries.
+    Json::Value queryStats() const { return m_queryHistograms.toJson(); }
 
 private:
     void release(const Block& block);
@@ -134,11 +152,13 @@ private:
     bool populate(
             const std::string& readerPath,
             const FetchInfoSet& fetches,
-            Block& block);
+            Block& block,
+            QueryStats* stats);
 
     const ChunkReader* fetch(
             const std::string& readerPath,
-            const FetchInfo& fetchInfo);
+            const FetchInfo& fetchInfo,
+            QueryStats* stats);
 
     std::size_t m_maxChunks;
 
@@ -149,6 +169,9 @@ private:
 
     std::mutex m_mutex;
     std::condition_variable m_cv;
+
+    std::atomic_bool m_profiling;
+    QueryHistograms m_queryHistograms;
 };
 
 } // namespace entwine
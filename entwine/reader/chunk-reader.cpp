@@ -10,7 +10,11 @@
 
 #include <entwine/reader/chunk-reader.hpp>
 
+#include <stdexcept>
+
 #include <entwine/compression/util.hpp>
+#include <entwine/reader/query-stats.hpp>
+#include <entwine/tree/block-directory.hpp>
 #include <entwine/tree/chunk.hpp>
 #include <entwine/types/pooled-point-table.hpp>
 #include <entwine/types/schema.hpp>
@@ -23,50 +27,161 @@ ChunkReader::ChunkReader(
         const BBox& bbox,
         const Id& id,
         const std::size_t depth,
-        std::unique_ptr<std::vector<char>> compressed)
+        const char* compressed,
+        const std::size_t size,
+        QueryStats* stats)
     : m_schema(schema)
     , m_bbox(bbox)
     , m_id(id)
     , m_depth(depth)
-    , m_numPoints(Chunk::popTail(*compressed).numPoints)
-    , m_data()
+    , m_directory()
     , m_points()
 {
-    m_data = Compression::decompress(*compressed, m_schema, m_numPoints);
+    std::unique_ptr<std::vector<char>> data(new std::vector<char>());
+
+    PhaseTimer timer(stats ? &stats->decompressSeconds : nullptr);
+
+    const Chunk::Tail tail(
+            BlockDirectory::segments(
+                compressed,
+                size,
+                [this, &data](
+                    const char* segment,
+                    const std::size_t segmentSize,
+                    const std::size_t numPoints)
+                {
+                    auto block(
+                            Compression::decompress(
+                                segment,
+                                segmentSize,
+                                m_schema,
+                                numPoints));
+
+                    data->insert(data->end(), block->begin(), block->end());
+                }));
+
+    timer.stop();
+
+    if (tail.type == Chunk::Invalid)
+    {
+        throw std::runtime_error("Invalid chunk data at " + id.str());
+    }
+
+    m_points.push_back(index(std::move(data), stats));
+}
+
+ChunkReader::ChunkReader(
+        const Schema& schema,
+        const BBox& bbox,
+        const Id& id,
+        const std::size_t depth,
+        std::unique_ptr<BlockDirectory> directory)
+    : m_schema(schema)
+    , m_bbox(bbox)
+    , m_id(id)
+    , m_depth(depth)
+    , m_directory(std::move(directory))
+    , m_points(m_directory->entries().size())
+{ }
+
+ChunkReader::~ChunkReader() { }
+
+std::vector<std::size_t> ChunkReader::missing(const BBox& qbox) const
+{
+    std::vector<std::size_t> result;
+    if (!m_directory) return result;
+
+    const auto& entries(m_directory->entries());
+
+    for (std::size_t i(0); i < entries.size(); ++i)
+    {
+        if (!m_points[i] && entries[i].overlaps(qbox)) result.push_back(i);
+    }
+
+    return result;
+}
+
+void ChunkReader::load(
+        const std::size_t block,
+        const char* data,
+        const std::size_t size,
+        QueryStats* stats)
+{
+    const BlockDirectory::Entry& entry(m_directory->entries().at(block));
+
+    if (size != entry.size)
+    {
+        throw std::runtime_error("Invalid block size at " + m_id.str());
+    }
+
+    PhaseTimer timer(stats ? &stats->decompressSeconds : nullptr);
+    auto decompressed(
+            Compression::decompress(data, size, m_schema, entry.numPoints));
+    timer.stop();
+
+    m_points[block] = index(std::move(decompressed), stats);
+}
+
+std::unique_ptr<ChunkReader::Points> ChunkReader::index(
+        std::unique_ptr<std::vector<char>> data,
+        QueryStats* stats) const
+{
+    PhaseTimer timer(stats ? &stats->indexSeconds : nullptr);
+
+    std::unique_ptr<Points> result(new Points());
+    result->data = std::move(data);
 
     BinaryPointTable table(m_schema);
     pdal::PointRef pointRef(table, 0);
 
     const std::size_t pointSize(m_schema.pointSize());
-    char* pos(m_data->data());
+    const std::size_t numPoints(result->data->size() / pointSize);
+    char* pos(result->data->data());
     Point point;
 
-    for (std::size_t i(0); i < m_numPoints; ++i)
+    for (std::size_t i(0); i < numPoints; ++i)
     {
         table.setPoint(pos);
 
-        point.x = pointRef.getFieldAs<double>(pdal::Dimension::Id::X);
-        point.y = pointRef.getFieldAs<double>(pdal::Dimension::Id::Y);
-        point.z = pointRef.getFieldAs<double>(pdal::Dimension::Id::Z);
+        point = m_schema.point(pointRef);
 
-        m_points.emplace(
+        result->points.emplace(
                 std::piecewise_construct,
                 std::forward_as_tuple(Tube::calcTick(point, m_bbox, m_depth)),
                 std::forward_as_tuple(point, pos));
 
         pos += pointSize;
     }
+
+    return result;
 }
 
-ChunkReader::QueryRange ChunkReader::candidates(const BBox& qbox) const
+std::vector<ChunkReader::QueryRange> ChunkReader::candidates(
+        const BBox& qbox) const
 {
+    std::vector<QueryRange> ranges;
+
     const std::size_t minTick(Tube::calcTick(qbox.min(), m_bbox, m_depth));
     const std::size_t maxTick(Tube::calcTick(qbox.max(), m_bbox, m_depth));
 
-    It begin(m_points.lower_bound(minTick));
-    It end(m_points.upper_bound(maxTick));
+    for (std::size_t i(0); i < m_points.size(); ++i)
+    {
+        // Blocks which do not overlap the query may be loaded concurrently,
+        // so they must not be inspected.
+        if (m_directory && !m_directory->entries()[i].overlaps(qbox))
+        {
+            continue;
+        }
+
+        if (const Points* p = m_points[i].get())
+        {
+            ranges.emplace_back(
+                    p->points.lower_bound(minTick),
+                    p->points.upper_bound(maxTick));
+        }
+    }
 
-    return QueryRange(begin, end);
+    return ranges;
 }
 
 } // namespace entwine
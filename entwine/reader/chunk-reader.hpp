@@ -21,17 +21,33 @@ namespace entwine
 {
 
 class BBox;
+class BlockDirectory;
 class Schema;
+struct QueryStats;
 
 class ChunkReader
 {
 public:
+    // The serialized chunk in _data_ is only read during construction, so it
+    // may be released afterward.
     ChunkReader(
             const Schema& schema,
             const BBox& bbox,
             const Id& id,
             std::size_t depth,
-            std::unique_ptr<std::vector<char>> data);
+            const char* data,
+            std::size_t size,
+            QueryStats* stats = nullptr);
+
+    // Reads a blocked chunk incrementally, starting with none of its blocks.
+    ChunkReader(
+            const Schema& schema,
+            const BBox& bbox,
+            const Id& id,
+            std::size_t depth,
+            std::unique_ptr<BlockDirectory> directory);
+
+    ~ChunkReader();
 
     typedef std::multimap<uint64_t, PointInfoNonPooled>::const_iterator It;
 
@@ -43,10 +59,36 @@ public:
         It end;
     };
 
-    QueryRange candidates(const BBox& qbox) const;
+    // Every block overlapping _qbox_ must have been loaded.
+    std::vector<QueryRange> candidates(const BBox& qbox) const;
+
+    // Null unless this chunk is read incrementally.
+    const BlockDirectory* directory() const { return m_directory.get(); }
+
+    // Indices of the blocks overlapping _qbox_ which have not been loaded.
+    // This and load() must be serialized by the caller, but may run while
+    // other threads call candidates() with boxes whose blocks are loaded.
+    std::vector<std::size_t> missing(const BBox& qbox) const;
+
+    // Loads the compressed block at index _block_ of the directory.
+    void load(
+            std::size_t block,
+            const char* data,
+            std::size_t size,
+            QueryStats* stats = nullptr);
 
 private:
-    std::size_t numPoints() const { return m_points.size(); }
+    // The decompressed points of a chunk or block, indexed by tick.
+    struct Points
+    {
+        std::unique_ptr<std::vector<char>> data;
+        std::multimap<uint64_t, PointInfoNonPooled> points;
+    };
+
+    std::unique_ptr<Points> index(
+            std::unique_ptr<std::vector<char>> data,
+            QueryStats* stats) const;
+
     const Schema& schema() const { return m_schema; }
 
     std::size_t normalize(const Id& rawIndex) const
@@ -58,10 +100,12 @@ private:
     const BBox& m_bbox;
     const Id m_id;
     const std::size_t m_depth;
-    const std::size_t m_numPoints;
 
-    std::unique_ptr<std::vector<char>> m_data;
-    std::multimap<uint64_t, PointInfoNonPooled> m_points;
+    std::unique_ptr<BlockDirectory> m_directory;
+
+    // For a blocked chunk, one per directory entry, each of which is null
+    // until loaded.  Otherwise, a single entry holding the entire chunk.
+    std::vector<std::unique_ptr<Points>> m_points;
 };
 
 } // namespace entwine
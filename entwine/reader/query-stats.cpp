@@ -0,0 +1,166 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/reader/query-stats.hpp>
+
+#include <vector>
+
+namespace entwine
+{
+
+namespace
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    std::vector<double> ratios()
+    {
+        std::vector<double> bounds;
+        for (std::size_t i(0); i <= 10; ++i) bounds.push_back(i / 10.0);
+        return bounds;
+    }
+}
+
+QueryStats::QueryStats()
+    : chunkHits(0)
+    , chunkMisses(0)
+    , bytesFetched(0)
+    , pointsScanned(0)
+    , pointsReturned(0)
+    , planSeconds(0)
+    , baseSeconds(0)
+    , reserveSeconds(0)
+    , fetchSeconds(0)
+    , decompressSeconds(0)
+    , indexSeconds(0)
+    , scanSeconds(0)
+    , totalSeconds(0)
+{ }
+
+void QueryStats::add(const QueryStats& other)
+{
+    chunkHits += other.chunkHits;
+    chunkMisses += other.chunkMisses;
+    bytesFetched += other.bytesFetched;
+    pointsScanned += other.pointsScanned;
+    pointsReturned += other.pointsReturned;
+
+    planSeconds += other.planSeconds;
+    baseSeconds += other.baseSeconds;
+    reserveSeconds += other.reserveSeconds;
+    fetchSeconds += other.fetchSeconds;
+    decompressSeconds += other.decompressSeconds;
+    indexSeconds += other.indexSeconds;
+    scanSeconds += other.scanSeconds;
+    totalSeconds += other.totalSeconds;
+}
+
+double QueryStats::hitRatio() const
+{
+    const std::size_t touched(chunksTouched());
+    return touched ? chunkHits / static_cast<double>(touched) : 1.0;
+}
+
+Json::Value QueryStats::toJson() const
+{
+    Json::Value json;
+
+    json["chunks"]["touched"] = static_cast<Json::UInt64>(chunksTouched());
+    json["chunks"]["hits"] = static_cast<Json::UInt64>(chunkHits);
+    json["chunks"]["misses"] = static_cast<Json::UInt64>(chunkMisses);
+    json["bytesFetched"] = static_cast<Json::UInt64>(bytesFetched);
+    json["points"]["scanned"] = static_cast<Json::UInt64>(pointsScanned);
+    json["points"]["returned"] = static_cast<Json::UInt64>(pointsReturned);
+
+    Json::Value& seconds(json["seconds"]);
+    seconds["plan"] = planSeconds;
+    seconds["base"] = baseSeconds;
+    seconds["reserve"] = reserveSeconds;
+    seconds["fetch"] = fetchSeconds;
+    seconds["decompress"] = decompressSeconds;
+    seconds["index"] = indexSeconds;
+    seconds["scan"] = scanSeconds;
+    seconds["total"] = totalSeconds;
+
+    return json;
+}
+
+PhaseTimer::PhaseTimer(double* seconds)
+    : m_seconds(seconds)
+    , m_start(seconds ? Clock::now() : Clock::time_point())
+{ }
+
+PhaseTimer::~PhaseTimer()
+{
+    stop();
+}
+
+void PhaseTimer::stop()
+{
+    if (m_seconds)
+    {
+        *m_seconds += std::chrono::duration<double>(
+                Clock::now() - m_start).count();
+
+        m_seconds = nullptr;
+    }
+}
+
+QueryHistograms::QueryHistograms()
+    : m_histograms()
+{
+    auto add([this](const std::string name, std::vector<double> bounds)
+    {
+        m_histograms[name].reset(new Histogram(bounds));
+    });
+
+    add("totalSeconds", Histogram::seconds());
+    add("reserveSeconds", Histogram::seconds());
+    add("fetchSeconds", Histogram::seconds());
+    add("decompressSeconds", Histogram::seconds());
+    add("indexSeconds", Histogram::seconds());
+    add("scanSeconds", Histogram::seconds());
+
+    add("chunksTouched", Histogram::exponential(1, 2, 13));
+    add("hitRatio", ratios());
+    add("bytesFetched", Histogram::exponential(65536, 4, 10));
+    add("pointsScanned", Histogram::exponential(1000, 4, 12));
+    add("pointsReturned", Histogram::exponential(1000, 4, 12));
+}
+
+void QueryHistograms::observe(const QueryStats& stats)
+{
+    at("totalSeconds").observe(stats.totalSeconds);
+    at("reserveSeconds").observe(stats.reserveSeconds);
+    at("fetchSeconds").observe(stats.fetchSeconds);
+    at("decompressSeconds").observe(stats.decompressSeconds);
+    at("indexSeconds").observe(stats.indexSeconds);
+    at("scanSeconds").observe(stats.scanSeconds);
+
+    at("chunksTouched").observe(stats.chunksTouched());
+    at("hitRatio").observe(stats.hitRatio());
+    at("bytesFetched").observe(stats.bytesFetched);
+    at("pointsScanned").observe(stats.pointsScanned);
+    at("pointsReturned").observe(stats.pointsReturned);
+}
+
+Json::Value QueryHistograms::toJson() const
+{
+    Json::Value json;
+
+    for (const auto& p : m_histograms)
+    {
+        json[p.first] = p.second->toJson();
+    }
+
+    return json;
+}
+
+} // namespace entwine
+
@@ -0,0 +1,103 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <entwine/third/json/json.hpp>
+#include <entwine/util/metrics.hpp>
+
+namespace entwine
+{
+
+// Where the time and the data of a single query went.  Chunk fetches run on
+// multiple threads, so the fetch, decompress, and index times are summed
+// over those threads and may exceed the total.
+struct QueryStats
+{
+    QueryStats();
+
+    void add(const QueryStats& other);
+
+    Json::Value toJson() const;
+
+    std::size_t chunksTouched() const { return chunkHits + chunkMisses; }
+
+    // Fraction of touched chunks that were already cached.
+    double hitRatio() const;
+
+    // Chunks found in the cache, and chunks fetched from remote storage.
+    std::size_t chunkHits;
+    std::size_t chunkMisses;
+    std::size_t bytesFetched;
+
+    // Points examined against the query bounds, and points returned.
+    std::size_t pointsScanned;
+    std::size_t pointsReturned;
+
+    // Seconds spent selecting chunks, reading the base, waiting for cache
+    // capacity, fetching, decompressing, building chunk indices, and
+    // scanning and transcoding chunked points, respectively.
+    double planSeconds;
+    double baseSeconds;
+    double reserveSeconds;
+    double fetchSeconds;
+    double decompressSeconds;
+    double indexSeconds;
+    double scanSeconds;
+
+    // Wall time from query construction until completion.
+    double totalSeconds;
+};
+
+// Add the time from construction until stop() or destruction to _seconds_.
+// If _seconds_ is null, nothing is timed.
+class PhaseTimer
+{
+public:
+    explicit PhaseTimer(double* seconds);
+    ~PhaseTimer();
+
+    void stop();
+
+private:
+    double* m_seconds;
+    std::chrono::high_resolution_clock::time_point m_start;
+
+    PhaseTimer(const PhaseTimer&);
+    PhaseTimer& operator=(const PhaseTimer&);
+};
+
+// Distributions of QueryStats over many queries.
+class QueryHistograms
+{
+public:
+    QueryHistograms();
+
+    void observe(const QueryStats& stats);
+
+    Json::Value toJson() const;
+
+private:
+    Histogram& at(const std::string& name) { return *m_histograms.at(name); }
+
+    std::map<std::string, std::unique_ptr<Histogram>> m_histograms;
+
+    QueryHistograms(const QueryHistograms&);
+    QueryHistograms& operator=(const QueryHistograms&);
+};
+
+} // namespace entwine
+
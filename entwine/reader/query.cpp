@@ -23,7 +23,39 @@ namespace entwine
 
 namespace
 {
+    namespace DimId = pdal::Dimension::Id;
+
     std::size_t fetchesPerIteration(4);
+
+    double axis(const Point& p, const DimId::Enum id)
+    {
+        return id == DimId::X ? p.x : id == DimId::Y ? p.y : p.z;
+    }
+
+    double& axis(Point& p, const DimId::Enum id)
+    {
+        return id == DimId::X ? p.x : id == DimId::Y ? p.y : p.z;
+    }
+
+    // True if the stored values of an axis are already quantized with the
+    // requested _scale_ and _offset_, so they may be copied to 32-bit integer
+    // output without conversion.
+    bool direct(
+            const Schema& schema,
+            const DimId::Enum id,
+            const double scale,
+            const double offset)
+    {
+        const double indexScale(axis(schema.scale(), id));
+        const double indexOffset(axis(schema.offset(), id));
+
+        return
+            schema.pdalLayout().dimType(id) ==
+                pdal::Dimension::Type::Signed32 &&
+            (indexScale != 1.0 || indexOffset != 0.0) &&
+            indexScale == scale &&
+            indexOffset == offset;
+    }
 }
 
 Query::Query(
@@ -45,14 +77,41 @@ Query::Query(
     , m_block()
     , m_chunkReaderIt()
     , m_numPoints(0)
+    , m_stats(cache.profiling() ? new QueryStats() : nullptr)
+    , m_start(std::chrono::high_resolution_clock::now())
     , m_base(true)
     , m_done(false)
     , m_outSchema(schema)
-    , m_scale(scale)
-    , m_offset(offset)
+    , m_outScale(
+            scale ? scale : 1.0,
+            scale ? scale : 1.0,
+            scale ? scale : 1.0)
+    , m_outOffset(offset)
+    , m_directX(false)
+    , m_directY(false)
+    , m_directZ(false)
     , m_table(reader.schema())
     , m_pointRef(m_table, 0)
 {
+    // An output dimension's own scale and offset, if it has any, are applied
+    // after those of the query.
+    for (const auto& dim : m_outSchema.dims())
+    {
+        if (Schema::isXyz(dim.id()) && dim.isScaled())
+        {
+            double& s(axis(m_outScale, dim.id()));
+            axis(m_outOffset, dim.id()) += dim.offset() * s;
+            s *= dim.scale();
+        }
+    }
+
+    const Schema& indexSchema(reader.schema());
+    m_directX = direct(indexSchema, DimId::X, m_outScale.x, m_outOffset.x);
+    m_directY = direct(indexSchema, DimId::Y, m_outScale.y, m_outOffset.y);
+    m_directZ = direct(indexSchema, DimId::Z, m_outScale.z, m_outOffset.z);
+
+    PhaseTimer timer(m_stats ? &m_stats->planSeconds : nullptr);
+
     if (!m_depthEnd || m_depthEnd > m_structure.coldDepthBegin())
     {
         SplitClimber splitter(
@@ -77,7 +136,8 @@ Query::Query(
                             m_reader,
                             chunkId,
                             m_structure.getInfo(chunkId).chunkPoints(),
-                            splitter.depth()));
+                            splitter.depth(),
+                            m_qbox));
             }
             else
             {
@@ -107,17 +167,29 @@ bool Query::next(std::vector<char>& buffer)
         getChunked(buffer);
     }
 
+    if (m_done && m_stats)
+    {
+        m_stats->pointsReturned = m_numPoints;
+        m_stats->totalSeconds = std::chrono::duration<double>(
+                std::chrono::high_resolution_clock::now() - m_start).count();
+
+        m_cache.record(*m_stats);
+    }
+
     return !m_done;
 }
 
 bool Query::getBase(std::vector<char>& buffer)
 {
     bool dataExisted(false);
+    PhaseTimer timer(m_stats ? &m_stats->baseSeconds : nullptr);
+    std::size_t scanned(0);
 
+    // Check the depths first to avoid waking up the base unnecessarily.
     if (
-            m_reader.base() &&
             m_depthBegin < m_structure.baseDepthEnd() &&
-            m_depthEnd   > m_structure.baseDepthBegin())
+            m_depthEnd   > m_structure.baseDepthBegin() &&
+            m_reader.base())
     {
         const BaseChunk& base(*m_reader.base());
         bool terminate(false);
@@ -142,6 +214,8 @@ bool Query::getBase(std::vector<char>& buffer)
 
             if (!tube.empty())
             {
+                scanned += 1 + tube.secondaryCells().size();
+
                 if (
                         processPoint(
                             buffer,
@@ -168,6 +242,8 @@ bool Query::getBase(std::vector<char>& buffer)
         while (splitter.next(terminate));
     }
 
+    if (m_stats) m_stats->pointsScanned += scanned;
+
     return dataExisted;
 }
 
@@ -182,7 +258,10 @@ void Query::getChunked(std::vector<char>& buffer)
             std::advance(end, std::min(fetchesPerIteration, m_chunks.size()));
 
             FetchInfoSet subset(begin, end);
-            m_block = m_cache.acquire(m_reader.path(), subset);
+            m_block = m_cache.acquire(
+                    m_reader.path(),
+                    subset,
+                    m_stats.get());
             m_chunks.erase(begin, end);
 
             if (m_block) m_chunkReaderIt = m_block->chunkMap().begin();
@@ -193,15 +272,23 @@ void Query::getChunked(std::vector<char>& buffer)
     {
         if (const ChunkReader* cr = m_chunkReaderIt->second)
         {
-            ChunkReader::QueryRange range(cr->candidates(m_qbox));
-            auto it(range.begin);
+            PhaseTimer timer(m_stats ? &m_stats->scanSeconds : nullptr);
+            std::size_t scanned(0);
 
-            while (it != range.end)
+            for (const auto& range : cr->candidates(m_qbox))
             {
-                if (processPoint(buffer, it->second)) ++m_numPoints;
-                ++it;
+                auto it(range.begin);
+
+                while (it != range.end)
+                {
+                    if (processPoint(buffer, it->second)) ++m_numPoints;
+                    ++scanned;
+                    ++it;
+                }
             }
 
+            if (m_stats) m_stats->pointsScanned += scanned;
+
             if (++m_chunkReaderIt == m_block->chunkMap().end())
             {
                 m_block.reset();
@@ -232,15 +319,21 @@ bool Query::processPoint(std::vector<char>& buffer, const PointInfo& info)
             isY = dim.id() == pdal::Dimension::Id::Y;
             isZ = dim.id() == pdal::Dimension::Id::Z;
 
-            if (isX || isY || isZ)
+            if (
+                    ((isX && m_directX) ||
+                     (isY && m_directY) ||
+                     (isZ && m_directZ)) &&
+                    dim.type() == pdal::Dimension::Type::Signed32)
             {
-                double d(m_pointRef.getFieldAs<double>(dim.id()));
-
-                if (isX)        d -= m_offset.x;
-                else if (isY)   d -= m_offset.y;
-                else            d -= m_offset.z;
-
-                if (m_scale) d /= m_scale;
+                m_pointRef.getField(pos, dim.id(), dim.type());
+            }
+            else if (isX || isY || isZ)
+            {
+                // The point's real position, with any quantization undone.
+                const double d(
+                        (axis(info.point(), dim.id()) -
+                            axis(m_outOffset, dim.id())) /
+                        axis(m_outScale, dim.id()));
 
                 switch (dim.type())
                 {
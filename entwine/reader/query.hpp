@@ -10,10 +10,13 @@
 
 #pragma once
 
+#include <chrono>
 #include <cstddef>
 #include <deque>
+#include <memory>
 
 #include <entwine/reader/cache.hpp>
+#include <entwine/reader/query-stats.hpp>
 #include <entwine/reader/reader.hpp>
 #include <entwine/tree/climber.hpp>
 #include <entwine/types/point.hpp>
@@ -44,6 +47,10 @@ public:
     bool done() const { return m_done; }
     std::size_t numPoints() const { return m_numPoints; }
 
+    // Null unless the Cache was profiling when this query was created.  The
+    // stats are complete once done() is true.
+    const QueryStats* stats() const { return m_stats.get(); }
+
 protected:
     bool getBase(std::vector<char>& buffer); // True if base data existed.
     void getChunked(std::vector<char>& buffer);
@@ -72,12 +79,21 @@ protected:
 
     std::size_t m_numPoints;
 
+    std::unique_ptr<QueryStats> m_stats;
+    const std::chrono::high_resolution_clock::time_point m_start;
+
     bool m_base;
     bool m_done;
 
     const Schema& m_outSchema;
-    const double m_scale;
-    const Point m_offset;
+    // Per-axis scale and offset of the output.
+    Point m_outScale;
+    Point m_outOffset;
+
+    // Whether each axis may be copied as stored.
+    bool m_directX;
+    bool m_directY;
+    bool m_directZ;
 
     BinaryPointTable m_table;
     pdal::PointRef m_pointRef;
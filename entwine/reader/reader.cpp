@@ -15,6 +15,7 @@
 #include <entwine/reader/query.hpp>
 #include <entwine/third/arbiter/arbiter.hpp>
 #include <entwine/tree/chunk.hpp>
+#include <entwine/tree/chunk-ids.hpp>
 #include <entwine/tree/climber.hpp>
 #include <entwine/tree/builder.hpp>
 #include <entwine/tree/hierarchy.hpp>
@@ -25,6 +26,7 @@
 #include <entwine/types/schema.hpp>
 #include <entwine/types/structure.hpp>
 #include <entwine/types/subset.hpp>
+#include <entwine/util/mapped-file.hpp>
 
 namespace entwine
 {
@@ -51,26 +53,16 @@ Reader::Reader(
                 1,
                 nullptr,
                 nullptr,
-                outerScope))
-    , m_base()
+                outerScope,
+                true))
     , m_cache(cache)
-    , m_ids(m_builder->registry().ids())
-{
-
-    std::unique_ptr<std::vector<char>> data(
-            new std::vector<char>(
-                endpoint.getSubpathBinary(structure().baseIndexBegin().str())));
-
-    m_base.reset(
-            static_cast<BaseChunk*>(
-                Chunk::create(
-                    *m_builder,
-                    bbox(),
-                    0,
-                    structure().baseIndexBegin(),
-                    structure().baseIndexSpan(),
-                    std::move(data)).release()));
-}
+    , m_base()
+    , m_ids()
+    , m_manifest()
+    , m_baseFlag()
+    , m_idsFlag()
+    , m_manifestFlag()
+{ }
 
 Reader::~Reader()
 { }
@@ -84,6 +76,15 @@ Json::Value Reader::hierarchy(
     return m_builder->hierarchy().query(qbox, depthBegin, depthEnd);
 }
 
+std::vector<char> Reader::hierarchyBinary(
+        const BBox& qbox,
+        const std::size_t depthBegin,
+        const std::size_t depthEnd)
+{
+    checkQuery(depthBegin, depthEnd);
+    return m_builder->hierarchy().queryBinary(qbox, depthBegin, depthEnd);
+}
+
 std::unique_ptr<Query> Reader::query(
         const Schema& schema,
         const std::size_t depthBegin,
@@ -138,9 +139,91 @@ const Structure& Reader::structure() const  { return m_builder->structure(); }
 const std::string& Reader::srs() const      { return m_builder->srs(); }
 std::string Reader::path() const            { return m_endpoint.root(); }
 
-const BaseChunk* Reader::base() const { return m_base.get(); }
 const arbiter::Endpoint& Reader::endpoint() const { return m_endpoint; }
 
+const BaseChunk* Reader::base() const
+{
+    std::call_once(m_baseFlag, [this]() { loadBase(); });
+    return m_base.get();
+}
+
+bool Reader::exists(const Id& id) const
+{
+    std::call_once(m_idsFlag, [this]() { loadIds(); });
+    return m_ids->has(id);
+}
+
+const Manifest& Reader::manifest() const
+{
+    std::call_once(m_manifestFlag, [this]() { loadManifest(); });
+    return *m_manifest;
+}
+
+void Reader::loadBase() const
+{
+    if (!structure().baseIndexSpan()) return;
+
+    const std::string path(structure().baseIndexBegin().str());
+    std::unique_ptr<Chunk> chunk;
+
+    if (auto mapped = MappedFile::map(m_endpoint, path))
+    {
+        chunk = Chunk::create(
+                *m_builder,
+                bbox(),
+                0,
+                structure().baseIndexBegin(),
+                structure().baseIndexSpan(),
+                mapped->data(),
+                mapped->size());
+    }
+    else
+    {
+        chunk = Chunk::create(
+                *m_builder,
+                bbox(),
+                0,
+                structure().baseIndexBegin(),
+                structure().baseIndexSpan(),
+                std::unique_ptr<std::vector<char>>(
+                    new std::vector<char>(m_endpoint.getSubpathBinary(path))));
+    }
+
+    m_base.reset(static_cast<BaseChunk*>(chunk.release()));
+}
+
+void Reader::loadIds() const
+{
+    m_ids.reset(
+            new ChunkIds(
+                structure(),
+                m_endpoint.getSubpathBinary("entwine-ids")));
+}
+
+void Reader::loadManifest() const
+{
+    const std::vector<char> data(m_builder->fetchManifest("", false));
+
+    if (Manifest::isBinary(data))
+    {
+        m_manifest.reset(new Manifest(data, true));
+    }
+    else
+    {
+        // Legacy JSON manifest.
+        Json::Reader reader;
+        Json::Value json;
+
+        if (!reader.parse(std::string(data.begin(), data.end()), json, false))
+        {
+            throw std::runtime_error(
+                    "Invalid JSON: " + reader.getFormattedErrorMessages());
+        }
+
+        m_manifest.reset(new Manifest(json));
+    }
+}
+
 std::size_t Reader::numPoints() const
 {
     return m_builder->numPointsClone();
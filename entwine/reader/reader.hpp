@@ -15,7 +15,6 @@
 #include <map>
 #include <memory>
 #include <mutex>
-#include <set>
 #include <vector>
 
 #include <entwine/types/outer-scope.hpp>
@@ -41,6 +40,7 @@ class BaseChunk;
 class BBox;
 class Builder;
 class Cache;
+class ChunkIds;
 class Climber;
 class Hierarchy;
 class Manifest;
@@ -59,6 +59,10 @@ public:
             OuterScope outerScope = OuterScope());
     ~Reader();
 
+    // Spatial output dimensions are written as (v - _offset_) / _scale_,
+    // further scaled by any scale and offset of the output dimension itself.
+    // Where that matches the quantization of the index, stored values are
+    // copied directly.
     std::unique_ptr<Query> query(
             const Schema& schema,
             std::size_t depthBegin,
@@ -79,6 +83,12 @@ public:
             std::size_t depthBegin,
             std::size_t depthEnd);
 
+    // See Hierarchy::queryBinary for the format.
+    std::vector<char> hierarchyBinary(
+            const BBox& qbox,
+            std::size_t depthBegin,
+            std::size_t depthEnd);
+
     std::size_t numPoints() const;
     const BBox& bboxConforming() const;
     const BBox& bbox() const;
@@ -87,9 +97,14 @@ public:
     const std::string& srs() const;
     std::string path() const;
 
+    // The base chunk and the set of chunk IDs are fetched on first use.
     const BaseChunk* base() const;
     const arbiter::Endpoint& endpoint() const;
-    bool exists(const Id& id) const { return m_ids.count(id); }
+    bool exists(const Id& id) const;
+
+    // Contains only the aggregate stats of the build, without per-file
+    // information.  Fetched on first use.
+    const Manifest& manifest() const;
 
     struct BoxInfo
     {
@@ -103,13 +118,23 @@ public:
     typedef std::map<BBox, BoxInfo> BoxMap;
 
 private:
+    void loadBase() const;
+    void loadIds() const;
+    void loadManifest() const;
+
     arbiter::Endpoint m_endpoint;
 
     std::unique_ptr<Builder> m_builder;
-    std::unique_ptr<BaseChunk> m_base;
 
     Cache& m_cache;
-    std::set<Id> m_ids;
+
+    mutable std::unique_ptr<BaseChunk> m_base;
+    mutable std::unique_ptr<ChunkIds> m_ids;
+    mutable std::unique_ptr<Manifest> m_manifest;
+
+    mutable std::once_flag m_baseFlag;
+    mutable std::once_flag m_idsFlag;
+    mutable std::once_flag m_manifestFlag;
 };
 
 } // namespace entwine
@@ -75,6 +75,15 @@ namespace
 
     const std::size_t concurrentHttpReqs(32);
     const std::size_t httpRetryCount(8);
+
+    std::size_t getHttp(
+            const Json::Value& json,
+            const std::string key,
+            const std::size_t fallback)
+    {
+        const Json::Value& http(json["http"]);
+        return http.isMember(key) ? http[key].asUInt64() : fallback;
+    }
 }
 
 Arbiter::Arbiter()
@@ -86,7 +95,11 @@ Arbiter::Arbiter()
 
 Arbiter::Arbiter(const Json::Value& json)
     : m_drivers()
-    , m_pool(concurrentHttpReqs, httpRetryCount, json)
+    , m_pool(
+            std::max<std::size_t>(
+                getHttp(json, "concurrent", concurrentHttpReqs), 1),
+            getHttp(json, "retry", httpRetryCount),
+            json)
 {
     init(json);
 }
@@ -144,6 +157,12 @@ std::unique_ptr<std::size_t> Arbiter::tryGetSize(const std::string path) const
     return getDriver(path).tryGetSize(stripType(path));
 }
 
+std::unique_ptr<std::string> Arbiter::tryGetVersion(
+        const std::string path) const
+{
+    return getDriver(path).tryGetVersion(stripType(path));
+}
+
 void Arbiter::put(const std::string path, const std::string& data) const
 {
     return getDriver(path).put(stripType(path), data);
@@ -541,6 +560,73 @@ std::unique_ptr<std::vector<char>> Endpoint::tryGetSubpathBinary(
     return m_driver.tryGetBinary(fullPath(subpath));
 }
 
+std::unique_ptr<std::vector<char>> Endpoint::tryGetSubpathBinaryRange(
+        const std::string subpath,
+        const std::size_t begin,
+        const std::size_t end) const
+{
+    std::unique_ptr<std::vector<char>> data;
+    if (end <= begin) return data;
+
+    if (const auto* httpDriver = dynamic_cast<const drivers::Http*>(&m_driver))
+    {
+        http::Headers headers;
+        headers["Range"] =
+            "bytes=" + std::to_string(begin) + "-" + std::to_string(end - 1);
+
+        data = httpDriver->tryGetBinary(
+                fullPath(subpath),
+                headers,
+                http::Query());
+
+        // A server which does not support ranges returns the whole file.
+        if (data && data->size() <= end - begin) return data;
+    }
+    else
+    {
+        data = m_driver.tryGetBinary(fullPath(subpath));
+    }
+
+    if (data)
+    {
+        const std::size_t size(data->size());
+        data->erase(data->begin() + std::min(end, size), data->end());
+        data->erase(data->begin(), data->begin() + std::min(begin, size));
+    }
+
+    return data;
+}
+
+std::unique_ptr<std::vector<char>> Endpoint::tryGetSubpathBinarySuffix(
+        const std::string subpath,
+        const std::size_t size) const
+{
+    std::unique_ptr<std::vector<char>> data;
+    if (!size) return data;
+
+    if (const auto* httpDriver = dynamic_cast<const drivers::Http*>(&m_driver))
+    {
+        http::Headers headers;
+        headers["Range"] = "bytes=-" + std::to_string(size);
+
+        data = httpDriver->tryGetBinary(
+                fullPath(subpath),
+                headers,
+                http::Query());
+    }
+    else
+    {
+        data = m_driver.tryGetBinary(fullPath(subpath));
+    }
+
+    if (data && data->size() > size)
+    {
+        data->erase(data->begin(), data->end() - size);
+    }
+
+    return data;
+}
+
 void Endpoint::putSubpath(
         const std::string subpath,
         const std::string& data) const
@@ -6107,6 +6193,46 @@ std::unique_ptr<std::size_t> Http::tryGetSize(std::string path) const
     return size;
 }
 
+std::unique_ptr<std::string> Http::tryGetVersion(std::string path) const
+{
+    auto http(m_pool.acquire());
+    return version(http.head(path));
+}
+
+std::unique_ptr<std::string> Http::version(const Response& res)
+{
+    std::unique_ptr<std::string> result;
+    if (!res.ok()) return result;
+
+    // Header names are case-insensitive.
+    auto find([&res](const std::string name)
+    {
+        for (const auto& h : res.headers())
+        {
+            if (h.first.size() == name.size() &&
+                std::equal(
+                    name.begin(),
+                    name.end(),
+                    h.first.begin(),
+                    [](char a, char b)
+                    {
+                        return std::tolower(a) == std::tolower(b);
+                    }))
+            {
+                return h.second;
+            }
+        }
+
+        return std::string();
+    });
+
+    std::string v(find("ETag"));
+    if (v.empty()) v = find("Last-Modified");
+    if (!v.empty()) result.reset(new std::string(v));
+
+    return result;
+}
+
 std::string Http::get(
         std::string path,
         Headers headers,
@@ -6227,6 +6353,14 @@ Response Http::internalPost(
     return m_pool.acquire().post(path, data, headers, query);
 }
 
+Response Http::internalDelete(
+        const std::string path,
+        const Headers headers,
+        const Query query) const
+{
+    return m_pool.acquire().del(path, headers, query);
+}
+
 } // namespace drivers
 
 } // namespace arbiter
@@ -6262,6 +6396,7 @@ Response Http::internalPost(
 #include <ctime>
 #include <functional>
 #include <iostream>
+#include <mutex>
 #include <numeric>
 #include <thread>
 
@@ -6303,6 +6438,41 @@ namespace
     typedef Xml::xml_node<> XmlNode;
     const std::string badResponse("Unexpected contents in AWS response");
 
+    // S3 requires at least 5 MiB for every part but the last.
+    const std::size_t minMultipartSize(5 * 1024 * 1024);
+    const std::size_t defaultMultipartSize(16 * 1024 * 1024);
+    const std::size_t defaultMultipartThreads(4);
+
+    // Returns the text of _child_ beneath the _top_ node of an XML response,
+    // or an empty string if either is missing.
+    std::string xmlValue(
+            std::vector<char> data,
+            const std::string top,
+            const std::string child)
+    {
+        data.push_back('\0');
+        Xml::xml_document<> xml;
+
+        try
+        {
+            xml.parse<0>(data.data());
+        }
+        catch (Xml::parse_error&)
+        {
+            return std::string();
+        }
+
+        if (XmlNode* topNode = xml.first_node(top.c_str()))
+        {
+            if (XmlNode* childNode = topNode->first_node(child.c_str()))
+            {
+                return childNode->value();
+            }
+        }
+
+        return std::string();
+    }
+
     std::string toLower(const std::string& in)
     {
         return std::accumulate(
@@ -6399,12 +6569,17 @@ S3::S3(
         Pool& pool,
         const S3::Auth& auth,
         const std::string region,
-        const bool sse)
+        const bool sse,
+        const std::size_t multipartSize,
+        const std::size_t multipartThreads,
+        const std::string endpoint)
     : Http(pool)
     , m_auth(auth)
     , m_region(region)
-    , m_baseUrl(getBaseUrl(region))
+    , m_baseUrl(endpoint.empty() ? getBaseUrl(region) : endpoint)
     , m_baseHeaders()
+    , m_multipartSize(multipartSize)
+    , m_multipartThreads(std::max<std::size_t>(multipartThreads, 1))
 {
     if (sse)
     {
@@ -6512,7 +6687,26 @@ std::unique_ptr<S3> S3::create(Pool& pool, const Json::Value& json)
             "Region not found in ~/.aws/config - using us-east-1" << std::endl;
     }
 
-    s3.reset(new S3(pool, *auth, region, sse));
+    const std::size_t multipartSize(
+            json.isMember("multipartSize") ?
+                json["multipartSize"].asUInt64() : defaultMultipartSize);
+
+    const std::size_t multipartThreads(
+            json.isMember("multipartThreads") ?
+                json["multipartThreads"].asUInt64() : defaultMultipartThreads);
+
+    std::string endpoint(json["endpoint"].asString());
+    if (!endpoint.empty() && endpoint.back() != '/') endpoint += '/';
+
+    s3.reset(
+            new S3(
+                pool,
+                *auth,
+                region,
+                sse,
+                multipartSize,
+                multipartThreads,
+                endpoint));
 
     return s3;
 }
@@ -6561,6 +6755,22 @@ std::unique_ptr<std::size_t> S3::tryGetSize(std::string rawPath) const
     return size;
 }
 
+std::unique_ptr<std::string> S3::tryGetVersion(std::string rawPath) const
+{
+    const Resource resource(m_baseUrl, rawPath);
+    const ApiV4 apiV4(
+            "HEAD",
+            m_region,
+            resource,
+            m_auth,
+            Query(),
+            Headers(),
+            empty);
+
+    return Http::version(
+            Http::internalHead(resource.url(), apiV4.headers()));
+}
+
 bool S3::get(
         const std::string rawPath,
         std::vector<char>& data,
@@ -6602,6 +6812,15 @@ void S3::put(
         const Headers userHeaders,
         const Query query) const
 {
+    if (
+            m_multipartSize &&
+            data.size() > std::max(m_multipartSize, minMultipartSize) &&
+            query.empty())
+    {
+        putMultipart(rawPath, data, userHeaders);
+        return;
+    }
+
     const Resource resource(m_baseUrl, rawPath);
 
     Headers headers(m_baseHeaders);
@@ -6631,6 +6850,192 @@ void S3::put(
     }
 }
 
+void S3::putMultipart(
+        const std::string rawPath,
+        const std::vector<char>& data,
+        const Headers userHeaders) const
+{
+    const Resource resource(m_baseUrl, rawPath);
+    const std::size_t partSize(std::max(m_multipartSize, minMultipartSize));
+    const std::size_t numParts((data.size() + partSize - 1) / partSize);
+
+    auto fail([&rawPath](const std::string what, const Response& res)
+    {
+        throw ArbiterError(
+                "Couldn't S3 multipart " + what + " to " + rawPath + ": " +
+                std::string(res.data().data(), res.data().size()));
+    });
+
+    // Encryption and user headers apply to the object as a whole, so they
+    // are sent only when the upload is initiated.
+    Headers headers(m_baseHeaders);
+    headers.insert(userHeaders.begin(), userHeaders.end());
+
+    Query initQuery;
+    initQuery["uploads"] = "";
+
+    const ApiV4 initApi(
+            "POST",
+            m_region,
+            resource,
+            m_auth,
+            initQuery,
+            headers,
+            empty);
+
+    const Response init(
+            Http::internalPost(
+                resource.url(),
+                empty,
+                initApi.headers(),
+                initApi.query()));
+
+    const std::string uploadId(
+            xmlValue(init.data(), "InitiateMultipartUploadResult", "UploadId"));
+
+    if (!init.ok() || uploadId.empty()) fail("initiate", init);
+
+    // Once initiated, a failed upload is aborted so that its parts are
+    // discarded rather than left to accrue storage charges.  Retries of this
+    // put each initiate a new upload.
+    auto abort([&]()
+    {
+        Query query;
+        query["uploadId"] = uploadId;
+
+        const ApiV4 apiV4(
+                "DELETE",
+                m_region,
+                resource,
+                m_auth,
+                query,
+                Headers(),
+                empty);
+
+        const Response res(
+                Http::internalDelete(
+                    resource.url(),
+                    apiV4.headers(),
+                    apiV4.query()));
+
+        if (!res.ok())
+        {
+            std::cout << "Couldn't abort S3 multipart upload to " << rawPath <<
+                " - its parts must be removed by lifecycle rules" << std::endl;
+        }
+    });
+
+    // Parts are claimed in order by a few threads, each of which holds a
+    // pooled connection only for the duration of a single part.
+    std::vector<std::string> etags(numParts);
+    std::size_t next(0);
+    std::unique_ptr<Response> error;
+    std::mutex mutex;
+
+    auto upload([&]()
+    {
+        while (true)
+        {
+            std::size_t i(0);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (error || next == numParts) return;
+                i = next++;
+            }
+
+            const auto begin(data.begin() + i * partSize);
+            const auto end(
+                    data.begin() + std::min((i + 1) * partSize, data.size()));
+            const std::vector<char> part(begin, end);
+
+            Query query;
+            query["partNumber"] = std::to_string(i + 1);
+            query["uploadId"] = uploadId;
+
+            const ApiV4 apiV4(
+                    "PUT",
+                    m_region,
+                    resource,
+                    m_auth,
+                    query,
+                    Headers(),
+                    part);
+
+            const Response res(
+                    Http::internalPut(
+                        resource.url(),
+                        part,
+                        apiV4.headers(),
+                        apiV4.query()));
+
+            std::string etag;
+            for (const auto& h : res.headers())
+            {
+                if (toLower(h.first) == "etag") etag = trim(h.second);
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (res.ok() && !etag.empty()) etags[i] = etag;
+            else if (!error) error.reset(new Response(res));
+        }
+    });
+
+    std::vector<std::thread> threads;
+    for (std::size_t i(1); i < std::min(m_multipartThreads, numParts); ++i)
+    {
+        threads.emplace_back(upload);
+    }
+
+    upload();
+    for (auto& t : threads) t.join();
+
+    if (error)
+    {
+        abort();
+        fail("part upload", *error);
+    }
+
+    std::string xml("<CompleteMultipartUpload>");
+    for (std::size_t i(0); i < numParts; ++i)
+    {
+        xml +=
+            "<Part><PartNumber>" + std::to_string(i + 1) + "</PartNumber>" +
+            "<ETag>" + etags[i] + "</ETag></Part>";
+    }
+    xml += "</CompleteMultipartUpload>";
+
+    const std::vector<char> body(xml.begin(), xml.end());
+
+    Query completeQuery;
+    completeQuery["uploadId"] = uploadId;
+
+    const ApiV4 completeApi(
+            "POST",
+            m_region,
+            resource,
+            m_auth,
+            completeQuery,
+            Headers(),
+            body);
+
+    const Response complete(
+            Http::internalPost(
+                resource.url(),
+                body,
+                completeApi.headers(),
+                completeApi.query()));
+
+    // A completion may fail after a 200 status has been sent, in which case
+    // the body holds an error rather than a result.
+    const std::string result(complete.data().data(), complete.data().size());
+    if (!complete.ok() || result.find("<Error>") != std::string::npos)
+    {
+        abort();
+        fail("completion", complete);
+    }
+}
+
 std::vector<std::string> S3::glob(std::string path, bool verbose) const
 {
     std::vector<std::string> results;
@@ -6807,7 +7212,7 @@ std::string S3::ApiV4::buildCanonicalRequest(
         const Query& query,
         const std::vector<char>& data) const
 {
-    const std::string canonicalUri(sanitize("/" + resource.object));
+    const std::string canonicalUri(sanitize("/" + resource.path()));
 
     auto canonicalizeQuery([](const std::string& s, const Query::value_type& q)
     {
@@ -6890,14 +7295,26 @@ S3::Resource::Resource(std::string baseUrl, std::string fullPath)
 
 std::string S3::Resource::url() const
 {
+    if (pathStyle()) return baseUrl + path();
     return "https://" + bucket + baseUrl + object;
 }
 
 std::string S3::Resource::host() const
 {
+    if (pathStyle())
+    {
+        const std::size_t begin(baseUrl.find("://") + 3);
+        return baseUrl.substr(begin, baseUrl.find('/', begin) - begin);
+    }
+
     return bucket + baseUrl.substr(0, baseUrl.size() - 1); // Pop slash.
 }
 
+std::string S3::Resource::path() const
+{
+    return pathStyle() ? bucket + "/" + object : object;
+}
+
 S3::FormattedTime::FormattedTime()
     : m_date(formatTime(dateFormat))
     , m_time(formatTime(timeFormat))
@@ -7527,11 +7944,12 @@ std::string buildQueryString(const Query& query)
             });
 }
 
-Curl::Curl(bool verbose, std::size_t timeout)
+Curl::Curl(bool verbose, std::size_t timeout, bool keepAlive)
     : m_curl(0)
     , m_headers(0)
     , m_verbose(verbose)
     , m_timeout(timeout)
+    , m_keepAlive(keepAlive)
     , m_data()
 {
     m_curl = curl_easy_init();
@@ -7569,6 +7987,15 @@ void Curl::init(
     // Configuration options.
     if (followRedirect) curl_easy_setopt(m_curl, CURLOPT_FOLLOWLOCATION, 1L);
 
+    // Connections stay cached on this handle between requests, so probe
+    // them while idle to keep them from being silently dropped.
+    if (m_keepAlive)
+    {
+        curl_easy_setopt(m_curl, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(m_curl, CURLOPT_TCP_KEEPIDLE, 30L);
+        curl_easy_setopt(m_curl, CURLOPT_TCP_KEEPINTVL, 15L);
+    }
+
     // Insert supplied headers.
     for (const auto& h : headers)
     {
@@ -7671,12 +8098,17 @@ Response Curl::put(
     // to false.
     curl_easy_setopt(m_curl, CURLOPT_WRITEFUNCTION, eatLogging);
 
+    // Set up callback and data pointer for received headers.
+    Headers receivedHeaders;
+    curl_easy_setopt(m_curl, CURLOPT_HEADERFUNCTION, headerCb);
+    curl_easy_setopt(m_curl, CURLOPT_HEADERDATA, &receivedHeaders);
+
     // Run the command.
     curl_easy_perform(m_curl);
     curl_easy_getinfo(m_curl, CURLINFO_RESPONSE_CODE, &httpCode);
 
     curl_easy_reset(m_curl);
-    return Response(httpCode);
+    return Response(httpCode, std::vector<char>(), receivedHeaders);
 }
 
 Response Curl::post(
@@ -7713,10 +8145,11 @@ Response Curl::post(
     curl_easy_setopt(m_curl, CURLOPT_POST, 1L);
 
     // Must use this for binary data, otherwise curl will use strlen(), which
-    // will likely be incorrect.
+    // will likely be incorrect.  Without it, a POST body supplied by the read
+    // callback is sent chunked, without a Content-Length.
     curl_easy_setopt(
             m_curl,
-            CURLOPT_INFILESIZE_LARGE,
+            CURLOPT_POSTFIELDSIZE_LARGE,
             static_cast<curl_off_t>(data.size()));
 
     // Run the command.
@@ -7728,6 +8161,32 @@ Response Curl::post(
     return response;
 }
 
+Response Curl::del(std::string path, Headers headers, Query query)
+{
+    int httpCode(0);
+    std::vector<char> data;
+
+    init(path, headers, query);
+    if (m_verbose) curl_easy_setopt(m_curl, CURLOPT_VERBOSE, 1L);
+
+    // Register callback function and data pointer to consume the result.
+    curl_easy_setopt(m_curl, CURLOPT_WRITEFUNCTION, getCb);
+    curl_easy_setopt(m_curl, CURLOPT_WRITEDATA, &data);
+
+    // Insert all headers into the request.
+    curl_easy_setopt(m_curl, CURLOPT_HTTPHEADER, m_headers);
+
+    // Specify a DELETE request.
+    curl_easy_setopt(m_curl, CURLOPT_CUSTOMREQUEST, "DELETE");
+
+    // Run the command.
+    curl_easy_perform(m_curl);
+    curl_easy_getinfo(m_curl, CURLINFO_RESPONSE_CODE, &httpCode);
+
+    curl_easy_reset(m_curl);
+    return Response(httpCode, data);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 Resource::Resource(
@@ -7792,6 +8251,17 @@ Response Resource::post(
     });
 }
 
+Response Resource::del(
+        const std::string path,
+        const Headers headers,
+        const Query query)
+{
+    return exec([this, path, headers, query]()->Response
+    {
+        return m_curl.del(path, headers, query);
+    });
+}
+
 Response Resource::exec(std::function<Response()> f)
 {
     Response res;
@@ -7826,10 +8296,14 @@ Pool::Pool(
             json.isMember("http") && json["http"]["timeout"].asUInt64() ?
                 json["http"]["timeout"].asUInt64() : defaultHttpTimeout);
 
+    const bool keepAlive(
+            json.isMember("http") && json["http"].isMember("keepAlive") ?
+                json["http"]["keepAlive"].asBool() : true);
+
     for (std::size_t i(0); i < concurrent; ++i)
     {
         m_available[i] = i;
-        m_curls[i].reset(new Curl(verbose, timeout));
+        m_curls[i].reset(new Curl(verbose, timeout, keepAlive));
     }
 }
 
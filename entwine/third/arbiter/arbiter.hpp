@@ -2249,9 +2249,10 @@ public:
             const std::vector<char>& data,
             Headers headers,
             Query query);
+    http::Response del(std::string path, Headers headers, Query query);
 
 private:
-    Curl(bool verbose, std::size_t timeout);
+    Curl(bool verbose, std::size_t timeout, bool keepAlive);
 
     void init(std::string path, const Headers& headers, const Query& query);
 
@@ -2262,6 +2263,7 @@ private:
     curl_slist* m_headers;
     const bool m_verbose;
     const std::size_t m_timeout;
+    const bool m_keepAlive;
 
     std::vector<char> m_data;
 };
@@ -2294,6 +2296,11 @@ public:
             Headers headers = Headers(),
             Query query = Query());
 
+    http::Response del(
+            std::string path,
+            Headers headers = Headers(),
+            Query query = Query());
+
 private:
     Pool& m_pool;
     Curl& m_curl;
@@ -2427,6 +2434,15 @@ public:
     /** Get the file size in bytes, if available. */
     virtual std::unique_ptr<std::size_t> tryGetSize(std::string path) const = 0;
 
+    /** Get an identifier of the current contents of the file, such as an
+     * ETag, if available.  It changes whenever the file is rewritten, even if
+     * its size does not.  By default, none is available.
+     */
+    virtual std::unique_ptr<std::string> tryGetVersion(std::string path) const
+    {
+        return std::unique_ptr<std::string>();
+    }
+
     /** Get the file size in bytes, or throw if it does not exist. */
     std::size_t getSize(std::string path) const;
 
@@ -2681,6 +2697,12 @@ public:
     virtual std::unique_ptr<std::size_t> tryGetSize(
             std::string path) const override;
 
+    /** By default, performs a HEAD request and returns the contents of the
+     * ETag header, or of the Last-Modified header if there is no ETag.
+     */
+    virtual std::unique_ptr<std::string> tryGetVersion(
+            std::string path) const override;
+
     virtual void put(
             std::string path,
             const std::vector<char>& data) const final override
@@ -2731,6 +2753,9 @@ public:
             http::Query query) const;
 
 protected:
+    /** Extract the version, as for tryGetVersion, from a HEAD response. */
+    static std::unique_ptr<std::string> version(const http::Response& res);
+
     /** HTTP-derived Drivers should override this version of GET to allow for
      * custom headers and query parameters.
      */
@@ -2765,6 +2790,11 @@ protected:
             http::Headers headers = http::Headers(),
             http::Query query = http::Query()) const;
 
+    http::Response internalDelete(
+            std::string path,
+            http::Headers headers = http::Headers(),
+            http::Query query = http::Query()) const;
+
 private:
     virtual bool get(
             std::string path,
@@ -5787,7 +5817,10 @@ public:
             http::Pool& pool,
             const Auth& auth,
             std::string region = "us-east-1",
-            bool sse = false);
+            bool sse = false,
+            std::size_t multipartSize = 0,
+            std::size_t multipartThreads = 4,
+            std::string endpoint = "");
 
     /** Try to construct an S3 Driver.  Searches @p json primarily for the keys
      * `access` and `hidden` to construct an S3::Auth.  If not found, common
@@ -5796,6 +5829,14 @@ public:
      *
      * Server-side encryption may be enabled by setting key `sse` to `true` in
      * @p json.
+     *
+     * Objects larger than `multipartSize` bytes (default 16 MiB, or zero to
+     * disable) are uploaded in parts of that size, with up to
+     * `multipartThreads` parts (default 4) in flight at once.
+     *
+     * Requests are sent to `endpoint`, if present, instead of AWS - for
+     * example `http://localhost:9000/`.  Such endpoints are addressed
+     * path-style, with the bucket as the first path segment.
      */
     static std::unique_ptr<S3> create(
             http::Pool& pool,
@@ -5808,6 +5849,9 @@ public:
     virtual std::unique_ptr<std::size_t> tryGetSize(
             std::string path) const override;
 
+    virtual std::unique_ptr<std::string> tryGetVersion(
+            std::string path) const override;
+
     /** Inherited from Drivers::Http. */
     virtual void put(
             std::string path,
@@ -5852,6 +5896,11 @@ private:
             std::string path,
             bool verbose) const override;
 
+    void putMultipart(
+            std::string path,
+            const std::vector<char>& data,
+            http::Headers headers) const;
+
     struct Resource
     {
         Resource(std::string baseUrl, std::string fullPath);
@@ -5859,6 +5908,15 @@ private:
         std::string url() const;
         std::string host() const;
 
+        // The request path, including the bucket if addressed path-style.
+        std::string path() const;
+
+        // Custom endpoints carry a scheme, unlike the AWS base URLs.
+        bool pathStyle() const
+        {
+            return baseUrl.find("://") != std::string::npos;
+        }
+
         std::string baseUrl;
         std::string bucket;
         std::string object;
@@ -5936,6 +5994,9 @@ private:
     std::string m_region;
     std::string m_baseUrl;
     http::Headers m_baseHeaders;
+
+    std::size_t m_multipartSize;
+    std::size_t m_multipartThreads;
 };
 
 } // namespace drivers
@@ -6114,6 +6175,23 @@ public:
     std::unique_ptr<std::vector<char>> tryGetSubpathBinary(
             std::string subpath) const;
 
+    /** Get the bytes in the range [@p begin, @p end) of a file, if available.
+     * HTTP-derived drivers perform a ranged GET, and other drivers read the
+     * entire file.  The result may be shorter than requested if the file
+     * ends before @p end.
+     */
+    std::unique_ptr<std::vector<char>> tryGetSubpathBinaryRange(
+            std::string subpath,
+            std::size_t begin,
+            std::size_t end) const;
+
+    /** Get the final @p size bytes of a file, or the entire file if it is
+     * smaller than @p size, if available.
+     */
+    std::unique_ptr<std::vector<char>> tryGetSubpathBinarySuffix(
+            std::string subpath,
+            std::size_t size) const;
+
     /** Passthrough to Driver::put(std::string, const std::string&) const. */
     void putSubpath(std::string subpath, const std::string& data) const;
 
@@ -6256,6 +6334,11 @@ public:
     /** Get file size in bytes if accessible. */
     std::unique_ptr<std::size_t> tryGetSize(std::string path) const;
 
+    /** Get an identifier of the file's current contents if available.  See
+     * Driver::tryGetVersion.
+     */
+    std::unique_ptr<std::string> tryGetVersion(std::string path) const;
+
     /** Write data to path. */
     void put(std::string path, const std::string& data) const;
 
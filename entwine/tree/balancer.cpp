@@ -0,0 +1,156 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/tree/balancer.hpp>
+
+#include <entwine/tree/chunk.hpp>
+#include <entwine/util/metrics.hpp>
+#include <entwine/util/pool.hpp>
+
+namespace entwine
+{
+
+namespace
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    const std::size_t minWorkThreads(1);
+    const std::size_t minClipThreads(2);
+
+    // A move is undone if the insertion rate afterward falls by more than
+    // this fraction.
+    const double tolerance(0.1);
+    const std::size_t holdIntervals(5);
+
+    Counter& rebalances(
+            Metrics::counter(
+                "entwine_thread_rebalances_total",
+                "Threads moved between insertion and clipping"));
+}
+
+Balancer::Balancer(
+        Pool& work,
+        Pool& clip,
+        const std::size_t budget,
+        const Counter& inserted,
+        const std::chrono::milliseconds interval)
+    : m_work(work)
+    , m_clip(clip)
+    , m_budget(budget)
+    , m_interval(interval)
+    , m_inserted(inserted)
+    , m_lastInserted(m_inserted.value())
+    , m_lastResident(Chunk::getChunkCnt())
+    , m_lastTime(Clock::now())
+    , m_lastMove(0)
+    , m_rateBeforeMove(0)
+    , m_hold(0)
+    , m_stop(false)
+    , m_mutex()
+    , m_cv()
+    , m_thread()
+{
+    m_clip.limit(m_budget - m_work.limit());
+
+    m_thread = std::thread([this]()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        while (!m_cv.wait_for(lock, m_interval, [this]() { return m_stop; }))
+        {
+            step();
+        }
+    });
+}
+
+Balancer::~Balancer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_cv.notify_all();
+    m_thread.join();
+}
+
+void Balancer::step()
+{
+    const auto now(Clock::now());
+    const double seconds(
+            std::chrono::duration<double>(now - m_lastTime).count());
+    const std::size_t inserted(m_inserted.value());
+    const std::size_t resident(Chunk::getChunkCnt());
+
+    const double rate(seconds > 0 ? (inserted - m_lastInserted) / seconds : 0);
+    const bool growing(resident > m_lastResident);
+
+    m_lastTime = now;
+    m_lastInserted = inserted;
+    m_lastResident = resident;
+
+    if (m_lastMove && rate < m_rateBeforeMove * (1.0 - tolerance))
+    {
+        move(-m_lastMove);
+        m_lastMove = 0;
+        m_hold = holdIntervals;
+        return;
+    }
+
+    m_lastMove = 0;
+
+    if (m_hold)
+    {
+        --m_hold;
+        return;
+    }
+
+    const bool clipSaturated(
+            m_clip.running() >= m_clip.limit() &&
+            (m_clip.queued() || m_clip.blocked()));
+
+    const bool clipIdle(
+            m_clip.running() < m_clip.limit() &&
+            !m_clip.queued());
+
+    const bool workSaturated(m_work.running() >= m_work.limit());
+
+    int n(0);
+
+    if (clipSaturated && m_work.limit() > minWorkThreads)
+    {
+        n = 1;
+    }
+    else if (
+            clipIdle && workSaturated && !growing &&
+            m_clip.limit() > minClipThreads)
+    {
+        n = -1;
+    }
+
+    if (n)
+    {
+        m_rateBeforeMove = rate;
+        m_lastMove = n;
+        move(n);
+    }
+}
+
+void Balancer::move(const int n)
+{
+    const std::size_t work(m_work.limit() - n);
+
+    m_work.limit(work);
+    m_clip.limit(m_budget - work);
+    rebalances.add();
+}
+
+} // namespace entwine
+
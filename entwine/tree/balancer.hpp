@@ -0,0 +1,80 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+namespace entwine
+{
+
+class Counter;
+class Pool;
+
+// Shift a fixed budget of threads between point insertion and chunk clipping
+// while a build runs.  Both pools must be able to run the entire budget, and
+// are limited so that their limits sum to the budget.
+//
+// Once per interval, if clipping is saturated - every clip thread is busy
+// and insertion threads are waiting to queue clip tasks - a thread moves
+// from insertion to clipping.  If instead clipping has idle threads while
+// insertion is saturated and the number of resident chunks is not growing,
+// a thread moves back to insertion.  A move that lowers the insertion rate
+// is undone, after which the split is held for a few intervals.
+//
+// The insertion rate is measured from _inserted_, which must count the
+// points inserted by the build being balanced.
+class Balancer
+{
+public:
+    Balancer(
+            Pool& work,
+            Pool& clip,
+            std::size_t budget,
+            const Counter& inserted,
+            std::chrono::milliseconds interval =
+                std::chrono::milliseconds(1000));
+    ~Balancer();
+
+private:
+    void step();
+    void move(int n);
+
+    Pool& m_work;
+    Pool& m_clip;
+    const std::size_t m_budget;
+    const std::chrono::milliseconds m_interval;
+
+    const Counter& m_inserted;
+    std::size_t m_lastInserted;
+    std::size_t m_lastResident;
+    std::chrono::high_resolution_clock::time_point m_lastTime;
+
+    // The previous move and the insertion rate before it, so that a move
+    // which made things worse can be undone.
+    int m_lastMove;
+    double m_rateBeforeMove;
+    std::size_t m_hold;
+
+    bool m_stop;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::thread m_thread;
+
+    Balancer(const Balancer&);
+    Balancer& operator=(const Balancer&);
+};
+
+} // namespace entwine
+
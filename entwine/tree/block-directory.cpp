@@ -0,0 +1,256 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/tree/block-directory.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <entwine/compression/util.hpp>
+#include <entwine/types/bbox.hpp>
+#include <entwine/types/pooled-point-table.hpp>
+#include <entwine/types/schema.hpp>
+
+namespace entwine
+{
+
+namespace
+{
+    const double lowest(std::numeric_limits<double>::lowest());
+    const double highest(std::numeric_limits<double>::max());
+
+    template<typename T> void write(std::vector<char>& data, const T v)
+    {
+        const char* pos(reinterpret_cast<const char*>(&v));
+        data.insert(data.end(), pos, pos + sizeof(T));
+    }
+
+    template<typename T> T read(const char*& pos)
+    {
+        T v;
+        std::memcpy(&v, pos, sizeof(T));
+        pos += sizeof(T);
+        return v;
+    }
+}
+
+bool BlockDirectory::Entry::overlaps(const BBox& bbox) const
+{
+    return
+        min.x <= bbox.max().x && max.x >= bbox.min().x &&
+        min.y <= bbox.max().y && max.y >= bbox.min().y &&
+        (!bbox.is3d() || (min.z <= bbox.max().z && max.z >= bbox.min().z));
+}
+
+std::size_t BlockDirectory::size(const char* data, const std::size_t size)
+{
+    if (size < footerSize) return 0;
+
+    const Chunk::Tail tail(Chunk::getTail(data, size));
+    if (tail.type != Chunk::Blocked) return 0;
+
+    const char* pos(data + size - footerSize);
+    const uint64_t blocks(read<uint64_t>(pos));
+
+    return maxSize(blocks);
+}
+
+BlockDirectory::BlockDirectory(const char* data, const std::size_t size)
+    : m_type(Chunk::Invalid)
+    , m_numPoints(Chunk::getTail(data, size).numPoints)
+    , m_entries()
+{
+    const std::size_t bytes(BlockDirectory::size(data, size));
+
+    if (!bytes || bytes > size)
+    {
+        throw std::runtime_error("Invalid block directory");
+    }
+
+    const char* pos(data + size - footerSize);
+    const uint64_t blocks(read<uint64_t>(pos));
+    const int type(read<uint8_t>(pos));
+
+    if (type == Chunk::Sparse) m_type = Chunk::Sparse;
+    else if (type == Chunk::Contiguous) m_type = Chunk::Contiguous;
+    else throw std::runtime_error("Invalid blocked chunk type");
+
+    pos = data + size - bytes;
+
+    for (std::size_t i(0); i < blocks; ++i)
+    {
+        const uint64_t offset(read<uint64_t>(pos));
+        const uint64_t blockSize(read<uint64_t>(pos));
+        const uint64_t numPoints(read<uint64_t>(pos));
+
+        Point min, max;
+        min.x = read<double>(pos);
+        min.y = read<double>(pos);
+        min.z = read<double>(pos);
+        max.x = read<double>(pos);
+        max.y = read<double>(pos);
+        max.z = read<double>(pos);
+
+        m_entries.emplace_back(offset, blockSize, numPoints, min, max);
+    }
+}
+
+std::size_t BlockDirectory::blockBytes() const
+{
+    if (m_entries.empty()) return 0;
+    return m_entries.back().offset + m_entries.back().size;
+}
+
+Chunk::Tail BlockDirectory::segments(
+        const char* data,
+        const std::size_t size,
+        const SegmentFunction& f)
+{
+    const Chunk::Tail tail(Chunk::getTail(data, size));
+
+    if (tail.type == Chunk::Sparse || tail.type == Chunk::Contiguous)
+    {
+        f(data, size - Chunk::tailSize, tail.numPoints);
+        return tail;
+    }
+    else if (tail.type != Chunk::Blocked)
+    {
+        return tail;
+    }
+
+    const BlockDirectory directory(data, size);
+
+    if (directory.blockBytes() + directory.bytes() != size)
+    {
+        throw std::runtime_error("Invalid blocked chunk size");
+    }
+
+    for (const auto& entry : directory.entries())
+    {
+        f(data + entry.offset, entry.size, entry.numPoints);
+    }
+
+    return Chunk::Tail(directory.numPoints(), directory.type());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+BlockWriter::BlockWriter(
+        const Schema& schema,
+        const std::size_t numPoints,
+        const std::size_t blocks)
+    : m_schema(schema)
+    , m_blocked(blocks > 1)
+    , m_blockPoints(
+            m_blocked ?
+                std::max<std::size_t>((numPoints + blocks - 1) / blocks, 1) :
+                numPoints)
+    , m_compressor(new Compressor(m_schema, m_blockPoints))
+    , m_numPoints(0)
+    , m_blockNumPoints(0)
+    , m_min(highest, highest, highest)
+    , m_max(lowest, lowest, lowest)
+    , m_data(new std::vector<char>())
+    , m_entries()
+{ }
+
+BlockWriter::~BlockWriter() { }
+
+void BlockWriter::push(const char* data, const std::size_t size)
+{
+    if (!size) return;
+
+    m_compressor->push(data, size);
+
+    const std::size_t pointSize(m_schema.pointSize());
+    const std::size_t numPoints(size / pointSize);
+
+    m_numPoints += numPoints;
+    m_blockNumPoints += numPoints;
+
+    if (!m_blocked) return;
+
+    BinaryPointTable table(m_schema);
+    pdal::PointRef pointRef(table, 0);
+
+    for (const char* pos(data); pos < data + size; pos += pointSize)
+    {
+        table.setPoint(pos);
+
+        const Point p(m_schema.point(pointRef));
+
+        m_min.x = std::min(m_min.x, p.x);
+        m_min.y = std::min(m_min.y, p.y);
+        m_min.z = std::min(m_min.z, p.z);
+        m_max.x = std::max(m_max.x, p.x);
+        m_max.y = std::max(m_max.y, p.y);
+        m_max.z = std::max(m_max.z, p.z);
+    }
+
+    if (m_blockNumPoints >= m_blockPoints) flush();
+}
+
+void BlockWriter::flush()
+{
+    std::unique_ptr<std::vector<char>> block(m_compressor->data());
+
+    m_entries.emplace_back(
+            m_data->size(),
+            block->size(),
+            m_blockNumPoints,
+            m_min,
+            m_max);
+
+    m_data->insert(m_data->end(), block->begin(), block->end());
+
+    m_compressor.reset(new Compressor(m_schema, m_blockPoints));
+    m_blockNumPoints = 0;
+    m_min = Point(highest, highest, highest);
+    m_max = Point(lowest, lowest, lowest);
+}
+
+std::unique_ptr<std::vector<char>> BlockWriter::data(const Chunk::Type type)
+{
+    if (!m_blocked)
+    {
+        std::unique_ptr<std::vector<char>> data(m_compressor->data());
+        Chunk::pushTail(*data, Chunk::Tail(m_numPoints, type));
+        return data;
+    }
+
+    if (m_blockNumPoints || m_entries.empty()) flush();
+
+    std::vector<char>& data(*m_data);
+
+    for (const auto& entry : m_entries)
+    {
+        write<uint64_t>(data, entry.offset);
+        write<uint64_t>(data, entry.size);
+        write<uint64_t>(data, entry.numPoints);
+        write<double>(data, entry.min.x);
+        write<double>(data, entry.min.y);
+        write<double>(data, entry.min.z);
+        write<double>(data, entry.max.x);
+        write<double>(data, entry.max.y);
+        write<double>(data, entry.max.z);
+    }
+
+    write<uint64_t>(data, m_entries.size());
+    write<uint8_t>(data, type);
+    Chunk::pushTail(data, Chunk::Tail(m_numPoints, Chunk::Blocked));
+
+    return std::move(m_data);
+}
+
+} // namespace entwine
+
@@ -0,0 +1,156 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <entwine/tree/chunk.hpp>
+#include <entwine/types/point.hpp>
+
+namespace entwine
+{
+
+class BBox;
+class Compressor;
+class Schema;
+
+// A chunk may be written as a run of independently compressed blocks, each
+// holding consecutive tubes of the chunk in index order, followed by a
+// directory of their byte ranges and bounds.  Since tubes adjacent in index
+// order are spatially adjacent, a reader may fetch only the blocks which
+// overlap its query.  The layout of a blocked chunk is:
+//
+//      [block 0] ... [block n - 1]
+//      [entry 0] ... [entry n - 1]
+//      [uint64_t n] [uint8_t type]
+//      [uint64_t numPoints] [uint8_t Chunk::Blocked]
+//
+// where _type_ is the type of the chunk within its blocks, and the final nine
+// bytes are an ordinary Chunk::Tail.
+class BlockDirectory
+{
+public:
+    struct Entry
+    {
+        Entry(
+                std::size_t offset,
+                std::size_t size,
+                std::size_t numPoints,
+                const Point& min,
+                const Point& max)
+            : offset(offset)
+            , size(size)
+            , numPoints(numPoints)
+            , min(min)
+            , max(max)
+        { }
+
+        // True if any point of this block may lie within _bbox_.
+        bool overlaps(const BBox& bbox) const;
+
+        std::size_t offset;
+        std::size_t size;
+        std::size_t numPoints;
+        Point min;
+        Point max;
+    };
+
+    static const std::size_t entrySize = 3 * sizeof(uint64_t) + 6 * 8;
+    static const std::size_t footerSize =
+        sizeof(uint64_t) + 1 + Chunk::tailSize;
+
+    // The largest directory that may follow a chunk of _blocks_ blocks.
+    static std::size_t maxSize(std::size_t blocks)
+    {
+        return blocks * entrySize + footerSize;
+    }
+
+    // Given the trailing _size_ bytes of a serialized chunk, returns the
+    // number of trailing bytes occupied by its directory, or zero if the
+    // chunk is not blocked.
+    static std::size_t size(const char* data, std::size_t size);
+
+    // Parses the directory from the trailing _size_ bytes of a blocked chunk,
+    // which must include at least the number of bytes returned by size().
+    BlockDirectory(const char* data, std::size_t size);
+
+    Chunk::Type type() const { return m_type; }
+    std::size_t numPoints() const { return m_numPoints; }
+    const std::vector<Entry>& entries() const { return m_entries; }
+
+    // Total size of the blocks, which is also the offset of the directory.
+    std::size_t blockBytes() const;
+
+    // Serialized size of this directory.
+    std::size_t bytes() const { return maxSize(m_entries.size()); }
+
+    typedef std::function<void(const char*, std::size_t, std::size_t)>
+        SegmentFunction;
+
+    // Calls _f_ with each independently compressed segment of an entire
+    // serialized chunk, along with its number of points.  A chunk which is
+    // not blocked has a single segment.  Returns the chunk's Tail, whose type
+    // for a blocked chunk is the type of the chunk within its blocks.
+    static Chunk::Tail segments(
+            const char* data,
+            std::size_t size,
+            const SegmentFunction& f);
+
+private:
+    Chunk::Type m_type;
+    std::size_t m_numPoints;
+    std::vector<Entry> m_entries;
+};
+
+// Compresses the points of a chunk, tube by tube, into a serialized chunk.
+// If _blocks_ is greater than one, the result is a blocked chunk of at most
+// that many blocks of roughly equal point counts.  Otherwise it is a single
+// compressed stream, as always.
+class BlockWriter
+{
+public:
+    BlockWriter(
+            const Schema& schema,
+            std::size_t numPoints,
+            std::size_t blocks);
+    ~BlockWriter();
+
+    // Adds the points of one tube.  Blocks end only between calls.
+    void push(const char* data, std::size_t size);
+
+    // Returns the serialized chunk, including its tail.
+    std::unique_ptr<std::vector<char>> data(Chunk::Type type);
+
+private:
+    void flush();
+
+    const Schema& m_schema;
+    const bool m_blocked;
+    const std::size_t m_blockPoints;
+
+    std::unique_ptr<Compressor> m_compressor;
+    std::size_t m_numPoints;
+    std::size_t m_blockNumPoints;
+    Point m_min;
+    Point m_max;
+
+    std::unique_ptr<std::vector<char>> m_data;
+    std::vector<BlockDirectory::Entry> m_entries;
+
+    BlockWriter(const BlockWriter&);
+    BlockWriter& operator=(const BlockWriter&);
+};
+
+} // namespace entwine
+
@@ -10,6 +10,7 @@
 
 #include <entwine/tree/builder.hpp>
 
+#include <fstream>
 #include <limits>
 #include <numeric>
 #include <random>
@@ -18,9 +19,12 @@
 #include <entwine/compression/util.hpp>
 #include <entwine/third/arbiter/arbiter.hpp>
 #include <entwine/third/splice-pool/splice-pool.hpp>
+#include <entwine/tree/balancer.hpp>
+#include <entwine/tree/block-directory.hpp>
 #include <entwine/tree/chunk.hpp>
 #include <entwine/tree/climber.hpp>
 #include <entwine/tree/clipper.hpp>
+#include <entwine/tree/cold.hpp>
 #include <entwine/tree/registry.hpp>
 #include <entwine/tree/tiler.hpp>
 #include <entwine/tree/traverser.hpp>
@@ -31,6 +35,7 @@
 #include <entwine/types/structure.hpp>
 #include <entwine/types/subset.hpp>
 #include <entwine/util/executor.hpp>
+#include <entwine/util/metrics.hpp>
 #include <entwine/util/pool.hpp>
 
 namespace entwine
@@ -54,6 +59,44 @@ namespace
     {
         return std::max<std::size_t>(total - getWorkThreads(total), 4);
     }
+
+    // Both the work and clip pools are sized to run the whole budget, and
+    // are limited to their shares of it, which may shift during a build.
+    std::size_t getBudget(const std::size_t total)
+    {
+        return getWorkThreads(total) + getClipThreads(total);
+    }
+
+    Counter& insertedPoints(
+            Metrics::counter(
+                "entwine_points_inserted_total",
+                "Points inserted into the tree"));
+
+    Counter& overflowedPoints(
+            Metrics::counter(
+                "entwine_points_overflowed_total",
+                "Points discarded after exceeding the maximum tree depth"));
+
+    Counter& outOfBoundsPoints(
+            Metrics::counter(
+                "entwine_points_out_of_bounds_total",
+                "Points discarded for falling outside of the bounds"));
+
+    Histogram& fileInsertTime(
+            Metrics::histogram(
+                "entwine_file_insert_seconds",
+                "Time to read and insert a single input file",
+                std::vector<double> { 1, 5, 15, 30, 60, 120, 300, 600, 1800 }));
+
+    Counter& mergedChunks(
+            Metrics::counter(
+                "entwine_merge_chunks_total",
+                "Chunks whose points were reinserted while merging"));
+
+    Counter& mergedPoints(
+            Metrics::counter(
+                "entwine_merge_points_total",
+                "Points reinserted while merging"));
 }
 
 Builder::Builder(
@@ -82,7 +125,7 @@ Builder::Builder(
     , m_trustHeaders(trustHeaders)
     , m_isContinuation(false)
     , m_srs()
-    , m_pool(new Pool(getWorkThreads(totalThreads)))
+    , m_pool(new Pool(getBudget(totalThreads), 1, "work"))
     , m_initialWorkThreads(getWorkThreads(totalThreads))
     , m_initialClipThreads(getClipThreads(totalThreads))
     , m_totalThreads(totalThreads)
@@ -91,6 +134,7 @@ Builder::Builder(
     , m_origin(0)
     , m_end(0)
     , m_added(0)
+    , m_aborted(false)
     , m_arbiter(outerScope.getArbiter())
     , m_outEndpoint(new Endpoint(m_arbiter->getEndpoint(outPath)))
     , m_tmpEndpoint(new Endpoint(m_arbiter->getEndpoint(tmpPath)))
@@ -107,7 +151,8 @@ Builder::Builder(
         m_bbox->cubeify();
     }
 
-    m_registry.reset(new Registry(*m_outEndpoint, *this, m_initialClipThreads));
+    m_registry.reset(
+            new Registry(*m_outEndpoint, *this, getBudget(totalThreads)));
     prep();
 }
 
@@ -131,7 +176,7 @@ Builder::Builder(
     , m_trustHeaders(false)
     , m_isContinuation(true)
     , m_srs()
-    , m_pool(new Pool(getWorkThreads(totalThreads)))
+    , m_pool(new Pool(getBudget(totalThreads), 1, "work"))
     , m_initialWorkThreads(getWorkThreads(totalThreads))
     , m_initialClipThreads(getClipThreads(totalThreads))
     , m_totalThreads(totalThreads)
@@ -140,6 +185,7 @@ Builder::Builder(
     , m_origin(0)
     , m_end(0)
     , m_added(0)
+    , m_aborted(false)
     , m_arbiter(outerScope.getArbiter())
     , m_outEndpoint(new Endpoint(m_arbiter->getEndpoint(outPath)))
     , m_tmpEndpoint(new Endpoint(m_arbiter->getEndpoint(tmpPath)))
@@ -149,14 +195,17 @@ Builder::Builder(
     , m_hierarchy()
 {
     prep();
-    load(outerScope, m_initialClipThreads, pf);
+    load(outerScope, getBudget(totalThreads), pf);
 
-    if (!subsetJson.empty())
+    // Prefer the persisted subset, since a balanced subset's cell range is
+    // not present in the user-supplied configuration.
+    if (!m_subset && !subsetJson.empty())
     {
         m_subset.reset(new Subset(*m_structure, *m_bbox, subsetJson));
-        m_subBBox.reset(new BBox(m_subset->bbox()));
     }
 
+    if (m_subset) m_subBBox.reset(new BBox(m_subset->bbox()));
+
     m_hierarchy->awakenAll();
 }
 
@@ -165,7 +214,8 @@ Builder::Builder(
         const std::size_t totalThreads,
         const std::size_t* subsetId,
         const std::size_t* splitBegin,
-        OuterScope outerScope)
+        OuterScope outerScope,
+        const bool lazy)
     : m_bboxConforming()
     , m_bbox()
     , m_subBBox()
@@ -179,7 +229,7 @@ Builder::Builder(
     , m_trustHeaders(true)
     , m_isContinuation(true)
     , m_srs()
-    , m_pool(new Pool(getWorkThreads(totalThreads)))
+    , m_pool(new Pool(getBudget(totalThreads), 1, "work"))
     , m_initialWorkThreads(getWorkThreads(totalThreads))
     , m_initialClipThreads(getClipThreads(totalThreads))
     , m_totalThreads(0)
@@ -188,6 +238,7 @@ Builder::Builder(
     , m_origin(0)
     , m_end(0)
     , m_added(0)
+    , m_aborted(false)
     , m_arbiter(outerScope.getArbiter())
     , m_outEndpoint(new Endpoint(m_arbiter->getEndpoint(path)))
     , m_tmpEndpoint()
@@ -197,7 +248,7 @@ Builder::Builder(
     , m_hierarchy()
 {
     prep();
-    load(outerScope, subsetId, splitBegin);
+    load(outerScope, subsetId, splitBegin, lazy);
 }
 
 std::unique_ptr<Builder> Builder::create(
@@ -258,16 +309,33 @@ void Builder::go(std::size_t max)
         throw std::runtime_error("Cannot add to read-only builder");
     }
 
-    m_end = m_manifest->size();
-
-    if (const Manifest::Split* split = m_manifest->split())
     {
-        m_origin = split->begin();
-        m_end = split->end();
+        // Work may be taken concurrently from another thread.
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_end = m_manifest->size();
+
+        if (const Manifest::Split* split = m_manifest->split())
+        {
+            m_origin = split->begin();
+            m_end = split->end();
+        }
     }
 
     max = max ? std::min<std::size_t>(m_end, max) : m_end;
 
+    std::unique_ptr<Balancer> balancer;
+
+    if (Cold* cold = m_registry->cold())
+    {
+        balancer.reset(
+                new Balancer(
+                    *m_pool,
+                    cold->clipPool(),
+                    m_initialWorkThreads + m_initialClipThreads,
+                    insertedPoints));
+    }
+
     while (keepGoing() && m_added < max)
     {
         FileInfo& info(m_manifest->get(m_origin));
@@ -315,6 +383,14 @@ void Builder::go(std::size_t max)
 
     std::cout << "\tPushes complete - joining..." << std::endl;
     m_pool->join();
+    balancer.reset();
+
+    if (m_aborted)
+    {
+        std::cout << "\tJoined - aborted, not saving" << std::endl;
+        return;
+    }
+
     std::cout << "\tJoined - saving..." << std::endl;
     save();
 }
@@ -363,6 +439,8 @@ bool Builder::checkBounds(
 
 bool Builder::insertPath(const Origin origin, FileInfo& info)
 {
+    Span span(fileInsertTime, "Builder::insertPath");
+
     auto localHandle(m_arbiter->getLocalHandle(info.path(), *m_tmpEndpoint));
     const std::string& localPath(localHandle->localPath());
 
@@ -401,8 +479,8 @@ bool Builder::insertPath(const Origin origin, FileInfo& info)
 
     Clipper clipper(*this, origin);
 
-    Hierarchy localHierarchy(*m_bbox, *m_nodePool);
-    Climber climber(*m_bbox, *m_structure, &localHierarchy);
+    Shard shard(m_hierarchy->shard());
+    Climber climber(*m_bbox, *m_structure, shard.get());
 
     auto inserter([this, origin, &clipper, &climber, &s]
     (PooledInfoStack infoStack)
@@ -420,11 +498,7 @@ bool Builder::insertPath(const Origin origin, FileInfo& info)
 
     PooledPointTable table(*m_pointPool, inserter, m_originId, origin);
 
-    const bool result(m_executor->run(table, localPath, m_reprojection.get()));
-
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_hierarchy->merge(localHierarchy);
-    return result;
+    return m_executor->run(table, localPath, m_reprojection.get());
 }
 
 PooledInfoStack Builder::insertData(
@@ -448,7 +522,7 @@ PooledInfoStack Builder::insertData(
 
         if (m_bboxConforming->contains(point))
         {
-            if (!m_subBBox || m_subBBox->contains(point))
+            if (!m_subset || m_subset->contains(point))
             {
                 climber.reset();
                 climber.magnifyTo(point, m_structure->baseDepthBegin());
@@ -477,13 +551,18 @@ PooledInfoStack Builder::insertData(
 
     if (origin != invalidOrigin) m_manifest->add(origin, pointStats);
 
+    insertedPoints.add(pointStats.inserts());
+    overflowedPoints.add(pointStats.overflows());
+    outOfBoundsPoints.add(pointStats.outOfBounds());
+
     return rejected;
 }
 
 void Builder::load(
         OuterScope outerScope,
         const std::size_t clipThreads,
-        const std::string pf)
+        const std::string pf,
+        const bool lazy)
 {
     Json::Value meta;
     Json::Reader reader;
@@ -507,22 +586,33 @@ void Builder::load(
         }
     }
 
+    if (lazy)
     {
-        const std::string strIds(
-                m_outEndpoint->getSubpath("entwine-ids" + pf));
-
-        if (!reader.parse(strIds, meta["ids"], false)) error();
+        loadProps(outerScope, meta, pf);
+        return;
     }
 
+    const std::vector<char> manifestData(fetchManifest(pf, true));
+    const bool binaryManifest(Manifest::isBinary(manifestData));
+
+    if (!binaryManifest)
     {
+        // Legacy JSON manifest.
         const std::string strManifest(
-                m_outEndpoint->getSubpath("entwine-manifest" + pf));
+                manifestData.begin(),
+                manifestData.end());
 
         if (!reader.parse(strManifest, meta["manifest"], false)) error();
     }
 
     loadProps(outerScope, meta, pf);
 
+    if (binaryManifest) m_manifest.reset(new Manifest(manifestData));
+
+    const ChunkIds ids(
+            *m_structure,
+            m_outEndpoint->getSubpathBinary("entwine-ids" + pf));
+
     m_executor.reset(new Executor(m_structure->is3d()));
     m_originId = m_schema->pdalLayout().findDim("Origin");
 
@@ -531,23 +621,69 @@ void Builder::load(
                 *m_outEndpoint,
                 *this,
                 clipThreads,
-                meta["ids"]));
+                ids));
 }
 
 void Builder::load(
         OuterScope outerScope,
         const std::size_t* subsetId,
-        const std::size_t* splitBegin)
+        const std::size_t* splitBegin,
+        const bool lazy)
 {
     std::string post(
             (subsetId ? "-" + std::to_string(*subsetId) : "") +
             (splitBegin ? "-" + std::to_string(*splitBegin) : ""));
 
-    load(outerScope, 0, post);
+    load(outerScope, 0, post, lazy);
+}
+
+std::vector<char> Builder::fetchManifest(
+        const std::string pf,
+        const bool fullManifest) const
+{
+    const std::string subpath("entwine-manifest" + pf);
+
+    if (!fullManifest)
+    {
+        const std::size_t headerSize(Manifest::binaryHeaderSize());
+
+        if (!m_outEndpoint->isRemote())
+        {
+            std::ifstream file(
+                    m_outEndpoint->fullPath(subpath),
+                    std::ifstream::in | std::ifstream::binary);
+
+            std::vector<char> header(headerSize);
+            if (file.read(header.data(), header.size()))
+            {
+                if (Manifest::isBinary(header)) return header;
+            }
+        }
+        else
+        {
+            const std::string path(
+                    m_outEndpoint->type() + "://" +
+                    m_outEndpoint->fullPath(subpath));
+
+            if (m_arbiter->isHttpDerived(path))
+            {
+                http::Headers range;
+                range["Range"] =
+                    "bytes=0-" + std::to_string(headerSize - 1);
+
+                const auto header(m_arbiter->getBinary(path, range));
+                if (Manifest::isBinary(header)) return header;
+            }
+        }
+    }
+
+    return m_outEndpoint->getSubpathBinary(subpath);
 }
 
 void Builder::save()
 {
+    if (m_aborted) throw std::runtime_error("Cannot save an aborted build");
+
     const auto pf(postfix());
     m_registry->save();
 
@@ -560,7 +696,6 @@ std::map<std::string, std::string> Builder::propsToSave() const
     std::map<std::string, std::string> props;
 
     const auto pf(postfix());
-    Json::FastWriter writer;
 
     {
         Json::Value jsonMeta(saveOwnProps());
@@ -568,13 +703,15 @@ std::map<std::string, std::string> Builder::propsToSave() const
     }
 
     {
-        Json::Value jsonIds(m_registry->toJson());
-        props["entwine-ids" + pf] = writer.write(jsonIds);
+        const std::vector<char> binaryIds(m_registry->ids().toBinary());
+        props["entwine-ids" + pf] =
+            std::string(binaryIds.begin(), binaryIds.end());
     }
 
     {
-        Json::Value jsonManifest(m_manifest->toJson());
-        props["entwine-manifest" + pf] = writer.write(jsonManifest);
+        const std::vector<char> binaryManifest(m_manifest->toBinary());
+        props["entwine-manifest" + pf] =
+            std::string(binaryManifest.begin(), binaryManifest.end());
     }
 
     return props;
@@ -599,7 +736,7 @@ void Builder::unsplit(Builder& other)
     if (BaseChunk* otherBase = other.m_registry->base())
     {
         PointStatsMap pointStatsMap;
-        Hierarchy localHierarchy(*m_bbox, *m_nodePool);
+        Shard shard(m_hierarchy->shard());
         Clipper clipper(*this, 0);
 
         insertHinted(
@@ -607,75 +744,71 @@ void Builder::unsplit(Builder& other)
                 otherBase->acquire(m_pointPool->infoPool()),
                 pointStatsMap,
                 clipper,
-                localHierarchy,
+                *shard,
                 Id(0),
                 m_structure->baseDepthBegin(),
                 m_structure->baseDepthEnd());
 
         m_manifest->add(pointStatsMap);
-        m_hierarchy->merge(localHierarchy);
     }
 
     std::cout << "Base overflow: " << countReserves() << "\n" << std::endl;
 
-    BinaryPointTable binaryTable(*m_schema);
-    pdal::PointRef pointRef(binaryTable, 0);
-    PointStatsMap pointStatsMap;
-
-    const std::set<Id> otherIds(other.registry().ids());
+    const ChunkIds otherIds(other.registry().ids());
+    const std::size_t threads(m_pool->limit());
 
     Traverser traverser(*this, &otherIds);
-    traverser.tree([&](std::unique_ptr<Branch> branch)
-    {
-        Branch* rawBranch(branch.release());
-
-        m_pool->add([&]()
-        {
-            std::unique_ptr<Branch> branch(rawBranch);
-            const auto cold(m_structure->coldDepthBegin());
-
-            PointStatsMap pointStatsMap;
-            Hierarchy localHierarchy(*m_bbox, *m_nodePool);
-            Clipper clipper(*this, 0);
-
-            branch->recurse(cold, [&](const Id& chunkId, std::size_t depth)
+    traverser.each(
+            threads,
+            threads * 2,
+            [this, &other](const Id& chunkId)
             {
-                std::cout << "\nAdding " << chunkId << " " << depth << std::endl;
-
-                auto compressed(
-                    m_outEndpoint->getSubpathBinary(
+                return m_outEndpoint->getSubpathBinary(
                         m_structure->maybePrefix(chunkId) +
-                        other.postfix(true)));
-
-                const auto tail(Chunk::popTail(compressed));
-
-                PooledInfoStack infoStack(
-                        Compression::decompress(
-                            compressed,
-                            tail.numPoints,
-                            *m_pointPool));
+                        other.postfix(true));
+            },
+            [this, &reserves](
+                const FrontierChunk& chunk,
+                std::vector<char>& compressed)
+            {
+                mergedChunks.add();
+
+                PooledInfoStack infoStack(m_pointPool->infoPool());
+
+                BlockDirectory::segments(
+                        compressed.data(),
+                        compressed.size(),
+                        [this, &infoStack](
+                            const char* segment,
+                            const std::size_t size,
+                            const std::size_t numPoints)
+                        {
+                            infoStack.push(
+                                    Compression::decompress(
+                                        segment,
+                                        size,
+                                        numPoints,
+                                        *m_pointPool));
+                        });
 
                 compressed.clear();
 
+                PointStatsMap pointStatsMap;
+                Shard shard(m_hierarchy->shard());
+                Clipper clipper(*this, 0);
+
                 insertHinted(
                     reserves,
                     std::move(infoStack),
                     pointStatsMap,
                     clipper,
-                    localHierarchy,
-                    chunkId,
-                    depth,
-                    depth + 1);
-            });
+                    *shard,
+                    chunk.chunkId,
+                    chunk.depth,
+                    chunk.depth + 1);
 
-            m_manifest->add(pointStatsMap);
-
-            std::lock_guard<std::mutex> lock(m_mutex);
-            m_hierarchy->merge(localHierarchy);
-        });
-    });
-
-    m_pool->join();
+                m_manifest->add(pointStatsMap);
+            });
 
     std::cout << "Rejected more: " << countReserves() << std::endl;
 
@@ -687,14 +820,14 @@ void Builder::insertHinted(
         PooledInfoStack infoStack,
         PointStatsMap& pointStatsMap,
         Clipper& clipper,
-        Hierarchy& localHierarchy,
+        Hierarchy& hierarchy,
         const Id& chunkId,
         const std::size_t depthBegin,
         const std::size_t depthEnd)
 {
-    std::cout << "Inserting: " << infoStack.size() << std::endl;
+    mergedPoints.add(infoStack.size());
 
-    Climber climber(*m_bbox, *m_structure, &localHierarchy);
+    Climber climber(*m_bbox, *m_structure, &hierarchy);
 
     Origin origin(0);
 
@@ -812,9 +945,13 @@ Json::Value Builder::saveOwnProps() const
     props["bbox"] = m_bbox->toJson();
     props["schema"] = m_schema->toJson();
     props["structure"] = m_structure->toJson();
+    // Insertion is finished by now, so the whole thread budget is available
+    // for uploads.  Unlike m_totalThreads, this is also set for builders
+    // loaded for merging.
     props["hierarchy"] = m_hierarchy->toJson(
             m_outEndpoint->getSubEndpoint("h"),
-            postfix());
+            postfix(),
+            m_pool->numThreads());
 
     // The infallible numPoints value is in the manifest, which is stored
     // elsewhere to avoid the Reader needing it.  For the Reader, then,
@@ -873,6 +1010,8 @@ void Builder::loadProps(
 
 void Builder::prep()
 {
+    m_pool->limit(m_initialWorkThreads);
+
     if (m_tmpEndpoint)
     {
         if (m_tmpEndpoint->isRemote())
@@ -933,6 +1072,12 @@ void Builder::stop()
     std::cout << "Setting end at " << m_end << std::endl;
 }
 
+void Builder::abort()
+{
+    m_aborted = true;
+    stop();
+}
+
 void Builder::makeWhole()
 {
     if (m_subset) m_subset.reset();
@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstddef>
 #include <memory>
 #include <mutex>
@@ -137,6 +138,12 @@ public:
     // build later.
     void stop();
 
+    // Stop as with stop(), but discard the results: no further chunks are
+    // written, and nothing is saved.  Used when this build no longer owns
+    // its work, so another builder may be writing the same output.
+    void abort();
+    bool aborted() const { return m_aborted; }
+
     // Set up our metadata as finished with merging.
     void makeWhole();
 
@@ -176,12 +183,18 @@ public:
     // us with enough metadata info to fetch the other pieces directly.
     //
     // Also used for traversing.
+    //
+    // If _lazy_ is true, only the top-level metadata is loaded.  The registry
+    // and manifest are not awakened, so the caller is responsible for
+    // fetching chunk IDs, the base chunk, and the manifest if it needs them.
+    // Used by the Reader.
     Builder(
             std::string path,
             std::size_t threads = 1,
             const std::size_t* subsetId = nullptr,
             const std::size_t* splitBegin = nullptr,
-            OuterScope outerScope = OuterScope());
+            OuterScope outerScope = OuterScope(),
+            bool lazy = false);
 
 private:
     // Attempt to wake up a subset or split build with indeterminate metadata
@@ -222,7 +235,7 @@ private:
             PooledInfoStack infoStack,
             PointStatsMap& pointStatsMap,
             Clipper& clipper,
-            Hierarchy& localHierarchy,
+            Hierarchy& hierarchy,
             const Id& chunkId,
             std::size_t depthBegin,
             std::size_t depthEnd = 0);
@@ -234,12 +247,18 @@ private:
     void load(
             OuterScope outerScope,
             std::size_t clipThreads,
-            std::string postfix = "");
+            std::string postfix = "",
+            bool lazy = false);
 
     void load(
             OuterScope outerScope,
             const std::size_t* subsetId,
-            const std::size_t* splitBegin);
+            const std::size_t* splitBegin,
+            bool lazy);
+
+    // Fetch the serialized manifest.  If _fullManifest_ is false, only the
+    // header of a binary manifest is fetched when possible.
+    std::vector<char> fetchManifest(std::string pf, bool fullManifest) const;
 
     // Validate sources.
     void prep();
@@ -295,6 +314,7 @@ private:
     Origin m_origin;
     Origin m_end;
     std::size_t m_added;
+    std::atomic_bool m_aborted;
     std::size_t m_numPointsClone;
 
     std::shared_ptr<arbiter::Arbiter> m_arbiter;
@@ -0,0 +1,271 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/tree/chunk-ids.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <entwine/third/json/json.hpp>
+
+namespace entwine
+{
+
+namespace
+{
+    const std::size_t maxFastTrackers(std::pow(4, 12));
+
+    const std::string magic("ECID");
+
+    // Dense range encodings.
+    const uint8_t bitsetEncoding(0);
+    const uint8_t listEncoding(1);
+
+    template<typename T>
+    void push(std::vector<char>& data, const T val)
+    {
+        const char* pos(reinterpret_cast<const char*>(&val));
+        data.insert(data.end(), pos, pos + sizeof(T));
+    }
+
+    template<typename T>
+    T extract(const char*& pos, const char* end)
+    {
+        if (pos + sizeof(T) > end)
+        {
+            throw std::runtime_error("Truncated chunk IDs");
+        }
+
+        T val;
+        std::memcpy(&val, pos, sizeof(T));
+        pos += sizeof(T);
+        return val;
+    }
+}
+
+ChunkIds::ChunkIds(const Structure& structure)
+    : m_structure(structure)
+    , m_fast(numFastTrackers(structure), false)
+    , m_numFast(0)
+    , m_slow()
+{ }
+
+ChunkIds::ChunkIds(const Structure& structure, const std::vector<char>& data)
+    : m_structure(structure)
+    , m_fast(numFastTrackers(structure), false)
+    , m_numFast(0)
+    , m_slow()
+{
+    if (
+            data.size() >= magic.size() &&
+            std::equal(magic.begin(), magic.end(), data.begin()))
+    {
+        fromBinary(data);
+    }
+    else
+    {
+        fromJson(data);
+    }
+}
+
+void ChunkIds::insert(const Id& id)
+{
+    const std::size_t chunkNum(m_structure.getInfo(id).chunkNum());
+
+    if (chunkNum < m_fast.size())
+    {
+        insertFast(chunkNum);
+    }
+    else if (m_slow.empty() || m_slow.back() < id)
+    {
+        m_slow.push_back(id);
+    }
+    else
+    {
+        auto it(std::lower_bound(m_slow.begin(), m_slow.end(), id));
+        if (*it != id) m_slow.insert(it, id);
+    }
+}
+
+void ChunkIds::insertFast(const std::size_t chunkNum)
+{
+    if (!m_fast[chunkNum])
+    {
+        m_fast[chunkNum] = true;
+        ++m_numFast;
+    }
+}
+
+bool ChunkIds::has(const Id& id) const
+{
+    if (id < m_structure.coldIndexBegin()) return false;
+
+    const std::size_t chunkNum(m_structure.getInfo(id).chunkNum());
+
+    if (chunkNum < m_fast.size()) return m_fast[chunkNum];
+    else return std::binary_search(m_slow.begin(), m_slow.end(), id);
+}
+
+std::vector<char> ChunkIds::toBinary() const
+{
+    std::vector<char> data(magic.begin(), magic.end());
+
+    push<uint64_t>(data, m_fast.size());
+
+    // Sparse builds will have few of the dense range set, in which case a
+    // list of chunk numbers is smaller than the bitset.
+    const std::size_t bitsetBytes((m_fast.size() + 7) / 8);
+
+    if (m_numFast * sizeof(uint64_t) < bitsetBytes)
+    {
+        push<uint8_t>(data, listEncoding);
+        push<uint64_t>(data, m_numFast);
+
+        for (std::size_t i(0); i < m_fast.size(); ++i)
+        {
+            if (m_fast[i]) push<uint64_t>(data, i);
+        }
+    }
+    else
+    {
+        push<uint8_t>(data, bitsetEncoding);
+
+        std::vector<char> bits(bitsetBytes, 0);
+
+        for (std::size_t i(0); i < m_fast.size(); ++i)
+        {
+            if (m_fast[i]) bits[i / 8] |= (1 << (i % 8));
+        }
+
+        data.insert(data.end(), bits.begin(), bits.end());
+    }
+
+    push<uint64_t>(data, m_slow.size());
+
+    for (const Id& id : m_slow)
+    {
+        push<uint64_t>(data, id.blockSize());
+        for (const auto block : id.val()) push<uint64_t>(data, block);
+    }
+
+    return data;
+}
+
+std::size_t ChunkIds::numFastTrackers(const Structure& structure)
+{
+    std::size_t count(0);
+    std::size_t depth(structure.coldDepthBegin());
+
+    while (
+            count < maxFastTrackers &&
+            depth < 64 &&
+            (depth < structure.coldDepthEnd() || !structure.coldDepthEnd()))
+    {
+        count += structure.numChunksAtDepth(depth);
+        ++depth;
+    }
+
+    return count;
+}
+
+void ChunkIds::fromBinary(const std::vector<char>& data)
+{
+    const char* pos(data.data() + magic.size());
+    const char* end(data.data() + data.size());
+
+    if (extract<uint64_t>(pos, end) != m_fast.size())
+    {
+        throw std::runtime_error("Chunk IDs do not match this structure");
+    }
+
+    const uint8_t encoding(extract<uint8_t>(pos, end));
+
+    if (encoding == listEncoding)
+    {
+        const std::size_t count(extract<uint64_t>(pos, end));
+
+        for (std::size_t i(0); i < count; ++i)
+        {
+            const std::size_t chunkNum(extract<uint64_t>(pos, end));
+            if (chunkNum >= m_fast.size())
+            {
+                throw std::runtime_error("Invalid chunk number");
+            }
+
+            insertFast(chunkNum);
+        }
+    }
+    else if (encoding == bitsetEncoding)
+    {
+        const std::size_t bitsetBytes((m_fast.size() + 7) / 8);
+        if (pos + bitsetBytes > end)
+        {
+            throw std::runtime_error("Truncated chunk IDs");
+        }
+
+        for (std::size_t i(0); i < m_fast.size(); ++i)
+        {
+            if (pos[i / 8] & (1 << (i % 8))) insertFast(i);
+        }
+
+        pos += bitsetBytes;
+    }
+    else
+    {
+        throw std::runtime_error("Invalid chunk ID encoding");
+    }
+
+    const std::size_t numSlow(extract<uint64_t>(pos, end));
+    m_slow.reserve(numSlow);
+
+    for (std::size_t i(0); i < numSlow; ++i)
+    {
+        const std::size_t numBlocks(extract<uint64_t>(pos, end));
+
+        Id id(0);
+        auto& blocks(id.val());
+        blocks.clear();
+
+        for (std::size_t b(0); b < numBlocks; ++b)
+        {
+            blocks.push_back(extract<uint64_t>(pos, end));
+        }
+
+        if (blocks.empty()) blocks.push_back(0);
+
+        m_slow.push_back(id);
+    }
+}
+
+void ChunkIds::fromJson(const std::vector<char>& data)
+{
+    Json::Reader reader;
+    Json::Value json;
+
+    if (!reader.parse(std::string(data.begin(), data.end()), json, false))
+    {
+        throw std::runtime_error(
+                "Invalid JSON: " + reader.getFormattedErrorMessages());
+    }
+
+    if (!json.isArray()) return;
+
+    for (Json::ArrayIndex i(0); i < json.size(); ++i)
+    {
+        insert(Id(json[i].asString()));
+    }
+}
+
+} // namespace entwine
+
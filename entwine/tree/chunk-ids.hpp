@@ -0,0 +1,76 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <entwine/tree/point-info.hpp>
+#include <entwine/types/structure.hpp>
+
+namespace entwine
+{
+
+// A compact set of cold chunk IDs.  Chunks whose chunk numbers fall within
+// the fast-tracked range of the Cold are stored in a dense bitset indexed by
+// chunk number, and any others are stored in a sorted vector.
+class ChunkIds
+{
+public:
+    explicit ChunkIds(const Structure& structure);
+
+    // Parse from the result of ChunkIds::toBinary, or from a legacy JSON
+    // array of base-10 ID strings.
+    ChunkIds(const Structure& structure, const std::vector<char>& data);
+
+    // Not thread-safe.
+    void insert(const Id& id);
+    void insertFast(std::size_t chunkNum);
+
+    bool has(const Id& id) const;
+    std::size_t size() const { return m_numFast + m_slow.size(); }
+
+    // Call _f_ with each ID in ascending order.
+    template<typename F> void each(const F& f) const;
+
+    const std::vector<bool>& fast() const { return m_fast; }
+    const std::vector<Id>& slow() const { return m_slow; }
+
+    std::vector<char> toBinary() const;
+
+    // The number of chunks, starting at the beginning of the cold depths,
+    // that are tracked in the dense range.
+    static std::size_t numFastTrackers(const Structure& structure);
+
+private:
+    void fromBinary(const std::vector<char>& data);
+    void fromJson(const std::vector<char>& data);
+
+    const Structure& m_structure;
+
+    std::vector<bool> m_fast;
+    std::size_t m_numFast;
+
+    std::vector<Id> m_slow;
+};
+
+template<typename F> void ChunkIds::each(const F& f) const
+{
+    for (std::size_t i(0); i < m_fast.size(); ++i)
+    {
+        if (m_fast[i]) f(m_structure.getInfoFromNum(i).chunkId());
+    }
+
+    for (const auto& id : m_slow) f(id);
+}
+
+} // namespace entwine
+
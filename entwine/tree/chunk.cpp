@@ -10,14 +10,18 @@
 
 #include <entwine/tree/chunk.hpp>
 
+#include <algorithm>
+
 #include <pdal/Dimension.hpp>
 #include <pdal/PointView.hpp>
 
 #include <entwine/compression/util.hpp>
 #include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/tree/block-directory.hpp>
 #include <entwine/tree/builder.hpp>
 #include <entwine/tree/climber.hpp>
 #include <entwine/types/pooled-point-table.hpp>
+#include <entwine/util/metrics.hpp>
 #include <entwine/util/storage.hpp>
 
 namespace entwine
@@ -29,6 +33,23 @@ namespace
     std::atomic_size_t chunkCnt(0);
 
     const std::string tubeIdDim("TubeId");
+
+    Gauge& residentChunks(
+            Metrics::gauge(
+                "entwine_chunks_resident",
+                "Chunks currently held in memory",
+                []() { return chunkCnt.load(); }));
+
+    Gauge& residentCells(
+            Metrics::gauge(
+                "entwine_chunk_cells_resident",
+                "Occupied cells of chunks currently held in memory",
+                []() { return chunkMem.load(); }));
+
+    Histogram& compressTime(
+            Metrics::histogram(
+                "entwine_chunk_compress_seconds",
+                "Time to serialize and compress a chunk for saving"));
 }
 
 Chunk::Chunk(
@@ -90,39 +111,82 @@ std::unique_ptr<Chunk> Chunk::create(
         const Id& id,
         const Id& maxPoints,
         std::unique_ptr<std::vector<char>> data)
+{
+    return create(
+            builder,
+            bbox,
+            depth,
+            id,
+            maxPoints,
+            data->data(),
+            data->size());
+}
+
+std::unique_ptr<Chunk> Chunk::create(
+        const Builder& builder,
+        const BBox& bbox,
+        const std::size_t depth,
+        const Id& id,
+        const Id& maxPoints,
+        const char* data,
+        const std::size_t size)
 {
     std::unique_ptr<Chunk> chunk;
 
-    const Tail tail(popTail(*data));
-    const std::size_t points(tail.numPoints);
+    const Tail tail(getTail(data, size));
 
-    if (tail.type == Contiguous)
+    if (tail.type == Contiguous && !depth)
     {
-        if (depth)
-        {
-            chunk.reset(
-                    new ContiguousChunk(
-                        builder,
-                        bbox,
-                        depth,
-                        id,
-                        maxPoints,
-                        std::move(data),
-                        points));
-        }
-        else
-        {
-            chunk.reset(
-                    new BaseChunk(
-                        builder,
-                        bbox,
-                        id,
-                        maxPoints,
-                        std::move(data),
-                        points));
-        }
+        chunk.reset(
+                new BaseChunk(
+                    builder,
+                    bbox,
+                    id,
+                    maxPoints,
+                    data,
+                    size - tailSize,
+                    tail.numPoints));
+
+        return chunk;
+    }
+
+    PooledInfoStack infoStack(builder.pointPool().infoPool());
+
+    const Tail inner(
+            BlockDirectory::segments(
+                data,
+                size,
+                [&builder, &infoStack](
+                    const char* segment,
+                    const std::size_t segmentSize,
+                    const std::size_t numPoints)
+                {
+                    infoStack.push(
+                            Compression::decompress(
+                                segment,
+                                segmentSize,
+                                numPoints,
+                                builder.pointPool()));
+                }));
+
+    if (inner.type != Invalid && inner.numPoints != infoStack.size())
+    {
+        // TODO Non-recoverable.  Exit?
+        throw std::runtime_error("Bad numPoints detected - " + id.str());
+    }
+
+    if (inner.type == Contiguous)
+    {
+        chunk.reset(
+                new ContiguousChunk(
+                    builder,
+                    bbox,
+                    depth,
+                    id,
+                    maxPoints,
+                    std::move(infoStack)));
     }
-    else if (tail.type == Sparse)
+    else if (inner.type == Sparse)
     {
         chunk.reset(
                 new SparseChunk(
@@ -131,8 +195,7 @@ std::unique_ptr<Chunk> Chunk::create(
                     depth,
                     id,
                     maxPoints,
-                    std::move(data),
-                    points));
+                    std::move(infoStack)));
     }
 
     return chunk;
@@ -150,36 +213,32 @@ void Chunk::pushTail(std::vector<char>& data, const Chunk::Tail tail)
 
 Chunk::Tail Chunk::popTail(std::vector<char>& data)
 {
-    // Pop type.
+    const Tail tail(getTail(data.data(), data.size()));
+    if (tail.type != Invalid) data.resize(data.size() - tailSize);
+    return tail;
+}
+
+Chunk::Tail Chunk::getTail(const char* data, const std::size_t size)
+{
+    if (size < tailSize) return Tail(0, Invalid);
+
+    // Read type.
     Chunk::Type type;
 
-    if (!data.empty())
-    {
-        const int marker(data.back());
-        data.pop_back();
+    const int marker(data[size - 1]);
 
-        if (marker == Sparse) type = Sparse;
-        else if (marker == Contiguous) type = Contiguous;
-        else return Tail(0, Invalid);
-    }
-    else
-    {
-        return Tail(0, Invalid);
-    }
+    if (marker == Sparse) type = Sparse;
+    else if (marker == Contiguous) type = Contiguous;
+    else return Tail(0, Invalid);
 
-    // Pop numPoints.
+    // Read numPoints.
     uint64_t numPoints(0);
-    const std::size_t size(sizeof(uint64_t));
-
-    if (data.size() < size) return Tail(0, Invalid);
 
     std::copy(
-            data.data() + data.size() - size,
-            data.data() + data.size(),
+            data + size - tailSize,
+            data + size - 1,
             reinterpret_cast<char*>(&numPoints));
 
-    data.resize(data.size() - size);
-
     return Tail(numPoints, type);
 }
 
@@ -205,27 +264,14 @@ SparseChunk::SparseChunk(
         const std::size_t depth,
         const Id& id,
         const Id& maxPoints,
-        std::unique_ptr<std::vector<char>> compressedData,
-        const std::size_t numPoints)
-    : Chunk(builder, bbox, depth, id, maxPoints, numPoints)
+        PooledInfoStack infoStack)
+    : Chunk(builder, bbox, depth, id, maxPoints, infoStack.size())
     , m_tubes()
     , m_mutex()
 {
     chunkMem.fetch_add(m_numPoints);
 
     // TODO This is direct copy/paste from the ContiguousChunk ctor.
-    PooledInfoStack infoStack(
-            Compression::decompress(
-                *compressedData,
-                m_numPoints,
-                m_builder.pointPool()));
-
-    if (m_numPoints != infoStack.size())
-    {
-        // TODO Non-recoverable.  Exit?
-        throw std::runtime_error("Bad numPoints detected - sparse chunk");
-    }
-
     const Climber startClimber(builder.bbox(), builder.structure());
     Climber climber(startClimber);
 
@@ -264,34 +310,58 @@ Cell& SparseChunk::getCell(const Climber& climber)
     return result.second;
 }
 
-void SparseChunk::save(arbiter::Endpoint& endpoint)
+std::future<void> SparseChunk::save(arbiter::Endpoint& endpoint)
 {
     // TODO Nearly direct copy/paste from ContiguousChunk::save.
-    Compressor compressor(m_builder.schema(), m_numPoints);
+    Span span(compressTime, "Chunk::compress");
+
+    BlockWriter writer(
+            m_builder.schema(),
+            m_numPoints,
+            m_builder.structure().chunkBlocks());
+
     std::vector<char> data;
 
     PooledDataStack dataStack(m_builder.pointPool().dataPool());
     PooledInfoStack infoStack(m_builder.pointPool().infoPool());
 
-    for (const auto& pair : m_tubes)
+    // Blocks are only spatially coherent if tubes are written in index
+    // order, which the hash map does not provide.
+    std::vector<const TubeMap::value_type*> tubes;
+    tubes.reserve(m_tubes.size());
+    for (const auto& pair : m_tubes) tubes.push_back(&pair);
+
+    if (m_builder.structure().chunkBlocks() > 1)
     {
-        pair.second.save(m_builder.schema(), data, dataStack, infoStack);
+        std::sort(
+                tubes.begin(),
+                tubes.end(),
+                [](const TubeMap::value_type* a, const TubeMap::value_type* b)
+                {
+                    return a->first < b->first;
+                });
+    }
+
+    for (const auto* pair : tubes)
+    {
+        pair->second.save(m_builder.schema(), data, dataStack, infoStack);
 
         if (data.size())
         {
-            compressor.push(data.data(), data.size());
+            writer.push(data.data(), data.size());
             data.clear();
         }
     }
 
-    std::unique_ptr<std::vector<char>> compressed(compressor.data());
+    std::unique_ptr<std::vector<char>> compressed(writer.data(Sparse));
     dataStack.reset();
     infoStack.reset();
-    pushTail(*compressed, Tail(m_numPoints, Sparse));
-    Storage::ensurePut(
+    span.stop();
+
+    return Storage::put(
             endpoint,
             m_builder.structure().maybePrefix(m_id) + m_builder.postfix(true),
-            *compressed);
+            std::move(compressed));
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -314,25 +384,12 @@ ContiguousChunk::ContiguousChunk(
         const std::size_t depth,
         const Id& id,
         const Id& maxPoints,
-        std::unique_ptr<std::vector<char>> compressedData,
-        const std::size_t numPoints)
-    : Chunk(builder, bbox, depth, id, maxPoints, numPoints)
+        PooledInfoStack infoStack)
+    : Chunk(builder, bbox, depth, id, maxPoints, infoStack.size())
     , m_tubes(maxPoints.getSimple())
 {
     chunkMem.fetch_add(m_tubes.size());
 
-    PooledInfoStack infoStack(
-            Compression::decompress(
-                *compressedData,
-                m_numPoints,
-                m_builder.pointPool()));
-
-    if (m_numPoints != infoStack.size())
-    {
-        // TODO Non-recoverable.  Exit?
-        throw std::runtime_error("Bad numPoints detected - contiguous chunk");
-    }
-
     const Climber startClimber(builder.bbox(), builder.structure());
     Climber climber(startClimber);
 
@@ -366,9 +423,15 @@ Cell& ContiguousChunk::getCell(const Climber& climber)
     return result.second;
 }
 
-void ContiguousChunk::save(arbiter::Endpoint& endpoint)
+std::future<void> ContiguousChunk::save(arbiter::Endpoint& endpoint)
 {
-    Compressor compressor(m_builder.schema(), m_numPoints);
+    Span span(compressTime, "Chunk::compress");
+
+    BlockWriter writer(
+            m_builder.schema(),
+            m_numPoints,
+            m_builder.structure().chunkBlocks());
+
     std::vector<char> data;
 
     PooledDataStack dataStack(m_builder.pointPool().dataPool());
@@ -380,19 +443,20 @@ void ContiguousChunk::save(arbiter::Endpoint& endpoint)
 
         if (data.size())
         {
-            compressor.push(data.data(), data.size());
+            writer.push(data.data(), data.size());
             data.clear();
         }
     }
 
-    std::unique_ptr<std::vector<char>> compressed(compressor.data());
+    std::unique_ptr<std::vector<char>> compressed(writer.data(Contiguous));
     dataStack.reset();
     infoStack.reset();
-    pushTail(*compressed, Tail(m_numPoints, Contiguous));
-    Storage::ensurePut(
+    span.stop();
+
+    return Storage::put(
             endpoint,
             m_builder.structure().maybePrefix(m_id) + m_builder.postfix(true),
-            *compressed);
+            std::move(compressed));
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -411,7 +475,8 @@ BaseChunk::BaseChunk(
         const BBox& bbox,
         const Id& id,
         const Id& maxPoints,
-        std::unique_ptr<std::vector<char>> compressedData,
+        const char* compressed,
+        const std::size_t size,
         const std::size_t numPoints)
     : ContiguousChunk(builder, bbox, 0, id, maxPoints)
     , m_celledSchema(makeCelled(m_builder.schema()))
@@ -420,7 +485,11 @@ BaseChunk::BaseChunk(
     m_numPoints = numPoints;
 
     std::unique_ptr<std::vector<char>> data(
-        Compression::decompress(*compressedData, m_celledSchema, m_numPoints));
+        Compression::decompress(
+            compressed,
+            size,
+            m_celledSchema,
+            m_numPoints));
 
     const char* pos(data->data());
 
@@ -456,12 +525,7 @@ BaseChunk::BaseChunk(
         table.setPoint(pos);
 
         PooledInfoNode info(infoStack.popOne());
-        info->construct(
-                Point(
-                    pointRef.getFieldAs<double>(pdal::Dimension::Id::X),
-                    pointRef.getFieldAs<double>(pdal::Dimension::Id::Y),
-                    pointRef.getFieldAs<double>(pdal::Dimension::Id::Z)),
-                dataStack.popOne());
+        info->construct(m_celledSchema.point(pointRef), dataStack.popOne());
 
         std::copy(pos + dataOffset, pos + celledPointSize, info->val().data());
 
@@ -490,8 +554,10 @@ Schema BaseChunk::makeCelled(const Schema& in)
     return Schema(dims);
 }
 
-void BaseChunk::save(arbiter::Endpoint& endpoint)
+std::future<void> BaseChunk::save(arbiter::Endpoint& endpoint)
 {
+    Span span(compressTime, "Chunk::compress");
+
     Compressor compressor(m_celledSchema, m_numPoints);
     std::vector<char> data;
 
@@ -513,7 +579,12 @@ void BaseChunk::save(arbiter::Endpoint& endpoint)
     dataStack.reset();
     infoStack.reset();
     pushTail(*compressed, Tail(m_numPoints, Contiguous));
-    Storage::ensurePut(endpoint, m_id.str() + m_builder.postfix(), *compressed);
+    span.stop();
+
+    return Storage::put(
+            endpoint,
+            m_id.str() + m_builder.postfix(),
+            std::move(compressed));
 }
 
 void BaseChunk::merge(BaseChunk& other)
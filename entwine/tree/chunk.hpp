@@ -13,6 +13,7 @@
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <future>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
@@ -69,10 +70,22 @@ public:
             const Id& maxPoints,
             std::unique_ptr<std::vector<char>> data);
 
+    // Creates a chunk from serialized data which is only read, and need not
+    // outlive the call.
+    static std::unique_ptr<Chunk> create(
+            const Builder& builder,
+            const BBox& bbox,
+            std::size_t depth,
+            const Id& id,
+            const Id& maxPoints,
+            const char* data,
+            std::size_t size);
+
     enum Type
     {
         Sparse = 0,
         Contiguous,
+        Blocked,    // See BlockDirectory.
         Invalid
     };
 
@@ -86,16 +99,26 @@ public:
         Type type;
     };
 
+    // Serialized size of a Tail, which follows the compressed points.
+    static const std::size_t tailSize = sizeof(uint64_t) + 1;
+
     static void pushTail(std::vector<char>& data, Tail tail);
     static Tail popTail(std::vector<char>& data);
 
+    // Reads the Tail from the end of _data_ without modifying it.  If the
+    // result is valid, the compressed points occupy the first _size_ minus
+    // tailSize bytes.
+    static Tail getTail(const char* data, std::size_t size);
+
     static std::size_t getChunkMem();
     static std::size_t getChunkCnt();
 
     const Id& maxPoints() const { return m_maxPoints; }
     const Id& id() const { return m_id; }
 
-    virtual void save(arbiter::Endpoint& endpoint) = 0;
+    // Compress this chunk and begin writing it.  The returned future
+    // completes once written, or throws a StorageError.
+    virtual std::future<void> save(arbiter::Endpoint& endpoint) = 0;
     virtual Cell& getCell(const Climber& climber) = 0;
 
 protected:
@@ -126,12 +149,11 @@ public:
             std::size_t depth,
             const Id& id,
             const Id& maxPoints,
-            std::unique_ptr<std::vector<char>> compressedData,
-            std::size_t numPoints);
+            PooledInfoStack infoStack);
 
     ~SparseChunk();
 
-    virtual void save(arbiter::Endpoint& endpoint) override;
+    virtual std::future<void> save(arbiter::Endpoint& endpoint) override;
     virtual Cell& getCell(const Climber& climber) override;
 
 private:
@@ -143,7 +165,8 @@ private:
         return rawIndex - m_id;
     }
 
-    std::unordered_map<Id, Tube> m_tubes;
+    typedef std::unordered_map<Id, Tube> TubeMap;
+    TubeMap m_tubes;
     std::mutex m_mutex;
 };
 
@@ -163,12 +186,11 @@ public:
             std::size_t depth,
             const Id& id,
             const Id& maxPoints,
-            std::unique_ptr<std::vector<char>> compressedData,
-            std::size_t numPoints);
+            PooledInfoStack infoStack);
 
     ~ContiguousChunk();
 
-    virtual void save(arbiter::Endpoint& endpoint) override;
+    virtual std::future<void> save(arbiter::Endpoint& endpoint) override;
     virtual Cell& getCell(const Climber& climber) override;
 
     const Tube& getTube(const Id& index) const
@@ -202,10 +224,11 @@ public:
             const BBox& bbox,
             const Id& id,
             const Id& maxPoints,
-            std::unique_ptr<std::vector<char>> compressedData,
+            const char* compressed,
+            std::size_t size,
             std::size_t numPoints);
 
-    virtual void save(arbiter::Endpoint& endpoint) override;
+    virtual std::future<void> save(arbiter::Endpoint& endpoint) override;
 
     PooledInfoStack acquire(InfoPool& infoPool);
     void merge(BaseChunk& other);
@@ -10,6 +10,7 @@
 
 #include <entwine/tree/cold.hpp>
 
+#include <algorithm>
 #include <chrono>
 #include <thread>
 
@@ -20,6 +21,7 @@
 #include <entwine/tree/clipper.hpp>
 #include <entwine/types/point.hpp>
 #include <entwine/types/schema.hpp>
+#include <entwine/util/mapped-file.hpp>
 #include <entwine/util/pool.hpp>
 #include <entwine/util/storage.hpp>
 
@@ -32,25 +34,6 @@ namespace
 
     const std::size_t maxCreateTries(8);
     const auto createSleepTime(std::chrono::milliseconds(500));
-
-    const std::size_t maxFastTrackers(std::pow(4, 12));
-
-    std::size_t getNumFastTrackers(const Structure& structure)
-    {
-        std::size_t count(0);
-        std::size_t depth(structure.coldDepthBegin());
-
-        while (
-                count < maxFastTrackers &&
-                depth < 64 &&
-                (depth < structure.coldDepthEnd() || !structure.coldDepthEnd()))
-        {
-            count += structure.numChunksAtDepth(depth);
-            ++depth;
-        }
-
-        return count;
-    }
 }
 
 Cold::Cold(
@@ -59,52 +42,50 @@ Cold::Cold(
         const std::size_t clipPoolSize)
     : m_endpoint(endpoint)
     , m_builder(builder)
-    , m_chunkVec(getNumFastTrackers(builder.structure()))
+    , m_chunkVec(ChunkIds::numFastTrackers(builder.structure()))
     , m_chunkMap()
     , m_mapMutex()
-    , m_pool(new Pool(clipPoolSize, clipQueueSize))
+    , m_pool(new Pool(clipPoolSize, clipQueueSize, "clip"))
+    , m_saves()
+    , m_errors()
+    , m_saveMutex()
 { }
 
 Cold::Cold(
         arbiter::Endpoint& endpoint,
         const Builder& builder,
         const std::size_t clipPoolSize,
-        const Json::Value& jsonIds)
+        const ChunkIds& ids)
     : m_endpoint(endpoint)
     , m_builder(builder)
-    , m_chunkVec(getNumFastTrackers(builder.structure()))
+    , m_chunkVec(ChunkIds::numFastTrackers(builder.structure()))
     , m_chunkMap()
     , m_mapMutex()
-    , m_pool(new Pool(clipPoolSize, clipQueueSize))
+    , m_pool(new Pool(clipPoolSize, clipQueueSize, "clip"))
+    , m_saves()
+    , m_errors()
+    , m_saveMutex()
 {
-    if (jsonIds.isArray())
-    {
-        Id id(0);
-
-        const Structure& structure(m_builder.structure());
+    const std::vector<bool>& fast(ids.fast());
 
-        for (std::size_t i(0); i < jsonIds.size(); ++i)
-        {
-            id = Id(jsonIds[static_cast<Json::ArrayIndex>(i)].asString());
-
-            const ChunkInfo chunkInfo(structure.getInfo(id));
-            const std::size_t chunkNum(chunkInfo.chunkNum());
+    for (std::size_t i(0); i < fast.size() && i < m_chunkVec.size(); ++i)
+    {
+        if (fast[i]) m_chunkVec[i].mark.store(true);
+    }
 
-            if (chunkNum < m_chunkVec.size())
-            {
-                m_chunkVec[chunkNum].mark.store(true);
-            }
-            else
-            {
-                std::unique_ptr<CountedChunk> c(new CountedChunk());
-                m_chunkMap.emplace(id, std::move(c));
-            }
-        }
+    for (const Id& id : ids.slow())
+    {
+        std::unique_ptr<CountedChunk> c(new CountedChunk());
+        m_chunkMap.emplace(id, std::move(c));
     }
 }
 
 Cold::~Cold()
-{ }
+{
+    // Pending writes refer to our endpoint, so they must finish first.
+    m_pool->join();
+    for (auto& saved : m_saves) saved.wait();
+}
 
 Cell& Cold::getCell(const Climber& climber, Clipper& clipper)
 {
@@ -134,35 +115,27 @@ Cell& Cold::getCell(const Climber& climber, Clipper& clipper)
     return countedChunk->chunk->getCell(climber);
 }
 
-std::set<Id> Cold::ids() const
+ChunkIds Cold::ids() const
 {
-    std::set<Id> results(m_fauxIds);
-
-    const Structure& structure(m_builder.structure());
+    ChunkIds results(m_builder.structure());
 
     for (std::size_t i(0); i < m_chunkVec.size(); ++i)
     {
-        if (m_chunkVec[i].mark.load())
-        {
-            ChunkInfo info(structure.getInfoFromNum(i));
-            results.insert(info.chunkId());
-        }
+        if (m_chunkVec[i].mark.load()) results.insertFast(i);
     }
 
-    std::lock_guard<std::mutex> lock(m_mapMutex);
-    for (const auto& p : m_chunkMap)
+    std::vector<Id> others(m_fauxIds.begin(), m_fauxIds.end());
+
     {
-        results.insert(p.first);
+        std::lock_guard<std::mutex> lock(m_mapMutex);
+        for (const auto& p : m_chunkMap) others.push_back(p.first);
     }
 
-    return results;
-}
+    // Insert in order so the sorted vector is only appended.
+    std::sort(others.begin(), others.end());
+    for (const Id& id : others) results.insert(id);
 
-Json::Value Cold::toJson() const
-{
-    Json::Value json;
-    for (const auto& id : ids()) json.append(id.str());
-    return json;
+    return results;
 }
 
 void Cold::growFast(const Climber& climber, Clipper& clipper)
@@ -195,7 +168,7 @@ void Cold::growFast(const Climber& climber, Clipper& clipper)
             ++countedChunk->refs[clipper.id()];
         }
 
-        ensureChunk(climber, countedChunk->chunk, exists);
+        ensureChunk(climber, *countedChunk, exists);
     }
 }
 
@@ -224,7 +197,7 @@ void Cold::growSlow(const Climber& climber, Clipper& clipper)
             ++countedChunk->refs[clipper.id()];
         }
 
-        ensureChunk(climber, countedChunk->chunk, exists);
+        ensureChunk(climber, *countedChunk, exists);
     }
 }
 
@@ -235,10 +208,20 @@ void Cold::growFaux(const Id& id)
 
 void Cold::ensureChunk(
         const Climber& climber,
-        std::unique_ptr<Chunk>& chunk,
+        CountedChunk& countedChunk,
         const bool exists)
 {
     const Id& chunkId(climber.chunkId());
+    std::unique_ptr<Chunk>& chunk(countedChunk.chunk);
+
+    // A chunk clipped and then touched again may still be being written, in
+    // which case reading it now could find the previous or a partial object.
+    // Throws if the write failed.
+    if (!chunk && countedChunk.saved.valid())
+    {
+        countedChunk.saved.get();
+        countedChunk.saved = std::shared_future<void>();
+    }
 
     std::size_t tries(0);
     while (!chunk)
@@ -249,16 +232,31 @@ void Cold::ensureChunk(
                     m_builder.structure().maybePrefix(chunkId) +
                     m_builder.postfix(true));
 
-            auto data(Storage::ensureGet(m_endpoint, path));
-
-            chunk =
-                    Chunk::create(
-                        m_builder,
-                        climber.bboxChunk(),
-                        climber.depth(),
-                        chunkId,
-                        climber.chunkPoints(),
-                        std::move(data));
+            // Chunks are only read while being created, so a local chunk
+            // may be read directly from a mapping of its file.
+            if (auto mapped = MappedFile::map(m_endpoint, path))
+            {
+                chunk =
+                        Chunk::create(
+                            m_builder,
+                            climber.bboxChunk(),
+                            climber.depth(),
+                            chunkId,
+                            climber.chunkPoints(),
+                            mapped->data(),
+                            mapped->size());
+            }
+            else
+            {
+                chunk =
+                        Chunk::create(
+                            m_builder,
+                            climber.bboxChunk(),
+                            climber.depth(),
+                            chunkId,
+                            climber.chunkPoints(),
+                            Storage::ensureGet(m_endpoint, path));
+            }
         }
         else
         {
@@ -284,9 +282,7 @@ void Cold::ensureChunk(
             }
             else
             {
-                std::cout << "Invalid chunk at " << chunkId << std::endl;
-                std::cout << "Non-recoverable error - exiting" << std::endl;
-                exit(1);
+                throw std::runtime_error("Invalid chunk at " + chunkId.str());
             }
         }
     }
@@ -304,7 +300,8 @@ void Cold::clip(
 
         m_pool->add([this, &countedChunk, id]()
         {
-            unrefChunk(countedChunk, id, true);
+            try { unrefChunk(countedChunk, id, true); }
+            catch (std::exception& e) { addError(e.what()); }
         });
     }
     else
@@ -315,7 +312,8 @@ void Cold::clip(
 
         m_pool->add([this, &countedChunk, id]()
         {
-            unrefChunk(countedChunk, id, false);
+            try { unrefChunk(countedChunk, id, false); }
+            catch (std::exception& e) { addError(e.what()); }
         });
     }
 }
@@ -334,28 +332,93 @@ void Cold::unrefChunk(
 
     if (countedChunk.refs.empty())
     {
-        if (countedChunk.chunk)
+        if (countedChunk.chunk && m_builder.aborted())
+        {
+            // Another builder may own this output now.
+            countedChunk.chunk.reset(nullptr);
+        }
+        else if (countedChunk.chunk)
         {
-            countedChunk.chunk->save(m_endpoint);
+            // The compressed data is owned by the write, so the chunk may be
+            // released without waiting for it.  A later reload of this chunk
+            // waits for the write first.
+            countedChunk.saved = countedChunk.chunk->save(m_endpoint).share();
+            addSave(countedChunk.saved);
             countedChunk.chunk.reset(nullptr);
         }
         else
         {
-            std::cout << "Tried to clip null chunk - ";
-            std::cout << (fast ? "fast" : "slow") << std::endl;
-            exit(1);
+            throw std::runtime_error(
+                    std::string("Tried to clip null chunk - ") +
+                    (fast ? "fast" : "slow"));
+        }
+    }
+}
+
+void Cold::addSave(std::shared_future<void> saved)
+{
+    std::lock_guard<std::mutex> lock(m_saveMutex);
+
+    auto it(m_saves.begin());
+
+    while (it != m_saves.end())
+    {
+        if (
+                it->wait_for(std::chrono::seconds(0)) ==
+                std::future_status::ready)
+        {
+            try { it->get(); }
+            catch (std::exception& e) { m_errors.push_back(e.what()); }
+
+            it = m_saves.erase(it);
+        }
+        else
+        {
+            ++it;
         }
     }
+
+    m_saves.push_back(std::move(saved));
+}
+
+void Cold::addError(const std::string& error)
+{
+    std::lock_guard<std::mutex> lock(m_saveMutex);
+    m_errors.push_back(error);
+}
+
+void Cold::await()
+{
+    // Clip tasks may still be running after insertion has finished.
+    m_pool->join();
+    m_pool->go();
+
+    std::lock_guard<std::mutex> lock(m_saveMutex);
+
+    for (auto& saved : m_saves)
+    {
+        try { saved.get(); }
+        catch (std::exception& e) { m_errors.push_back(e.what()); }
+    }
+
+    m_saves.clear();
+
+    if (!m_errors.empty())
+    {
+        throw std::runtime_error(
+                "Failed to save " + std::to_string(m_errors.size()) +
+                " chunk(s), first: " + m_errors.front());
+    }
 }
 
 void Cold::merge(const Cold& other)
 {
-    for (const Id& id : other.ids()) m_fauxIds.insert(id);
+    other.ids().each([this](const Id& id) { m_fauxIds.insert(id); });
 }
 
 std::size_t Cold::clipThreads() const
 {
-    return m_pool->numThreads();
+    return m_pool->limit();
 }
 
 } // namespace entwine
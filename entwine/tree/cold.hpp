@@ -12,13 +12,14 @@
 
 #include <atomic>
 #include <cstddef>
+#include <future>
 #include <memory>
 #include <mutex>
 #include <set>
 #include <unordered_set>
 #include <unordered_map>
 
-#include <entwine/third/json/json.hpp>
+#include <entwine/tree/chunk-ids.hpp>
 #include <entwine/tree/point-info.hpp>
 
 namespace arbiter
@@ -48,20 +49,26 @@ public:
             arbiter::Endpoint& endpoint,
             const Builder& builder,
             std::size_t clipPoolSize,
-            const Json::Value& meta);
+            const ChunkIds& ids);
 
     ~Cold();
 
     Cell& getCell(const Climber& climber, Clipper& clipper);
 
-    Json::Value toJson() const;
     void clip(const Id& chunkId, std::size_t chunkNum, std::size_t id);
 
-    std::set<Id> ids() const;
+    ChunkIds ids() const;
     void merge(const Cold& other);
 
     std::size_t clipThreads() const;
 
+    // Wait for all pending clips and chunk writes.  Throws if any chunk
+    // could not be saved, since the index would then be incomplete.
+    void await();
+
+    // Chunk saves run here.  Clipping blocks while this pool is saturated.
+    Pool& clipPool() { return *m_pool; }
+
 private:
     void growFast(const Climber& climber, Clipper& clipper);
     void growSlow(const Climber& climber, Clipper& clipper);
@@ -72,15 +79,23 @@ private:
         std::unique_ptr<Chunk> chunk;
         std::unordered_map<std::size_t, std::size_t> refs;
         std::mutex mutex;
+
+        // The most recent write of this chunk, which must complete before
+        // the chunk may be read back.
+        std::shared_future<void> saved;
     };
 
     void ensureChunk(
             const Climber& climber,
-            std::unique_ptr<Chunk>& chunk,
+            CountedChunk& countedChunk,
             bool exists);
 
     void unrefChunk(CountedChunk& countedChunk, std::size_t id, bool fast);
 
+    // Track a chunk write, reaping any which have completed.
+    void addSave(std::shared_future<void> saved);
+    void addError(const std::string& error);
+
     struct FastSlot
     {
         FastSlot() : mark(false), flag(), chunk()
@@ -105,6 +120,10 @@ private:
 
     mutable std::mutex m_mapMutex;
     std::unique_ptr<Pool> m_pool;
+
+    std::vector<std::shared_future<void>> m_saves;
+    std::vector<std::string> m_errors;
+    std::mutex m_saveMutex;
 };
 
 } // namespace entwine
@@ -61,13 +61,40 @@ namespace
     std::unique_ptr<Subset> getSubset(
             const Json::Value& json,
             Structure& structure,
-            const BBox& bbox)
+            const BBox& bbox,
+            const Manifest* manifest)
     {
         std::unique_ptr<Subset> subset;
 
         if (json.isMember("subset"))
         {
-            subset.reset(new Subset(structure, bbox, json["subset"]));
+            Json::Value subsetJson(json["subset"]);
+
+            if (
+                    subsetJson["balanced"].asBool() &&
+                    !subsetJson.isMember("depth"))
+            {
+                if (!manifest)
+                {
+                    throw std::runtime_error(
+                            "Balanced subsets require an input manifest");
+                }
+
+                const std::size_t id(subsetJson["id"].asUInt64());
+                const std::size_t of(subsetJson["of"].asUInt64());
+
+                if (!id || id > of)
+                {
+                    throw std::runtime_error("Invalid subset ID");
+                }
+
+                const Json::Value partitions(
+                        Subset::partition(*manifest, bbox, of));
+
+                subsetJson = partitions[static_cast<Json::ArrayIndex>(id - 1)];
+            }
+
+            subset.reset(new Subset(structure, bbox, subsetJson));
         }
 
         return subset;
@@ -85,6 +112,7 @@ std::unique_ptr<Builder> ConfigParser::getBuilder(
     const Json::Value jsonInput(config["input"]);
     const bool trustHeaders(jsonInput["trustHeaders"].asBool());
     const std::size_t threads(jsonInput["threads"].asUInt64());
+    const std::string inferenceCache(jsonInput["inferenceCache"].asString());
 
     // Build specifications and path info.
     const Json::Value& jsonOutput(config["output"]);
@@ -109,6 +137,7 @@ std::unique_ptr<Builder> ConfigParser::getBuilder(
     const bool dynamicChunks(jsonStructure["dynamicChunks"].asBool());
     const bool discardDuplicates(jsonStructure["discardDuplicates"].asBool());
     const bool prefixIds(jsonStructure["prefixIds"].asBool());
+    const std::size_t chunkBlocks(jsonStructure["chunkBlocks"].asUInt64());
 
     std::size_t numPointsHint(
             jsonStructure.isMember("numPointsHint") ?
@@ -119,6 +148,7 @@ std::unique_ptr<Builder> ConfigParser::getBuilder(
     auto bboxConforming(getBBox(geometry["bbox"], dimensions == 3 || tubular));
     auto reprojection(getReprojection(geometry["reproject"]));
     Schema schema(geometry["schema"]);
+    const double precision(geometry["precision"].asDouble());
 
     bool exists(false);
     std::string postfix;
@@ -170,7 +200,8 @@ std::unique_ptr<Builder> ConfigParser::getBuilder(
                 true,
                 reprojection.get(),
                 trustHeaders,
-                arbiter.get());
+                arbiter.get(),
+                inferenceCache);
 
         inference.go();
         manifest.reset(new Manifest(inference.manifest()));
@@ -218,6 +249,8 @@ std::unique_ptr<Builder> ConfigParser::getBuilder(
     {
         if (!bboxConforming) throw std::runtime_error("Missing inference");
 
+        if (precision) schema = schema.quantize(*bboxConforming, precision);
+
         Structure structure(
                 nullDepth,
                 baseDepth,
@@ -228,7 +261,8 @@ std::unique_ptr<Builder> ConfigParser::getBuilder(
                 tubular,
                 dynamicChunks,
                 discardDuplicates,
-                prefixIds);
+                prefixIds,
+                chunkBlocks);
 
         // TODO This cubeifying code is duplicated from the Builder constructor.
         BBox cube(*bboxConforming);
@@ -238,7 +272,11 @@ std::unique_ptr<Builder> ConfigParser::getBuilder(
             cube.cubeify();
         }
 
-        std::unique_ptr<Subset> subset(getSubset(config, structure, cube));
+        std::unique_ptr<Subset> subset(getSubset(
+                    config,
+                    structure,
+                    cube,
+                    manifest.get()));
 
         builder.reset(
                 new Builder(
@@ -0,0 +1,321 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/tree/coordinator.hpp>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+
+namespace entwine
+{
+
+namespace
+{
+    const std::string pendingDir("pending");
+    const std::string activeDir("active");
+    const std::string doneDir("done");
+    const std::string hungryDir("hungry");
+
+    // Create a file only if it does not exist.  Returns false if it did.
+    bool create(const std::string& path)
+    {
+        const int fd(open(path.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0644));
+        if (fd < 0) return false;
+
+        close(fd);
+        return true;
+    }
+
+    bool exists(const std::string& path)
+    {
+        struct stat info;
+        return stat(path.c_str(), &info) == 0;
+    }
+}
+
+Coordinator::Coordinator(const std::string dir, const std::string worker)
+    : m_dir(arbiter::fs::expandTilde(dir))
+    , m_worker(worker)
+    , m_active()
+    , m_mutex()
+{
+    for (const auto& sub : { pendingDir, activeDir, doneDir, hungryDir })
+    {
+        if (!arbiter::fs::mkdirp(m_dir + "/" + sub))
+        {
+            throw std::runtime_error("Could not create " + m_dir + "/" + sub);
+        }
+    }
+}
+
+Coordinator::~Coordinator()
+{
+    hungry(false);
+}
+
+bool Coordinator::init(const std::size_t size, std::size_t splits)
+{
+    if (!create(m_dir + "/init")) return false;
+
+    splits = std::max<std::size_t>(std::min(splits, size), 1);
+
+    for (std::size_t i(0); i < splits; ++i)
+    {
+        const std::size_t begin(size * i / splits);
+        const std::size_t end(size * (i + 1) / splits);
+
+        publish(Manifest::Split(begin, end));
+    }
+
+    create(m_dir + "/ready");
+
+    return true;
+}
+
+std::unique_ptr<Manifest::Split> Coordinator::claim()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_active) throw std::runtime_error("A split is already active");
+
+    std::vector<std::string> pending(list(pendingDir));
+
+    // Prefer the lowest ranges, since they were published first.
+    std::sort(
+            pending.begin(),
+            pending.end(),
+            [](const std::string& a, const std::string& b)
+            {
+                return parse(a).begin() < parse(b).begin();
+            });
+
+    for (const auto& p : pending)
+    {
+        const std::string claimed(activePath(parse(p)));
+
+        if (std::rename(path(pendingDir, p).c_str(), claimed.c_str()) == 0)
+        {
+            // Start our lease now rather than at publish time.
+            utimes(claimed.c_str(), nullptr);
+
+            m_active.reset(new Manifest::Split(parse(p)));
+            return std::unique_ptr<Manifest::Split>(
+                    new Manifest::Split(*m_active));
+        }
+    }
+
+    return std::unique_ptr<Manifest::Split>();
+}
+
+bool Coordinator::handOff(const Manifest::Split& remainder)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_active) throw std::runtime_error("No split is active");
+
+    const Manifest::Split shrunk(m_active->begin(), remainder.begin());
+
+    const std::string from(activePath(*m_active));
+    const std::string to(activePath(shrunk));
+
+    if (std::rename(from.c_str(), to.c_str()) != 0)
+    {
+        std::cout << "Lost lease on " << name(*m_active) << std::endl;
+        return false;
+    }
+
+    m_active.reset(new Manifest::Split(shrunk));
+
+    publish(remainder);
+    return true;
+}
+
+bool Coordinator::renew()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_active) return false;
+
+    return utimes(activePath(*m_active).c_str(), nullptr) == 0;
+}
+
+void Coordinator::finish()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_active) throw std::runtime_error("No split is active");
+
+    const std::string from(activePath(*m_active));
+    const std::string to(path(doneDir, name(*m_active)));
+
+    if (std::rename(from.c_str(), to.c_str()) != 0)
+    {
+        throw std::runtime_error("Lost lease on " + name(*m_active));
+    }
+
+    m_active.reset();
+}
+
+void Coordinator::hungry(const bool hungry)
+{
+    const std::string marker(path(hungryDir, m_worker));
+
+    if (hungry) create(marker);
+    else unlink(marker.c_str());
+}
+
+bool Coordinator::othersHungry() const
+{
+    const std::vector<std::string> hungry(list(hungryDir));
+
+    const std::size_t others(
+            std::count_if(
+                hungry.begin(),
+                hungry.end(),
+                [this](const std::string& h) { return h != m_worker; }));
+
+    return others > list(pendingDir).size();
+}
+
+bool Coordinator::ready() const
+{
+    return exists(m_dir + "/ready");
+}
+
+bool Coordinator::complete() const
+{
+    return ready() && list(pendingDir).empty() && list(activeDir).empty();
+}
+
+std::size_t Coordinator::numPending() const
+{
+    return list(pendingDir).size();
+}
+
+std::size_t Coordinator::numActive() const
+{
+    return list(activeDir).size();
+}
+
+std::size_t Coordinator::numDone() const
+{
+    return list(doneDir).size();
+}
+
+std::size_t Coordinator::reclaim(const std::size_t seconds)
+{
+    std::size_t reclaimed(0);
+    const std::time_t now(std::time(nullptr));
+
+    for (const auto& a : list(activeDir))
+    {
+        const std::string active(path(activeDir, a));
+
+        struct stat info;
+        if (stat(active.c_str(), &info) != 0) continue;
+
+        if (now - info.st_mtime > static_cast<std::time_t>(seconds))
+        {
+            const std::string split(a.substr(0, a.find('.')));
+            const std::string pending(path(pendingDir, split));
+
+            if (std::rename(active.c_str(), pending.c_str()) == 0)
+            {
+                std::cout << "Reclaimed expired lease: " << a << std::endl;
+                ++reclaimed;
+            }
+        }
+    }
+
+    return reclaimed;
+}
+
+std::string Coordinator::workerName()
+{
+    std::vector<char> host(256, 0);
+    if (gethostname(host.data(), host.size() - 1) != 0) host[0] = 0;
+
+    return std::string(host.data()) + "-" + std::to_string(getpid());
+}
+
+std::vector<std::string> Coordinator::list(const std::string& sub) const
+{
+    std::vector<std::string> results;
+
+    if (DIR* dir = opendir((m_dir + "/" + sub).c_str()))
+    {
+        while (const dirent* entry = readdir(dir))
+        {
+            const std::string name(entry->d_name);
+            if (!name.empty() && name.front() != '.') results.push_back(name);
+        }
+
+        closedir(dir);
+    }
+
+    return results;
+}
+
+std::string Coordinator::path(
+        const std::string& sub,
+        const std::string& name) const
+{
+    return m_dir + "/" + sub + "/" + name;
+}
+
+std::string Coordinator::activePath(const Manifest::Split& split) const
+{
+    return path(activeDir, name(split) + "." + m_worker);
+}
+
+void Coordinator::publish(const Manifest::Split& split)
+{
+    // Create the file outside of the pending directory, then move it in, so
+    // it can never be claimed before it exists.
+    const std::string tmp(m_dir + "/." + name(split) + "." + m_worker);
+    if (!create(tmp)) throw std::runtime_error("Could not create " + tmp);
+
+    if (std::rename(tmp.c_str(), path(pendingDir, name(split)).c_str()) != 0)
+    {
+        throw std::runtime_error("Could not publish split " + name(split));
+    }
+}
+
+std::string Coordinator::name(const Manifest::Split& split)
+{
+    return std::to_string(split.begin()) + "-" + std::to_string(split.end());
+}
+
+Manifest::Split Coordinator::parse(const std::string& name)
+{
+    const std::size_t dash(name.find('-'));
+    if (dash == std::string::npos)
+    {
+        throw std::runtime_error("Invalid split name: " + name);
+    }
+
+    return Manifest::Split(
+            std::stoul(name.substr(0, dash)),
+            std::stoul(name.substr(dash + 1)));
+}
+
+} // namespace entwine
+
@@ -0,0 +1,106 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <entwine/tree/manifest.hpp>
+
+namespace entwine
+{
+
+// Distributes manifest splits between build processes, possibly on different
+// hosts, through a directory on a shared filesystem.  Each unit of work is a
+// file whose name is its split range, and ownership is transferred with
+// atomic renames:
+//
+//      pending/<begin>-<end>           Unclaimed.
+//      active/<begin>-<end>.<worker>   Claimed - the modification time is the
+//                                      lease, which the owner must renew.
+//      done/<begin>-<end>              Built and saved.
+//      hungry/<worker>                 An idle worker wants more work.
+//
+// Busy workers hand off half of their remaining work, via Builder::takeWork,
+// whenever there are more hungry workers than pending splits.
+class Coordinator
+{
+public:
+    Coordinator(std::string dir, std::string worker);
+    ~Coordinator();
+
+    // Create the directory layout and divide _size_ files into _splits_
+    // pending splits.  Returns false if another process has already done so,
+    // in which case this process is attaching to an existing build.
+    bool init(std::size_t size, std::size_t splits);
+
+    // Claim a pending split, or return a null pointer if none are available.
+    // Only one split may be active at a time.
+    std::unique_ptr<Manifest::Split> claim();
+
+    // Publish the remainder of our active split, which has been taken from
+    // our Builder, as pending, and shrink our active split accordingly.
+    // Returns false, publishing nothing, if the lease has been reclaimed -
+    // its full range is then pending already, so our work should be aborted.
+    bool handOff(const Manifest::Split& remainder);
+
+    // Renew the lease on our active split.  Returns false if the lease has
+    // expired and been reclaimed, in which case our work should be stopped.
+    bool renew();
+
+    // Mark our active split as done.
+    void finish();
+
+    void hungry(bool hungry);
+    bool othersHungry() const;
+
+    // True once the initial splits have been published.
+    bool ready() const;
+
+    // True if the layout is ready and no splits are pending or active.
+    bool complete() const;
+
+    // Return any active splits whose leases are older than _seconds_ to the
+    // pending set, so they are rebuilt elsewhere.  Returns the number of
+    // splits reclaimed.
+    std::size_t reclaim(std::size_t seconds);
+
+    std::size_t numPending() const;
+    std::size_t numActive() const;
+    std::size_t numDone() const;
+
+    // A worker name unique across hosts.
+    static std::string workerName();
+
+private:
+    std::vector<std::string> list(const std::string& sub) const;
+    std::string path(const std::string& sub, const std::string& name) const;
+    std::string activePath(const Manifest::Split& split) const;
+    void publish(const Manifest::Split& split);
+
+    static std::string name(const Manifest::Split& split);
+    static Manifest::Split parse(const std::string& name);
+
+    const std::string m_dir;
+    const std::string m_worker;
+
+    std::unique_ptr<Manifest::Split> m_active;
+    mutable std::mutex m_mutex;
+
+    Coordinator(const Coordinator&);
+    Coordinator& operator=(const Coordinator&);
+};
+
+} // namespace entwine
+
@@ -10,12 +10,94 @@
 
 #include <entwine/tree/hierarchy.hpp>
 
+#include <algorithm>
+
+#include <entwine/util/mapped-file.hpp>
+#include <entwine/util/metrics.hpp>
+#include <entwine/util/pool.hpp>
+#include <entwine/util/storage.hpp>
+
 namespace entwine
 {
 
 namespace
 {
     const std::string countKey("n");
+
+    Counter& awakened(
+            Metrics::counter(
+                "entwine_hierarchy_awakened_total",
+                "Hierarchy blocks fetched from storage on demand"));
+
+    Counter& paged(
+            Metrics::counter(
+                "entwine_hierarchy_pages_total",
+                "Flat hierarchy pages fetched from remote storage"));
+
+    const std::size_t recordBytes(sizeof(uint64_t) * 2);
+    const std::size_t pageRecords(4096);
+    const std::size_t maxPages(256);    // 16 MB of remote pages.
+    const std::size_t fileRecords(Hierarchy::defaultChunkBytes / recordBytes);
+
+    std::string flatPath(const std::size_t file, const std::string& postfix)
+    {
+        return "flat-" + std::to_string(file) + postfix;
+    }
+
+    // Uploads blocks on a pool, which blocks additions while all of its
+    // threads are busy.  This bounds the number of serialized blocks held in
+    // memory awaiting upload.
+    class BlockWriter
+    {
+    public:
+        BlockWriter(const arbiter::Endpoint& ep, const std::size_t threads)
+            : m_ep(ep)
+            , m_pool(std::max<std::size_t>(threads, 1))
+            , m_errors()
+            , m_mutex()
+        { }
+
+        // Takes ownership of the contents of _data_, leaving it empty.
+        void write(const std::string path, std::vector<char>& data)
+        {
+            auto shared(std::make_shared<std::vector<char>>());
+            shared->swap(data);
+
+            m_pool.add([this, path, shared]()
+            {
+                try
+                {
+                    m_ep.putSubpath(path, *shared);
+                }
+                catch (std::exception& e)
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_errors.push_back(path + ": " + e.what());
+                }
+            });
+        }
+
+        // Waits for all outstanding uploads, throwing if any of them failed.
+        void join()
+        {
+            m_pool.join();
+
+            if (m_errors.size())
+            {
+                throw std::runtime_error(
+                        "Hierarchy write failed for " +
+                        std::to_string(m_errors.size()) + " blocks - " +
+                        m_errors.front());
+            }
+        }
+
+    private:
+        const arbiter::Endpoint& m_ep;
+        Pool m_pool;
+
+        std::vector<std::string> m_errors;
+        std::mutex m_mutex;
+    };
 }
 
 Node::Node(
@@ -26,6 +108,7 @@ Node::Node(
         const Id id,
         std::size_t depth)
     : m_count()
+    , m_mask(0)
     , m_children()
 {
     assign(nodePool, pos, step, edges, id, depth);
@@ -45,8 +128,13 @@ void Node::assign(
     const uint8_t mask(*pos);
     ++pos;
 
+    m_mask = mask;
+    m_children.clear();
+
     if (mask)
     {
+        m_children.reserve(std::bitset<8>(mask).count());
+
         ++depth;
         const bool exists(!step || depth % step);
 
@@ -62,21 +150,19 @@ void Node::assign(
 
                 if (exists)
                 {
-                    m_children[dir] = nodePool.acquireOne(
-                            nodePool,
-                            pos,
-                            step,
-                            edges,
-                            nextId,
-                            depth);
+                    m_children.push_back(
+                            nodePool.acquireOne(
+                                nodePool,
+                                pos,
+                                step,
+                                edges,
+                                nextId,
+                                depth));
                 }
                 else
                 {
-                    auto it(
-                            m_children.insert(
-                                std::make_pair(dir, nodePool.acquireOne())));
-
-                    edges[nextId] = &it.first->second->val();
+                    m_children.push_back(nodePool.acquireOne());
+                    edges[nextId] = &m_children.back()->val();
                 }
             }
         }
@@ -87,18 +173,30 @@ void Node::merge(Node& other)
 {
     m_count += other.count();
 
-    for (auto& theirs : other.children())
+    Children& theirs(other.children());
+    std::size_t t(0);
+
+    for (std::size_t d(0); d < 8; ++d)
     {
-        auto& mine(m_children[theirs.first]);
-        if (!mine)
+        const uint8_t bit(1 << d);
+        if (!(other.m_mask & bit)) continue;
+
+        PooledNode& node(theirs[t++]);
+        const std::size_t i(index(bit));
+
+        if (m_mask & bit)
         {
-            std::swap(mine, theirs.second);
+            m_children[i]->val().merge(node->val());
         }
         else
         {
-            mine->val().merge(theirs.second->val());
+            m_mask |= bit;
+            m_children.insert(m_children.begin() + i, std::move(node));
         }
     }
+
+    other.m_mask = 0;
+    other.m_children.clear();
 }
 
 void Node::insertInto(Json::Value& json) const
@@ -107,24 +205,49 @@ void Node::insertInto(Json::Value& json) const
 
     if (m_count)
     {
-        for (const auto& c : m_children)
+        eachChild([&json](Dir dir, const Node& child)
         {
-            c.second->val().insertInto(json[dirToString(c.first)]);
-        }
+            child.insertInto(json[dirToString(dir)]);
+        });
+    }
+}
+
+void Node::insertInto(std::vector<char>& data) const
+{
+    if (insertBinary(data))
+    {
+        eachChild([&data](Dir, const Node& child)
+        {
+            child.insertInto(data);
+        });
     }
 }
 
 Node::NodeSet Node::insertInto(
         const arbiter::Endpoint& ep,
         const std::string postfix,
-        const std::size_t step)
+        const std::size_t step,
+        const std::size_t threads)
 {
     NodeSet anchors;
+    BlockWriter blocks(ep, threads);
+
+    const Writer writer([&blocks](
+                const std::string path,
+                std::vector<char>& data)
+    {
+        blocks.write(path, data);
+    });
 
     AnchoredMap slice;
     slice[0] = AnchoredNode(this);
 
-    while (slice.size()) slice = insertSlice(anchors, slice, ep, postfix, step);
+    while (slice.size())
+    {
+        slice = insertSlice(anchors, slice, writer, postfix, step);
+    }
+
+    blocks.join();
 
     return anchors;
 }
@@ -132,7 +255,7 @@ Node::NodeSet Node::insertInto(
 Node::AnchoredMap Node::insertSlice(
         NodeSet& anchors,
         const AnchoredMap& slice,
-        const arbiter::Endpoint& ep,
+        const Writer& writer,
         const std::string postfix,
         const std::size_t step)
 {
@@ -145,7 +268,7 @@ Node::AnchoredMap Node::insertSlice(
     {
         anchors.insert(anchor);
         const std::string path(anchor.str() + (anchor.zero() ? postfix : ""));
-        ep.putSubpath(path, data);
+        writer(path, data);
         data.clear();
 
         if (nextSlice.size())
@@ -191,26 +314,26 @@ void Node::insertData(
     {
         if (!step || ++depth % step)
         {
-            for (auto& c : m_children)
+            eachChild([&](Dir dir, Node& child)
             {
-                c.second->val().insertData(
+                child.insertData(
                         data,
                         nextSlice,
-                        Hierarchy::climb(id, c.first),
+                        Hierarchy::climb(id, dir),
                         step,
                         depth);
-            }
+            });
         }
         else
         {
-            for (auto& c : m_children)
+            eachChild([&](Dir dir, Node& child)
             {
                 nextSlice.insert(
                         nextSlice.end(),
                         std::make_pair(
-                            Hierarchy::climb(id, c.first),
-                            AnchoredNode(&c.second->val())));
-            }
+                            Hierarchy::climb(id, dir),
+                            AnchoredNode(&child)));
+            });
         }
     }
 }
@@ -222,17 +345,7 @@ bool Node::insertBinary(std::vector<char>& s) const
             reinterpret_cast<const char*>(&m_count),
             reinterpret_cast<const char*>(&m_count + 1));
 
-    uint8_t mask(0);
-
-    if (m_count)
-    {
-        for (const auto& c : m_children)
-        {
-            mask |= (1 << static_cast<int>(c.first));
-        }
-    }
-
-    s.push_back(mask);
+    s.push_back(m_count ? m_mask : 0);
 
     return m_count;
 }
@@ -250,9 +363,15 @@ Hierarchy::Hierarchy(
     , m_root()
     , m_edges()
     , m_anchors()
+    , m_awoken()
+    , m_loading()
     , m_mutex()
+    , m_cv()
     , m_endpoint(new arbiter::Endpoint(ep))
     , m_postfix(postfix)
+    , m_shards()
+    , m_outstanding(0)
+    , m_shardMutex()
 {
     const auto bin(ep.tryGetSubpathBinary("0" + postfix));
 
@@ -284,13 +403,112 @@ Hierarchy::Hierarchy(
     {
         std::cout << "No hierarchy data found" << std::endl;
     }
+
+    if (json["flat"].isObject())
+    {
+        m_flat.reset(
+                new FlatHierarchy(
+                    m_bbox,
+                    nodePool,
+                    m_depthBegin,
+                    json["flat"],
+                    ep,
+                    postfix));
+    }
 }
 
 void Hierarchy::awaken(const Id& id, const Node* node)
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unique_lock<std::mutex> lock(m_mutex);
     if (node && node->count()) return;
 
+    const Id anchor(lowerAnchor(id));
+
+    m_cv.wait(lock, [this, &anchor]() { return !m_loading.count(anchor); });
+
+    // If this anchor was loaded while we waited, or previously, then there is
+    // nothing more to fetch.
+    if (m_awoken.count(anchor)) return;
+
+    awakened.add();
+
+    auto it(m_edges.find(anchor));
+    if (it == m_edges.end())
+    {
+        std::cout << ("No edge for lower anchor " + anchor.str()) <<
+            std::endl;
+        throw std::runtime_error("No edge for lower anchor " + anchor.str());
+    }
+
+    const auto upperAnchor(m_anchors.upper_bound(id));
+    const Id edgeEnd(upperAnchor != m_anchors.end() ? *upperAnchor : 0);
+
+    std::vector<std::pair<Id, Node*>> edges;
+
+    while (it != m_edges.end() && (edgeEnd.zero() || it->first < edgeEnd))
+    {
+        edges.push_back(*it);
+        ++it;
+    }
+
+    m_loading.insert(anchor);
+    lock.unlock();
+
+    // Fetch and decode without holding the lock.  The edge nodes themselves
+    // are not touched until the results are published below, since other
+    // queries may be inspecting them.
+    std::vector<Node> decoded;
+    Node::NodeMap newEdges;
+
+    try
+    {
+        const std::vector<char> bin(
+                m_endpoint->getSubpathBinary(anchor.str() + m_postfix));
+
+        const char* pos(bin.data());
+
+        decoded.reserve(edges.size());
+
+        for (const auto& edge : edges)
+        {
+            decoded.emplace_back();
+            decoded.back().assign(
+                    m_nodePool,
+                    pos,
+                    m_step,
+                    newEdges,
+                    edge.first);
+        }
+    }
+    catch (...)
+    {
+        lock.lock();
+        m_loading.erase(anchor);
+        lock.unlock();
+
+        m_cv.notify_all();
+        throw;
+    }
+
+    lock.lock();
+
+    for (std::size_t i(0); i < edges.size(); ++i)
+    {
+        *edges[i].second = std::move(decoded[i]);
+        m_edges.erase(edges[i].first);
+    }
+
+    m_edges.insert(newEdges.begin(), newEdges.end());
+
+    m_awoken.insert(anchor);
+    m_loading.erase(anchor);
+    lock.unlock();
+
+    m_cv.notify_all();
+}
+
+Id Hierarchy::lowerAnchor(const Id& id) const
+{
     auto lowerAnchor(m_anchors.lower_bound(id));
 
     if (lowerAnchor == m_anchors.end())
@@ -315,50 +533,59 @@ void Hierarchy::awaken(const Id& id, const Node* node)
         }
     }
 
-    if (m_awoken.count(*lowerAnchor))
-    {
-        std::cout <<
-                ("REAWAKENING " + lowerAnchor->str() + " for " + id.str()) <<
-                std::endl;
-    }
-    else
-    {
-        std::cout << "Awakening " << *lowerAnchor << std::endl;
-        m_awoken.insert(*lowerAnchor);
-    }
+    return *lowerAnchor;
+}
 
-    auto it(m_edges.find(*lowerAnchor));
-    if (it == m_edges.end())
+Shard Hierarchy::shard()
+{
+    std::unique_ptr<Hierarchy> shard;
+
+    std::unique_lock<std::mutex> lock(m_shardMutex);
+    ++m_outstanding;
+
+    if (!m_shards.empty())
     {
-        std::cout << ("No edge for lower anchor " + lowerAnchor->str()) <<
-            std::endl;
-        throw std::runtime_error(
-                "No edge for lower anchor " + lowerAnchor->str());
+        shard = std::move(m_shards.back());
+        m_shards.pop_back();
     }
 
-    const auto upperAnchor(m_anchors.upper_bound(id));
-    const Id edgeEnd(upperAnchor != m_anchors.end() ? *upperAnchor : 0);
+    lock.unlock();
 
-    const std::vector<char> bin(
-            m_endpoint->getSubpathBinary(lowerAnchor->str() + m_postfix));
+    if (!shard) shard.reset(new Hierarchy(m_bbox, m_nodePool));
 
-    const char* pos(bin.data());
+    return Shard(shard.release(), [this](Hierarchy* h)
+    {
+        std::unique_ptr<Hierarchy> owned(h);
 
-    Node::NodeMap newEdges;
+        std::lock_guard<std::mutex> lock(m_shardMutex);
+        m_shards.push_back(std::move(owned));
+        --m_outstanding;
+    });
+}
 
-    while (it != m_edges.end() && (edgeEnd.zero() || it->first < edgeEnd))
+void Hierarchy::mergeShards()
+{
+    std::lock_guard<std::mutex> lock(m_shardMutex);
+
+    if (m_outstanding)
     {
-        it->second->assign(m_nodePool, pos, m_step, newEdges, it->first);
-        it = m_edges.erase(it);
+        throw std::runtime_error("Cannot merge hierarchy shards while in use");
     }
 
-    m_edges.insert(newEdges.begin(), newEdges.end());
+    for (auto& shard : m_shards) m_root.merge(shard->root());
+    m_shards.clear();
 }
 
-Json::Value Hierarchy::toJson(const arbiter::Endpoint& ep, std::string postfix)
+Json::Value Hierarchy::toJson(
+        const arbiter::Endpoint& ep,
+        std::string postfix,
+        const std::size_t threads)
 {
+    mergeShards();
+
     // Postfixing is only applied to the anchors file and the base anchor.
-    const Node::NodeSet newAnchors(m_root.insertInto(ep, postfix, m_step));
+    const Node::NodeSet newAnchors(
+            m_root.insertInto(ep, postfix, m_step, threads));
     m_anchors.insert(newAnchors.begin(), newAnchors.end());
 
     Json::Value json;
@@ -375,6 +602,8 @@ Json::Value Hierarchy::toJson(const arbiter::Endpoint& ep, std::string postfix)
 
     ep.putSubpath("anchors" + postfix, jsonAnchors.toStyledString());
 
+    json["flat"] = FlatHierarchy::write(m_root, ep, postfix, threads);
+
     return json;
 }
 
@@ -382,6 +611,33 @@ Json::Value Hierarchy::query(
         BBox qbox,
         const std::size_t qDepthBegin,
         const std::size_t qDepthEnd)
+{
+    Node node;
+    query(node, qbox, qDepthBegin, qDepthEnd);
+
+    Json::Value json;
+    node.insertInto(json);
+    return json;
+}
+
+std::vector<char> Hierarchy::queryBinary(
+        BBox qbox,
+        const std::size_t qDepthBegin,
+        const std::size_t qDepthEnd)
+{
+    Node node;
+    query(node, qbox, qDepthBegin, qDepthEnd);
+
+    std::vector<char> data;
+    node.insertInto(data);
+    return data;
+}
+
+void Hierarchy::query(
+        Node& out,
+        BBox qbox,
+        const std::size_t qDepthBegin,
+        const std::size_t qDepthEnd)
 {
     if (qDepthBegin < m_depthBegin)
     {
@@ -393,24 +649,25 @@ Json::Value Hierarchy::query(
     // bit and only include nodes that are entirely encapsulated by the qbox.
     qbox.growBy(.01);
 
-    Node node;
-    std::deque<Dir> lag;
-
+    if (m_flat)
     {
-        traverse(
-                node,
-                lag,
-                m_root,
-                m_bbox,
-                qbox,
-                m_depthBegin,
-                qDepthBegin,
-                qDepthEnd);
+        m_flat->query(out, qbox, qDepthBegin, qDepthEnd);
+        return;
     }
 
-    Json::Value json;
-    node.insertInto(json);
-    return json;
+    // The lag is shared by the entire traversal.  Each call leaves it as it
+    // was found, so no per-child copies are needed.
+    std::deque<Dir> lag;
+
+    traverse(
+            out,
+            lag,
+            m_root,
+            m_bbox,
+            qbox,
+            m_depthBegin,
+            qDepthBegin,
+            qDepthEnd);
 }
 
 void Hierarchy::traverse(
@@ -444,11 +701,10 @@ void Hierarchy::traverse(
                         awaken(childId, node);
                     }
 
-                    auto curlag(lag);
-                    curlag.push_back(dir);
+                    lag.push_back(dir);
                     traverse(
                         out,
-                        curlag,
+                        lag,
                         *node,
                         cbox.get(dir),
                         qbox,
@@ -456,6 +712,7 @@ void Hierarchy::traverse(
                         db,
                         de,
                         childId);
+                    lag.pop_back();
                 }
             });
 
@@ -556,16 +813,17 @@ void Hierarchy::accumulate(
                     }
 
                     if (!nextNode) nextNode = &out.next(lagdir, m_nodePool);
-                    auto curlag(lag);
-                    curlag.push_back(curdir);
+                    lag.push_back(curdir);
 
                     accumulate(
                         *nextNode,
-                        curlag,
+                        lag,
                         *node,
                         nextDepth,
                         depthEnd,
                         childId);
+
+                    lag.pop_back();
                 }
             });
 
@@ -574,8 +832,344 @@ void Hierarchy::accumulate(
                 addChild(out, static_cast<Dir>(i));
             }
 
-            lag.pop_back();
+            lag.push_front(lagdir);
+        }
+    }
+}
+
+FlatHierarchy::Record::Record(const char* pos)
+    : count(0)
+    , mask(0)
+    , first(0)
+{
+    uint64_t link(0);
+
+    std::copy(pos, pos + sizeof(uint64_t), reinterpret_cast<char*>(&count));
+    pos += sizeof(uint64_t);
+    std::copy(pos, pos + sizeof(uint64_t), reinterpret_cast<char*>(&link));
+
+    mask = link & 0xFF;
+    first = link >> 8;
+}
+
+FlatHierarchy::FlatHierarchy(
+        const BBox& bbox,
+        Node::NodePool& nodePool,
+        const std::size_t depthBegin,
+        const Json::Value& json,
+        const arbiter::Endpoint& ep,
+        const std::string postfix)
+    : m_bbox(bbox)
+    , m_nodePool(nodePool)
+    , m_depthBegin(depthBegin)
+    , m_records(json["records"].asUInt64())
+    , m_fileRecords(json["fileRecords"].asUInt64())
+    , m_endpoint(new arbiter::Endpoint(ep))
+    , m_postfix(postfix)
+    , m_mapped()
+    , m_pageList()
+    , m_pages()
+    , m_mutex()
+{
+    if (!m_records || !m_fileRecords)
+    {
+        throw std::runtime_error(
+                "Invalid flat hierarchy: " + json.toStyledString());
+    }
+
+    const std::size_t files((m_records + m_fileRecords - 1) / m_fileRecords);
+
+    for (std::size_t i(0); i < files; ++i)
+    {
+        std::unique_ptr<MappedFile> mapped(
+                MappedFile::map(*m_endpoint, flatPath(i, m_postfix)));
+
+        if (!mapped)
+        {
+            m_mapped.clear();
+            break;
+        }
+
+        m_mapped.push_back(std::move(mapped));
+    }
+}
+
+FlatHierarchy::~FlatHierarchy()
+{ }
+
+Json::Value FlatHierarchy::write(
+        const Node& root,
+        const arbiter::Endpoint& ep,
+        const std::string postfix,
+        const std::size_t threads)
+{
+    BlockWriter blocks(ep, threads);
+
+    std::vector<char> data;
+    std::size_t file(0);
+    uint64_t records(0);
+
+    auto append([&](uint64_t v)
+    {
+        const char* pos(reinterpret_cast<const char*>(&v));
+        data.insert(data.end(), pos, pos + sizeof(uint64_t));
+    });
+
+    auto flush([&]()
+    {
+        blocks.write(flatPath(file++, postfix), data);
+        data.clear();
+    });
+
+    // Children are numbered in the order that they are queued, which is the
+    // order in which their records will be written.
+    std::vector<const Node*> level(1, &root);
+    std::vector<const Node*> nextLevel;
+    uint64_t next(1);
+
+    while (!level.empty())
+    {
+        for (const Node* node : level)
+        {
+            const uint8_t mask(node->count() ? node->mask() : 0);
+
+            append(node->count());
+            append(((mask ? next : 0) << 8) | mask);
+
+            if (++records % fileRecords == 0) flush();
+
+            if (mask)
+            {
+                node->eachChild([&](Dir, const Node& child)
+                {
+                    nextLevel.push_back(&child);
+                    ++next;
+                });
+            }
+        }
+
+        level.swap(nextLevel);
+        nextLevel.clear();
+    }
+
+    if (!data.empty()) flush();
+
+    blocks.join();
+
+    Json::Value json;
+    json["records"] = static_cast<Json::UInt64>(records);
+    json["fileRecords"] = static_cast<Json::UInt64>(fileRecords);
+    return json;
+}
+
+FlatHierarchy::Record FlatHierarchy::get(const uint64_t index) const
+{
+    if (index >= m_records)
+    {
+        throw std::runtime_error("Invalid flat hierarchy index");
+    }
+
+    const std::size_t file(index / m_fileRecords);
+    const std::size_t offset((index % m_fileRecords) * recordBytes);
+
+    if (!m_mapped.empty())
+    {
+        const MappedFile& mapped(*m_mapped[file]);
+
+        if (offset + recordBytes > mapped.size())
+        {
+            throw std::runtime_error("Invalid flat hierarchy index");
+        }
+
+        return Record(mapped.data() + offset);
+    }
+
+    const std::size_t pageBytes(pageRecords * recordBytes);
+    const std::size_t filePages(
+            (m_fileRecords + pageRecords - 1) / pageRecords);
+    const std::size_t p(offset / pageBytes);
+    const std::size_t key(file * filePages + p);
+
+    std::shared_ptr<std::vector<char>> page;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it(m_pages.find(key));
+        if (it != m_pages.end())
+        {
+            m_pageList.splice(m_pageList.begin(), m_pageList, it->second.it);
+            page = it->second.data;
+        }
+    }
+
+    if (!page)
+    {
+        // Fetch without holding the lock.  Concurrent queries may both fetch
+        // the same page, in which case the first one stored is kept.
+        paged.add();
+
+        page = std::make_shared<std::vector<char>>(
+                std::move(
+                    *Storage::getRange(
+                        *m_endpoint,
+                        flatPath(file, m_postfix),
+                        p * pageBytes,
+                        (p + 1) * pageBytes).get()));
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it(m_pages.find(key));
+        if (it != m_pages.end())
+        {
+            m_pageList.splice(m_pageList.begin(), m_pageList, it->second.it);
+            page = it->second.data;
+        }
+        else
+        {
+            m_pageList.push_front(key);
+            m_pages[key] = Page { page, m_pageList.begin() };
+
+            // Evicted pages stay alive for any query still reading them.
+            while (m_pages.size() > maxPages)
+            {
+                m_pages.erase(m_pageList.back());
+                m_pageList.pop_back();
+            }
+        }
+    }
+
+    const std::size_t pos(offset % pageBytes);
+
+    if (pos + recordBytes > page->size())
+    {
+        throw std::runtime_error("Invalid flat hierarchy index");
+    }
+
+    return Record(page->data() + pos);
+}
+
+void FlatHierarchy::query(
+        Node& out,
+        const BBox& qbox,
+        const std::size_t qDepthBegin,
+        const std::size_t qDepthEnd) const
+{
+    std::deque<Dir> lag;
+
+    traverse(
+            out,
+            lag,
+            get(0),
+            m_bbox,
+            qbox,
+            m_depthBegin,
+            qDepthBegin,
+            qDepthEnd);
+}
+
+void FlatHierarchy::traverse(
+        Node& out,
+        std::deque<Dir>& lag,
+        const Record& cur,
+        const BBox& cbox,
+        const BBox& qbox,
+        const std::size_t depth,
+        const std::size_t db,
+        const std::size_t de) const
+{
+    if (depth < db)
+    {
+        const std::size_t next(depth + 1);
+
+        if (qbox.contains(cbox))
+        {
+            for (std::size_t i(0); i < 8; ++i)
+            {
+                const Dir dir(toDir(i));
+
+                if (const uint64_t child = cur.child(dir))
+                {
+                    lag.push_back(dir);
+                    traverse(
+                        out,
+                        lag,
+                        get(child),
+                        cbox.get(dir),
+                        qbox,
+                        next,
+                        db,
+                        de);
+                    lag.pop_back();
+                }
+            }
         }
+        else
+        {
+            const Dir dir(getDirection(qbox.mid(), cbox.mid()));
+
+            if (const uint64_t child = cur.child(dir))
+            {
+                const BBox nbox(cbox.get(dir));
+                traverse(out, lag, get(child), nbox, qbox, next, db, de);
+            }
+        }
+    }
+    else if (qbox.contains(cbox) && depth < de)
+    {
+        accumulate(out, lag, cur, depth, de);
+    }
+}
+
+void FlatHierarchy::accumulate(
+        Node& out,
+        std::deque<Dir>& lag,
+        const Record& cur,
+        const std::size_t depth,
+        const std::size_t depthEnd) const
+{
+    out.incrementBy(cur.count);
+
+    const std::size_t nextDepth(depth + 1);
+    if (nextDepth >= depthEnd || !cur.mask) return;
+
+    if (lag.empty())
+    {
+        for (std::size_t i(0); i < 8; ++i)
+        {
+            const Dir dir(toDir(i));
+
+            if (const uint64_t child = cur.child(dir))
+            {
+                accumulate(
+                        out.next(dir, m_nodePool),
+                        lag,
+                        get(child),
+                        nextDepth,
+                        depthEnd);
+            }
+        }
+    }
+    else
+    {
+        // As in Hierarchy::accumulate, every child aggregates into the
+        // output node in the direction at the front of the lag.
+        const Dir lagdir(lag.front());
+        lag.pop_front();
+
+        Node& next(out.next(lagdir, m_nodePool));
+
+        for (std::size_t i(0); i < 8; ++i)
+        {
+            const Dir curdir(toDir(i));
+
+            if (const uint64_t child = cur.child(curdir))
+            {
+                lag.push_back(curdir);
+                accumulate(next, lag, get(child), nextDepth, depthEnd);
+                lag.pop_back();
+            }
+        }
+
+        lag.push_front(lagdir);
     }
 }
 
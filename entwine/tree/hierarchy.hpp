@@ -10,9 +10,15 @@
 
 #pragma once
 
+#include <bitset>
+#include <condition_variable>
 #include <cstddef>
+#include <cstdint>
 #include <deque>
+#include <functional>
+#include <list>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <set>
 #include <string>
@@ -25,6 +31,8 @@
 namespace entwine
 {
 
+class MappedFile;
+
 class Node
 {
 public:
@@ -33,7 +41,11 @@ public:
 
     typedef std::map<Id, Node*> NodeMap;
     typedef std::set<Id> NodeSet;
-    typedef std::map<Dir, PooledNode> Children;
+
+    // Children are stored densely, in Dir order, for only the directions set
+    // in the child mask.  The index of a given child within this array is the
+    // number of mask bits below its direction.
+    typedef std::vector<PooledNode> Children;
 
     struct AnchoredNode
     {
@@ -46,7 +58,7 @@ public:
 
     typedef std::map<Id, AnchoredNode> AnchoredMap;
 
-    Node() : m_count(0), m_children() { }
+    Node() : m_count(0), m_mask(0), m_children() { }
 
     Node(
             NodePool& nodePool,
@@ -66,22 +78,23 @@ public:
 
     Node& next(Dir dir, NodePool& nodePool)
     {
-        if (Node* node = maybeNext(dir)) return *node;
-        else
-        {
-            auto result(
-                    m_children.emplace(
-                        std::make_pair(dir, nodePool.acquireOne())));
+        const uint8_t bit(1 << toIntegral(dir));
+        const std::size_t i(index(bit));
 
-            return result.first->second->val();
+        if (!(m_mask & bit))
+        {
+            m_mask |= bit;
+            m_children.insert(m_children.begin() + i, nodePool.acquireOne());
         }
+
+        return m_children[i]->val();
     }
 
     Node* maybeNext(Dir dir)
     {
-        auto it(m_children.find(dir));
+        const uint8_t bit(1 << toIntegral(dir));
 
-        if (it != m_children.end()) return &it->second->val();
+        if (m_mask & bit) return &m_children[index(bit)]->val();
         else return nullptr;
     }
 
@@ -93,20 +106,39 @@ public:
     void merge(Node& other);
     void insertInto(Json::Value& json) const;
 
+    // Append this tree in the same pre-order count/mask encoding used for
+    // persisted hierarchy blocks.
+    void insertInto(std::vector<char>& data) const;
+
+    // Serialize this tree in anchored blocks, uploading blocks concurrently
+    // with at most _threads_ writes in flight.
     NodeSet insertInto(
             const arbiter::Endpoint& ep,
             std::string postfix,
-            std::size_t step);
+            std::size_t step,
+            std::size_t threads);
 
+    uint8_t mask() const { return m_mask; }
     const Children& children() const { return m_children; }
 
+    // Call _f_ with the direction and node of each child, in Dir order.
+    template<typename F> void eachChild(const F& f) const;
+    template<typename F> void eachChild(const F& f);
+
 private:
     Children& children() { return m_children; }
 
+    std::size_t index(uint8_t bit) const
+    {
+        return std::bitset<8>(m_mask & (bit - 1)).count();
+    }
+
+    typedef std::function<void(std::string, std::vector<char>&)> Writer;
+
     AnchoredMap insertSlice(
             NodeSet& anchors,
             const AnchoredMap& slice,
-            const arbiter::Endpoint& ep,
+            const Writer& writer,
             std::string postfix,
             std::size_t step);
 
@@ -120,35 +152,174 @@ private:
     bool insertBinary(std::vector<char>& s) const;
 
     uint64_t m_count;
+    uint8_t m_mask;
     Children m_children;
 };
 
+template<typename F> void Node::eachChild(const F& f) const
+{
+    std::size_t i(0);
+
+    for (std::size_t d(0); d < 8; ++d)
+    {
+        if (m_mask & (1 << d)) f(toDir(d), m_children[i++]->val());
+    }
+}
+
+template<typename F> void Node::eachChild(const F& f)
+{
+    std::size_t i(0);
+
+    for (std::size_t d(0); d < 8; ++d)
+    {
+        if (m_mask & (1 << d)) f(toDir(d), m_children[i++]->val());
+    }
+}
+
 inline bool operator==(const Node& lhs, const Node& rhs)
 {
-    if (lhs.count() == rhs.count())
+    if (lhs.count() == rhs.count() && lhs.mask() == rhs.mask())
     {
         const auto& lhsChildren(lhs.children());
         const auto& rhsChildren(rhs.children());
 
-        if (lhsChildren.size() == rhsChildren.size())
+        for (std::size_t i(0); i < lhsChildren.size(); ++i)
         {
-            for (const auto& c : lhsChildren)
+            if (!(lhsChildren[i]->val() == rhsChildren[i]->val()))
             {
-                if (
-                        !rhsChildren.count(c.first) ||
-                        !(c.second->val() == rhsChildren.at(c.first)->val()))
-                {
-                    return false;
-                }
+                return false;
             }
-
-            return true;
         }
+
+        return true;
     }
 
     return false;
 }
 
+// A read-only view of a persisted hierarchy stored as one flat array of
+// fixed-size node records, in Id order.  Ids are numbered level by level, so
+// this is breadth-first order and the children of each node are contiguous:
+// a child is located from its parent in constant time, without decoding any
+// blocks or rebuilding a tree.  Local files are memory-mapped, and remote
+// ones are range-read a page at a time into a bounded cache.
+//
+// The array is split across files of a fixed number of records, so that no
+// single upload grows with the size of the tree and the files may be written
+// concurrently through the same bounded pool as the anchored blocks.
+//
+// Each record is a little-endian uint64 point count, followed by a uint64
+// whose low byte is the child mask and whose upper bits hold the index of the
+// first child.  As with the anchored blocks, nodes with a count of zero have
+// no children.
+class FlatHierarchy
+{
+public:
+    FlatHierarchy(
+            const BBox& bbox,
+            Node::NodePool& nodePool,
+            std::size_t depthBegin,
+            const Json::Value& json,
+            const arbiter::Endpoint& ep,
+            std::string postfix = "");
+
+    ~FlatHierarchy();
+
+    // Write the records beneath _root_, uploading up to _threads_ files at
+    // once, and return the layout with which they are later read.
+    static Json::Value write(
+            const Node& root,
+            const arbiter::Endpoint& ep,
+            std::string postfix,
+            std::size_t threads);
+
+    // Aggregate the query results into _out_ in the same way as
+    // Hierarchy::query.  The _qbox_ must already have been grown to absorb
+    // floating point error.
+    void query(
+            Node& out,
+            const BBox& qbox,
+            std::size_t depthBegin,
+            std::size_t depthEnd) const;
+
+private:
+    struct Record
+    {
+        Record(const char* pos);
+
+        // Returns the index of the child in _dir_, or zero if there is none,
+        // since the root is never a child.
+        uint64_t child(Dir dir) const
+        {
+            const uint8_t bit(1 << toIntegral(dir));
+            if (!(mask & bit)) return 0;
+            return first + std::bitset<8>(mask & (bit - 1)).count();
+        }
+
+        uint64_t count;
+        uint8_t mask;
+        uint64_t first;
+    };
+
+    Record get(uint64_t index) const;
+
+    void traverse(
+            Node& out,
+            std::deque<Dir>& lag,
+            const Record& cur,
+            const BBox& cbox,
+            const BBox& qbox,
+            std::size_t depth,
+            std::size_t depthBegin,
+            std::size_t depthEnd) const;
+
+    void accumulate(
+            Node& out,
+            std::deque<Dir>& lag,
+            const Record& cur,
+            std::size_t depth,
+            std::size_t depthEnd) const;
+
+    const BBox& m_bbox;
+    Node::NodePool& m_nodePool;
+    const std::size_t m_depthBegin;
+
+    const uint64_t m_records;
+    const uint64_t m_fileRecords;
+
+    std::unique_ptr<arbiter::Endpoint> m_endpoint;
+    const std::string m_postfix;
+
+    // Local files are all mapped up front.  If any of them cannot be, then
+    // none are used and records are paged instead.
+    std::vector<std::unique_ptr<MappedFile>> m_mapped;
+
+    typedef std::list<std::size_t> PageList;
+
+    struct Page
+    {
+        std::shared_ptr<std::vector<char>> data;
+        PageList::iterator it;
+    };
+
+    // Pages of remote files, fetched on demand.  Keys number the pages of all
+    // files consecutively.  The list orders them from most to least recently
+    // used, and the least recently used are evicted beyond a fixed limit.
+    mutable PageList m_pageList;
+    mutable std::map<std::size_t, Page> m_pages;
+    mutable std::mutex m_mutex;
+
+    FlatHierarchy(const FlatHierarchy&);
+    FlatHierarchy& operator=(const FlatHierarchy&);
+};
+
+class Hierarchy;
+
+// A shard is a private Hierarchy that a single worker counts into without
+// synchronization.  On destruction it is returned to its parent for reuse
+// rather than merged, so shards accumulate counts across many inputs.
+typedef std::unique_ptr<Hierarchy, std::function<void(Hierarchy*)>> Shard;
+
 class Hierarchy
 {
 public:
@@ -160,9 +331,16 @@ public:
         , m_root()
         , m_edges()
         , m_anchors()
+        , m_awoken()
+        , m_loading()
         , m_mutex()
+        , m_cv()
         , m_endpoint()
         , m_postfix()
+        , m_flat()
+        , m_shards()
+        , m_outstanding(0)
+        , m_shardMutex()
     { }
 
     Hierarchy(
@@ -174,25 +352,48 @@ public:
 
     Node& root() { return m_root; }
 
-    Json::Value toJson(const arbiter::Endpoint& ep, std::string postfix);
+    Json::Value toJson(
+            const arbiter::Endpoint& ep,
+            std::string postfix,
+            std::size_t threads);
 
     Json::Value query(
             BBox qbox,
             std::size_t depthBegin,
             std::size_t depthEnd);
 
+    // Equivalent to query, but the result is encoded as a pre-order array of
+    // nodes, each as a little-endian uint64 count followed by a uint8 mask of
+    // which of its children follow.  Children of nodes with a count of zero
+    // are omitted.
+    std::vector<char> queryBinary(
+            BBox qbox,
+            std::size_t depthBegin,
+            std::size_t depthEnd);
+
     void merge(Hierarchy& other)
     {
+        m_flat.reset();
+        other.mergeShards();
         m_root.merge(other.root());
         m_anchors.insert(other.m_anchors.begin(), other.m_anchors.end());
     }
 
+    // Acquire a shard for concurrent insertion.  Shards are folded into this
+    // Hierarchy by mergeShards, which is called automatically by toJson and
+    // merge - all shards must have been released by that point.
+    Shard shard();
+    void mergeShards();
+
     std::size_t depthBegin() const { return m_depthBegin; }
     std::size_t step() const { return m_step; }
     const BBox& bbox() const { return m_bbox; }
 
+    // Load every anchor block, so that the tree may be modified.  The flat
+    // array, if any, no longer applies once it is.
     void awakenAll()
     {
+        m_flat.reset();
         for (const auto& a : m_anchors) awaken(a);
         m_anchors.clear();
     }
@@ -214,6 +415,12 @@ private:
     Hierarchy(const Hierarchy& other) = delete;
     Hierarchy& operator=(const Hierarchy& other) = delete;
 
+    void query(
+            Node& out,
+            BBox qbox,
+            std::size_t depthBegin,
+            std::size_t depthEnd);
+
     void traverse(
             Node& out,
             std::deque<Dir>& lag,
@@ -233,8 +440,13 @@ private:
             std::size_t depthEnd,
             const Id& id);
 
+    // Fetch and decode the anchor block containing _id_, unless _node_ has
+    // already been populated.  Concurrent requests for the same anchor wait
+    // for a single fetch, and different anchors are fetched in parallel.
     void awaken(const Id& id, const Node* node = nullptr);
 
+    Id lowerAnchor(const Id& id) const;
+
     const BBox& m_bbox;
     Node::NodePool& m_nodePool;
 
@@ -245,10 +457,20 @@ private:
     Node::NodeMap m_edges;
     Node::NodeSet m_anchors;
     Node::NodeSet m_awoken;
+    Node::NodeSet m_loading;
 
     mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
     std::unique_ptr<arbiter::Endpoint> m_endpoint;
     std::string m_postfix;
+
+    // Present if this hierarchy was loaded from an index that persisted its
+    // flat array, in which case queries are answered from it.
+    std::unique_ptr<FlatHierarchy> m_flat;
+
+    std::vector<std::unique_ptr<Hierarchy>> m_shards;
+    std::size_t m_outstanding;
+    std::mutex m_shardMutex;
 };
 
 class HierarchyClimber
@@ -10,6 +10,7 @@
 
 #include <entwine/tree/manifest.hpp>
 
+#include <cstring>
 #include <iostream>
 #include <limits>
 
@@ -43,6 +44,37 @@ namespace
     {
         throw std::runtime_error(message);
     }
+
+    const std::string magic("EMNF");
+    const uint32_t binaryVersion(1);
+
+    // Magic, version, file count, file stats, point stats, split.
+    const std::size_t headerSize(
+            magic.size() + sizeof(uint32_t) + sizeof(uint64_t) * 7 +
+            sizeof(uint8_t) + sizeof(uint64_t) * 2);
+
+    // Path offset and size, point count, point stats, bounds, status, flags.
+    const std::size_t recordSize(
+            sizeof(uint64_t) * 6 + sizeof(double) * 6 + sizeof(uint8_t) * 2);
+
+    const uint8_t hasBBoxFlag(1);
+    const uint8_t is3dFlag(2);
+
+    template<typename T>
+    void push(std::vector<char>& data, const T val)
+    {
+        const char* pos(reinterpret_cast<const char*>(&val));
+        data.insert(data.end(), pos, pos + sizeof(T));
+    }
+
+    template<typename T>
+    T extract(const char*& pos)
+    {
+        T val;
+        std::memcpy(&val, pos, sizeof(T));
+        pos += sizeof(T);
+        return val;
+    }
 }
 
 PointStats::PointStats(const Json::Value& json)
@@ -213,6 +245,95 @@ Manifest::Manifest(const Json::Value& json)
     }
 }
 
+Manifest::Manifest(const std::vector<char>& data, const bool statsOnly)
+    : m_paths()
+    , m_fileStats()
+    , m_pointStats()
+    , m_split()
+    , m_mutex()
+{
+    if (!isBinary(data) || data.size() < headerSize)
+    {
+        error("Invalid binary manifest");
+    }
+
+    const char* pos(data.data() + magic.size());
+
+    if (extract<uint32_t>(pos) != binaryVersion)
+    {
+        error("Unsupported binary manifest version");
+    }
+
+    const std::size_t numFiles(extract<uint64_t>(pos));
+
+    {
+        const uint64_t inserts(extract<uint64_t>(pos));
+        const uint64_t omits(extract<uint64_t>(pos));
+        const uint64_t errors(extract<uint64_t>(pos));
+        m_fileStats = FileStats(inserts, omits, errors);
+    }
+
+    {
+        const uint64_t inserts(extract<uint64_t>(pos));
+        const uint64_t outOfBounds(extract<uint64_t>(pos));
+        const uint64_t overflows(extract<uint64_t>(pos));
+        m_pointStats = PointStats(inserts, outOfBounds, overflows);
+    }
+
+    {
+        const bool hasSplit(extract<uint8_t>(pos));
+        const uint64_t begin(extract<uint64_t>(pos));
+        const uint64_t end(extract<uint64_t>(pos));
+        if (hasSplit) m_split.reset(new Split(begin, end));
+    }
+
+    if (statsOnly) return;
+
+    const char* strings(data.data() + headerSize + numFiles * recordSize);
+    if (strings > data.data() + data.size()) error("Truncated manifest");
+
+    const std::size_t stringsSize(data.data() + data.size() - strings);
+
+    m_paths.reserve(numFiles);
+
+    for (std::size_t i(0); i < numFiles; ++i)
+    {
+        const uint64_t pathOffset(extract<uint64_t>(pos));
+        const uint64_t pathSize(extract<uint64_t>(pos));
+        const uint64_t numPoints(extract<uint64_t>(pos));
+
+        const uint64_t inserts(extract<uint64_t>(pos));
+        const uint64_t outOfBounds(extract<uint64_t>(pos));
+        const uint64_t overflows(extract<uint64_t>(pos));
+
+        double b[6];
+        for (std::size_t j(0); j < 6; ++j) b[j] = extract<double>(pos);
+
+        const uint8_t status(extract<uint8_t>(pos));
+        const uint8_t flags(extract<uint8_t>(pos));
+
+        if (pathOffset + pathSize > stringsSize) error("Invalid manifest path");
+
+        FileInfo info(
+                std::string(strings + pathOffset, pathSize),
+                static_cast<FileInfo::Status>(status));
+
+        info.numPoints(numPoints);
+        info.add(PointStats(inserts, outOfBounds, overflows));
+
+        if (flags & hasBBoxFlag)
+        {
+            info.bbox(
+                    BBox(
+                        Point(b[0], b[1], b[2]),
+                        Point(b[3], b[4], b[5]),
+                        flags & is3dFlag));
+        }
+
+        m_paths.push_back(info);
+    }
+}
+
 void Manifest::append(const Manifest& other)
 {
     m_paths.reserve(size() + other.size());
@@ -307,6 +428,83 @@ Json::Value Manifest::toJson() const
     return json;
 }
 
+std::vector<char> Manifest::toBinary() const
+{
+    std::vector<char> data;
+    std::string strings;
+
+    data.reserve(headerSize + size() * recordSize);
+    data.insert(data.end(), magic.begin(), magic.end());
+
+    push<uint32_t>(data, binaryVersion);
+    push<uint64_t>(data, size());
+
+    push<uint64_t>(data, m_fileStats.inserts());
+    push<uint64_t>(data, m_fileStats.omits());
+    push<uint64_t>(data, m_fileStats.errors());
+
+    push<uint64_t>(data, m_pointStats.inserts());
+    push<uint64_t>(data, m_pointStats.outOfBounds());
+    push<uint64_t>(data, m_pointStats.overflows());
+
+    push<uint8_t>(data, m_split ? 1 : 0);
+    push<uint64_t>(data, m_split ? m_split->begin() : 0);
+    push<uint64_t>(data, m_split ? m_split->end() : 0);
+
+    for (const FileInfo& info : m_paths)
+    {
+        push<uint64_t>(data, strings.size());
+        push<uint64_t>(data, info.path().size());
+        push<uint64_t>(data, info.numPoints());
+
+        const PointStats& stats(info.pointStats());
+        push<uint64_t>(data, stats.inserts());
+        push<uint64_t>(data, stats.outOfBounds());
+        push<uint64_t>(data, stats.overflows());
+
+        uint8_t flags(0);
+        Point min(0, 0, 0);
+        Point max(0, 0, 0);
+
+        if (const BBox* bbox = info.bbox())
+        {
+            flags |= hasBBoxFlag;
+            if (bbox->is3d()) flags |= is3dFlag;
+
+            min = bbox->min();
+            max = bbox->max();
+        }
+
+        push<double>(data, min.x);
+        push<double>(data, min.y);
+        push<double>(data, min.z);
+        push<double>(data, max.x);
+        push<double>(data, max.y);
+        push<double>(data, max.z);
+
+        push<uint8_t>(data, static_cast<uint8_t>(info.status()));
+        push<uint8_t>(data, flags);
+
+        strings += info.path();
+    }
+
+    data.insert(data.end(), strings.begin(), strings.end());
+
+    return data;
+}
+
+bool Manifest::isBinary(const std::vector<char>& data)
+{
+    return
+        data.size() >= magic.size() &&
+        std::equal(magic.begin(), magic.end(), data.begin());
+}
+
+std::size_t Manifest::binaryHeaderSize()
+{
+    return headerSize;
+}
+
 Json::Value Manifest::toInferenceJson() const
 {
     Json::Value json;
@@ -18,6 +18,7 @@
 #include <mutex>
 #include <set>
 #include <string>
+#include <vector>
 
 #include <entwine/third/json/json.hpp>
 #include <entwine/types/bbox.hpp>
@@ -34,6 +35,15 @@ public:
     PointStats() : m_inserts(0), m_outOfBounds(0), m_overflows(0) { }
     explicit PointStats(const Json::Value& json);
 
+    PointStats(
+            std::size_t inserts,
+            std::size_t outOfBounds,
+            std::size_t overflows)
+        : m_inserts(inserts)
+        , m_outOfBounds(outOfBounds)
+        , m_overflows(overflows)
+    { }
+
     void add(const PointStats& other)
     {
         m_inserts += other.m_inserts;
@@ -65,6 +75,12 @@ public:
     FileStats() : m_inserts(0), m_omits(0), m_errors(0) { }
     explicit FileStats(const Json::Value& json);
 
+    FileStats(std::size_t inserts, std::size_t omits, std::size_t errors)
+        : m_inserts(inserts)
+        , m_omits(omits)
+        , m_errors(errors)
+    { }
+
     void add(const FileStats& other)
     {
         m_inserts += other.m_inserts;
@@ -76,6 +92,10 @@ public:
     void addOmit()      { ++m_omits; }
     void addError()     { ++m_errors; }
 
+    std::size_t inserts() const { return m_inserts; }
+    std::size_t omits() const   { return m_omits; }
+    std::size_t errors() const  { return m_errors; }
+
     Json::Value toJson() const;
 
 private:
@@ -145,9 +165,26 @@ public:
     Manifest& operator=(const Manifest& other);
     explicit Manifest(const Json::Value& meta);
 
+    // Construct from the binary format of Manifest::toBinary.  If _statsOnly_
+    // is true, then only the aggregate stats and split are read, and the data
+    // may be truncated to Manifest::binaryHeaderSize bytes - in this case
+    // there is no per-file information available.
+    explicit Manifest(const std::vector<char>& data, bool statsOnly = false);
+
     void append(const Manifest& other);
 
     Json::Value toJson() const;
+
+    // Binary format consisting of a fixed-size header containing the
+    // aggregate stats, followed by a fixed-size record per file, followed by a
+    // string table of paths.  The records of existing files may be updated
+    // in place, but since the string table follows the records, adding files
+    // requires rewriting the string table as well as the header.
+    std::vector<char> toBinary() const;
+
+    static bool isBinary(const std::vector<char>& data);
+    static std::size_t binaryHeaderSize();
+
     Json::Value toInferenceJson() const;
     std::size_t size() const { return m_paths.size(); }
     const std::vector<FileInfo>& paths() const { return m_paths; }
@@ -8,9 +8,17 @@
 *
 ******************************************************************************/
 
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
 #include <entwine/tree/builder.hpp>
 #include <entwine/tree/merger.hpp>
 #include <entwine/types/subset.hpp>
+#include <entwine/util/pool.hpp>
 
 namespace entwine
 {
@@ -18,11 +26,13 @@ namespace entwine
 Merger::Merger(
         const std::string path,
         const std::size_t threads,
-        std::shared_ptr<arbiter::Arbiter> arbiter)
+        std::shared_ptr<arbiter::Arbiter> arbiter,
+        const std::size_t workers)
     : m_builder()
     , m_path(path)
     , m_numSubsets(0)
     , m_threads(threads)
+    , m_workers(std::max<std::size_t>(workers, 1))
     , m_outerScope(new OuterScope())
 {
     m_outerScope->setArbiter(arbiter);
@@ -41,33 +51,135 @@ Merger::~Merger() { }
 void Merger::go()
 {
     std::cout << "\t1 / " << m_numSubsets << std::flush;
-    unsplit(*m_builder);
+    unsplit(*m_builder, m_threads);
     std::cout << " done." << std::endl;
 
-    for (std::size_t id(1); id < m_numSubsets; ++id)
+    // Subsets are loaded concurrently, and each worker folds the subsets it
+    // loads into its own partial result, so at most two subsets per worker
+    // are resident at once.
+    const std::size_t workers(
+            std::max<std::size_t>(
+                std::min(m_workers, m_numSubsets - 1),
+                1));
+    const std::size_t threadsPer(std::max<std::size_t>(m_threads / workers, 1));
+
+    std::vector<std::unique_ptr<Builder>> partials(workers);
+    std::atomic_size_t next(1);
+    std::size_t done(1);
+
+    std::vector<std::string> errors;
+    std::mutex mutex;
+
+    auto error([&](const std::string& message)
     {
-        std::cout << "\t" << (id + 1) << " / " << m_numSubsets << std::flush;
+        std::lock_guard<std::mutex> lock(mutex);
+        errors.push_back(message);
+    });
 
-        auto current(Builder::create(m_path, m_threads, id, *m_outerScope));
-        if (!current) throw std::runtime_error("Couldn't create split builder");
+    Pool pool(workers);
 
-        unsplit(*current);
+    for (std::size_t w(0); w < workers; ++w)
+    {
+        pool.add([&, w]()
+        {
+            try
+            {
+                std::unique_ptr<Builder>& partial(partials[w]);
+                std::size_t id(next++);
+
+                while (id < m_numSubsets)
+                {
+                    auto current(load(id, threadsPer));
+
+                    if (!partial) partial = std::move(current);
+                    else partial->merge(*current);
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    std::cout << "\t" << ++done << " / " << m_numSubsets <<
+                        " done." << std::endl;
+
+                    id = next++;
+                }
+            }
+            catch (std::exception& e)
+            {
+                error(e.what());
+            }
+            catch (...)
+            {
+                error("Unknown error during merge");
+            }
+        });
+    }
+
+    pool.join();
 
-        std::cout << " merging..." << std::flush;
-        m_builder->merge(*current);
+    if (!errors.empty()) throw std::runtime_error(errors.front());
 
-        std::cout << " done." << std::endl;
+    // Reduce the partial results pairwise, with each level of the reduction
+    // tree merged in parallel.
+    std::cout << "\tReducing..." << std::flush;
+
+    for (std::size_t stride(1); stride < workers; stride *= 2)
+    {
+        Pool reducer(workers / (stride * 2) + 1);
+
+        for (std::size_t i(0); i + stride < workers; i += stride * 2)
+        {
+            reducer.add([&, i, stride]()
+            {
+                try
+                {
+                    std::unique_ptr<Builder>& ours(partials[i]);
+                    std::unique_ptr<Builder>& theirs(partials[i + stride]);
+
+                    if (!theirs) return;
+
+                    if (!ours) ours = std::move(theirs);
+                    else ours->merge(*theirs);
+
+                    theirs.reset();
+                }
+                catch (std::exception& e)
+                {
+                    error(e.what());
+                }
+                catch (...)
+                {
+                    error("Unknown error during merge");
+                }
+            });
+        }
+
+        reducer.join();
+
+        if (!errors.empty()) throw std::runtime_error(errors.front());
     }
 
+    if (partials.front()) m_builder->merge(*partials.front());
+    partials.clear();
+
+    std::cout << " done." << std::endl;
+
     m_builder->makeWhole();
     m_builder->save();
 }
 
-void Merger::unsplit(Builder& builder)
+std::unique_ptr<Builder> Merger::load(
+        const std::size_t id,
+        const std::size_t threads)
 {
-    if (!builder.manifest().split()) return;
+    auto builder(Builder::create(m_path, threads, id, *m_outerScope));
+    if (!builder) throw std::runtime_error("Couldn't create split builder");
+
+    unsplit(*builder, threads);
 
-    std::cout << " unsplitting..." << std::flush;
+    return builder;
+}
+
+void Merger::unsplit(Builder& builder, const std::size_t threads)
+{
+    if (!builder.manifest().split()) return;
 
     std::unique_ptr<std::size_t> subsetId(
             builder.subset() ?
@@ -80,7 +192,7 @@ void Merger::unsplit(Builder& builder)
         std::unique_ptr<Builder> nextSplit(
                 new Builder(
                     builder.outEndpoint().root(),
-                    m_threads,
+                    threads,
                     subsetId.get(),
                     &pos));
 
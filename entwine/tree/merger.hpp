@@ -24,21 +24,32 @@ class OuterScope;
 class Merger
 {
 public:
+    // Each of the _workers_ concurrent subset loads keeps up to two
+    // Builders resident - its partial result and the subset being loaded -
+    // each holding a full base chunk, so peak memory grows with _workers_.
+    // The _threads_ are divided among them.
     Merger(
             std::string path,
             std::size_t threads,
-            std::shared_ptr<arbiter::Arbiter> arbiter = nullptr);
+            std::shared_ptr<arbiter::Arbiter> arbiter = nullptr,
+            std::size_t workers = 2);
     ~Merger();
 
+    // Load and unsplit the remaining subsets concurrently, merge them with a
+    // parallel pairwise reduction, and save the whole index.  Cold chunks are
+    // already written to their final locations by each subset, so only their
+    // IDs are merged - chunk data is never re-read.
     void go();
 
 private:
-    void unsplit(Builder& builder);
+    std::unique_ptr<Builder> load(std::size_t id, std::size_t threads);
+    void unsplit(Builder& builder, std::size_t threads);
 
     std::unique_ptr<Builder> m_builder;
     std::string m_path;
     std::size_t m_numSubsets;
     std::size_t m_threads;
+    std::size_t m_workers;
     std::unique_ptr<OuterScope> m_outerScope;
 };
 
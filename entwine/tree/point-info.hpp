@@ -58,12 +58,10 @@ public:
         , m_dataNode(std::move(dataNode))
     { }
 
-    void point(const pdal::PointRef& pointRef)
+    // Set the point from the data at _pointRef_, laid out by _schema_.
+    void point(const Schema& schema, const pdal::PointRef& pointRef)
     {
-        m_point = Point(
-                pointRef.getFieldAs<double>(pdal::Dimension::Id::X),
-                pointRef.getFieldAs<double>(pdal::Dimension::Id::Y),
-                pointRef.getFieldAs<double>(pdal::Dimension::Id::Z));
+        m_point = schema.point(pointRef);
     }
 
     virtual const Point& point() const override { return m_point; }
@@ -24,6 +24,7 @@
 #include <entwine/types/schema.hpp>
 #include <entwine/types/structure.hpp>
 #include <entwine/types/subset.hpp>
+#include <entwine/util/mapped-file.hpp>
 #include <entwine/util/storage.hpp>
 
 namespace entwine
@@ -77,7 +78,7 @@ Registry::Registry(
         arbiter::Endpoint& endpoint,
         const Builder& builder,
         const std::size_t clipPoolSize,
-        const Json::Value& ids)
+        const ChunkIds& ids)
     : m_endpoint(endpoint)
     , m_builder(builder)
     , m_structure(builder.structure())
@@ -92,10 +93,26 @@ Registry::Registry(
                 m_structure.baseIndexBegin().str() +
                 m_builder.postfix());
 
+        std::unique_ptr<MappedFile> mapped(
+                MappedFile::map(m_endpoint, basePath));
+
         std::unique_ptr<std::vector<char>> data(
-                m_endpoint.tryGetSubpathBinary(basePath));
+                mapped ? nullptr : m_endpoint.tryGetSubpathBinary(basePath));
 
-        if (data)
+        if (mapped)
+        {
+            m_base.reset(
+                    static_cast<BaseChunk*>(
+                        Chunk::create(
+                            m_builder,
+                            m_builder.bbox(),
+                            0,
+                            m_structure.baseIndexBegin(),
+                            m_structure.baseIndexSpan(),
+                            mapped->data(),
+                            mapped->size()).release()));
+        }
+        else if (data)
         {
             m_base.reset(
                     static_cast<BaseChunk*>(
@@ -224,8 +241,11 @@ void Registry::clip(
 
 void Registry::save()
 {
-    m_base->save(m_endpoint);
+    std::future<void> saved(m_base->save(m_endpoint));
     m_base.reset();
+
+    if (m_cold) m_cold->await();
+    saved.get();
 }
 
 void Registry::merge(const Registry& other)
@@ -241,16 +261,10 @@ void Registry::merge(const Registry& other)
     }
 }
 
-Json::Value Registry::toJson() const
-{
-    if (m_cold) return m_cold->toJson();
-    else return Json::Value();
-}
-
-std::set<Id> Registry::ids() const
+ChunkIds Registry::ids() const
 {
     if (m_cold) return m_cold->ids();
-    else return std::set<Id>();
+    else return ChunkIds(m_structure);
 }
 
 } // namespace entwine
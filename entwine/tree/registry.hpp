@@ -16,7 +16,7 @@
 #include <set>
 #include <vector>
 
-#include <entwine/third/json/json.hpp>
+#include <entwine/tree/chunk-ids.hpp>
 #include <entwine/tree/point-info.hpp>
 
 namespace arbiter
@@ -49,9 +49,8 @@ public:
             arbiter::Endpoint& endpoint,
             const Builder& builder,
             std::size_t clipPoolSize,
-            const Json::Value& meta);
+            const ChunkIds& ids);
 
-    Json::Value toJson() const;
     void merge(const Registry& other);
 
     ~Registry();
@@ -65,7 +64,7 @@ public:
     void save();
     void clip(const Id& index, std::size_t chunkNum, std::size_t id);
 
-    std::set<Id> ids() const;
+    ChunkIds ids() const;
 
 private:
     Cell* getCell(const Climber& climber, Clipper& clipper);
@@ -10,18 +10,26 @@
 
 #include <entwine/tree/tiler.hpp>
 
+#include <algorithm>
 #include <numeric>
 
 #include <entwine/compression/util.hpp>
 #include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/tree/block-directory.hpp>
 #include <entwine/tree/builder.hpp>
 #include <entwine/tree/chunk.hpp>
 #include <entwine/tree/traverser.hpp>
+#include <entwine/types/vector-point-table.hpp>
 #include <entwine/util/storage.hpp>
 
 namespace entwine
 {
 
+namespace
+{
+    const std::size_t tilesPerThread(4);
+}
+
 void Above::populate(std::unique_ptr<std::vector<char>> data)
 {
     const std::size_t pointSize(m_schema.pointSize());
@@ -35,12 +43,13 @@ void Above::populate(std::unique_ptr<std::vector<char>> data)
 
     char* pos(data->data());
 
-    for (std::size_t i(0); i < numPoints; ++i)
+    for (std::size_t i(0); i < numPoints; ++i, pos += pointSize)
     {
         pointRef.setPointId(i);
 
-        p.x = pointRef.getFieldAs<double>(pdal::Dimension::Id::X);
-        p.y = pointRef.getFieldAs<double>(pdal::Dimension::Id::Y);
+        const Point real(m_schema.point(pointRef));
+        p.x = real.x;
+        p.y = real.y;
 
         // It's likely that the points will arrive in an order such that
         // many points in a row will belong to the same sub-box.
@@ -54,10 +63,10 @@ void Above::populate(std::unique_ptr<std::vector<char>> data)
             }
         }
 
-        auto& segment(m_segments[b]);
-        segment.insert(segment.end(), pos, pos + pointSize);
+        m_segments[b].push_back(pos);
     }
 
+    m_data = std::move(data);
     m_here = true;
 }
 
@@ -75,12 +84,13 @@ void Base::populate(std::unique_ptr<std::vector<char>> data)
 
     char* pos(data->data());
 
-    for (std::size_t i(0); i < numPoints; ++i)
+    for (std::size_t i(0); i < numPoints; ++i, pos += pointSize)
     {
         pointRef.setPointId(i);
 
-        p.x = pointRef.getFieldAs<double>(pdal::Dimension::Id::X);
-        p.y = pointRef.getFieldAs<double>(pdal::Dimension::Id::Y);
+        const Point real(m_schema.point(pointRef));
+        p.x = real.x;
+        p.y = real.y;
 
         // It's likely that the points will arrive in an order such that
         // many points in a row will belong to the same sub-box.
@@ -91,10 +101,10 @@ void Base::populate(std::unique_ptr<std::vector<char>> data)
             b = c.bboxChunk();
         }
 
-        auto& segment(m_segments[b]);
-        segment.insert(segment.end(), pos, pos + pointSize);
+        m_segments[b].push_back(pos);
     }
 
+    m_data = std::move(data);
     m_here = true;
 }
 
@@ -135,7 +145,7 @@ Base::Base(const Tiler& tiler)
                 // TODO We're tossing information by not using the celled
                 // version, so currently this is read-only - no transformations.
                 // celledWantedSchema.get(),
-                tiler.wantedSchema(),
+                &tiler.activeSchema(),
                 numPoints));
 
     populate(std::move(data));
@@ -151,6 +161,8 @@ Tiler::Tiler(
     , m_outEndpoint()
     , m_pool(threads)
     , m_mutex()
+    , m_cv()
+    , m_maxTiles(std::max<std::size_t>(threads, 1) * tilesPerThread)
     , m_baseChunk()
     , m_sliceDepth(0)
     , m_wantedSchema(wantedSchema)
@@ -172,6 +184,8 @@ Tiler::Tiler(
     , m_outEndpoint(new arbiter::Endpoint(outEndpoint))
     , m_pool(threads)
     , m_mutex()
+    , m_cv()
+    , m_maxTiles(std::max<std::size_t>(threads, 1) * tilesPerThread)
     , m_baseChunk()
     , m_sliceDepth(0)
     , m_wantedSchema(nullptr)
@@ -249,6 +263,10 @@ void Tiler::go(const TileFunction& f)
 
     m_pool.join();
 
+    // The final Tile may have received all of its data while it was still
+    // current, in which case nothing has processed it yet.
+    maybeProcess(f);
+
     if (!m_outEndpoint) return;
 
     const auto props(m_builder.propsToSave());
@@ -310,11 +328,23 @@ void Tiler::spawnTile(
         const BBox& bbox,
         const bool exists)
 {
+    {
+        // Release the previous Tile for processing.  Its data may have all
+        // arrived already, in which case no fetch will trigger processing, so
+        // schedule a pass here.
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_current.reset();
+    }
+
+    m_pool.add([this, &f]() { maybeProcess(f); });
+
     Tile& tile(([this, &chunkId, &bbox]()->Tile&
     {
         const Schema& s(activeSchema());
 
-        std::lock_guard<std::mutex> lock(m_mutex);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this]() { return m_tiles.size() < m_maxTiles; });
+
         m_current.reset(new BBox(bbox));
 
         auto result(
@@ -404,6 +434,7 @@ void Tiler::maybeProcess(const TileFunction& f)
     {
         std::lock_guard<std::mutex> lock(m_mutex);
         for (auto& v : queue) m_tiles.erase(v.second);
+        if (queue.size()) m_cv.notify_all();
 
         auto it(m_aboves.begin());
 
@@ -446,13 +477,26 @@ std::unique_ptr<std::vector<char>> Tiler::acquire(const Id& chunkId)
         throw std::runtime_error("Could not acquire " + chunkId.str());
     }
 
-    const std::size_t numPoints(Chunk::popTail(*compressed).numPoints);
-    auto data(
-            Compression::decompress(
-                *compressed,
-                m_builder.schema(),
-                m_wantedSchema,
-                numPoints));
+    std::unique_ptr<std::vector<char>> data(new std::vector<char>());
+
+    BlockDirectory::segments(
+            compressed->data(),
+            compressed->size(),
+            [this, &data](
+                const char* segment,
+                const std::size_t size,
+                const std::size_t numPoints)
+            {
+                auto block(
+                        Compression::decompress(
+                            segment,
+                            size,
+                            m_builder.schema(),
+                            &activeSchema(),
+                            numPoints));
+
+                data->insert(data->end(), block->begin(), block->end());
+            });
 
     return data;
 }
@@ -477,20 +521,28 @@ Above::Set Tile::getContainingFrom(const BBox& bbox, Above::Map& aboves) const
 
 void Tile::process(const TileFunction& f)
 {
+    TiledPointTable table(m_schema);
+
+    for (auto& b : m_belows)
+    {
+        if (b.second) table.append(*b.second);
+    }
+
     for (const Above* a : m_aboves)
     {
-        if (const std::vector<char>* segment = a->data(m_bbox))
+        if (const std::vector<char*>* segment = a->data(m_bbox))
         {
-            m_data.insert(m_data.end(), segment->begin(), segment->end());
+            table.append(*segment);
         }
     }
 
-    if (m_data.size())
+    if (table.size())
     {
-        VectorPointTable table(m_schema, m_data);
         SizedPointView view(table);
         f(view, m_bbox);
     }
+
+    m_belows.clear();
 }
 
 } // namespace entwine
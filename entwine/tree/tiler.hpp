@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <condition_variable>
 #include <cstddef>
 #include <memory>
 #include <vector>
@@ -19,7 +20,7 @@
 #include <entwine/tree/builder.hpp>
 #include <entwine/types/bbox.hpp>
 #include <entwine/types/dir.hpp>
-#include <entwine/types/vector-point-table.hpp>
+#include <entwine/types/tiled-point-table.hpp>
 #include <entwine/util/pool.hpp>
 
 namespace arbiter
@@ -46,6 +47,7 @@ public:
         , m_bbox(bbox)
         , m_schema(schema)
         , m_delta(delta)
+        , m_data()
         , m_segments()
         , m_here(false)
     { }
@@ -65,7 +67,9 @@ public:
 
     virtual void populate(std::unique_ptr<std::vector<char>> data);
 
-    const std::vector<char>* data(const BBox& bbox) const
+    // Points of this chunk that fall within the given tile bounds.  These
+    // point into the chunk data, which is retained by this Above.
+    const std::vector<char*>* data(const BBox& bbox) const
     {
         if (m_segments.count(bbox)) return &m_segments.at(bbox);
         else return nullptr;
@@ -76,7 +80,8 @@ protected:
     const BBox m_bbox;
     const Schema& m_schema;
     const std::size_t m_delta;
-    std::map<BBox, std::vector<char>> m_segments;
+    std::unique_ptr<std::vector<char>> m_data;
+    std::map<BBox, std::vector<char*>> m_segments;
     bool m_here;
 };
 
@@ -112,7 +117,7 @@ private:
 
 class Tile
 {
-    using Belows = std::map<Id, std::unique_ptr<std::size_t>>;
+    using Belows = std::map<Id, std::unique_ptr<std::vector<char>>>;
     using Below = Belows::value_type;
     using Aboves = std::map<Above*, std::unique_ptr<std::size_t>>;
 
@@ -122,7 +127,6 @@ public:
         , m_schema(schema)
         , m_aboves(getContainingFrom(m_bbox, aboves))
         , m_belows()
-        , m_data()
         , m_owned(false)
     { }
 
@@ -146,11 +150,12 @@ public:
         */
     }
 
+    // Chunk data is held as received and referenced in place when the Tile
+    // is processed, rather than being concatenated.
     void await(const Id& id) { m_belows[id] = nullptr; }
     void insert(const Id& id, std::unique_ptr<std::vector<char>> data)
     {
-        m_belows.at(id).reset(new std::size_t(m_data.size()));
-        m_data.insert(m_data.begin(), data->begin(), data->end());
+        m_belows.at(id) = std::move(data);
     }
 
     // Returns true if the caller is cleared for processing this Tile.  If
@@ -190,7 +195,6 @@ private:
     Above::Set m_aboves;
     Belows m_belows;
 
-    std::vector<char> m_data;
     bool m_owned;
 };
 
@@ -212,12 +216,15 @@ public:
     void go(const TileFunction& f);
 
     const Builder& builder() const { return m_builder; }
+    std::size_t maxTiles() const { return m_maxTiles; }
     const Schema* wantedSchema() const { return m_wantedSchema; }
     std::size_t sliceDepth() const { return m_sliceDepth; }
 
+    // Tiles are produced in real coordinates, so a quantized index is read
+    // in its native schema unless another is wanted.
     const Schema& activeSchema() const
     {
-        return m_wantedSchema ? *m_wantedSchema : m_builder.schema();
+        return m_wantedSchema ? *m_wantedSchema : m_builder.schema().native();
     }
 
 private:
@@ -258,6 +265,12 @@ private:
     std::unique_ptr<arbiter::Endpoint> m_outEndpoint;
     mutable Pool m_pool;
     mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+
+    // Maximum number of Tiles, including the one currently being traversed,
+    // that may hold data at once.  Traversal blocks until a Tile completes
+    // when this is reached, which bounds memory usage.
+    const std::size_t m_maxTiles;
 
     std::unique_ptr<Base> m_baseChunk;
     std::size_t m_sliceDepth;
@@ -269,7 +282,6 @@ private:
 
     std::unique_ptr<BBox> m_current;
     std::set<BBox> m_processing;
-
 };
 
 class SizedPointView : public pdal::PointView
@@ -10,12 +10,21 @@
 
 #pragma once
 
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
 #include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <pdal/PointTable.hpp>
 #include <pdal/PointView.hpp>
 
 #include <entwine/tree/builder.hpp>
+#include <entwine/tree/chunk-ids.hpp>
 #include <entwine/tree/registry.hpp>
 #include <entwine/types/structure.hpp>
 #include <entwine/types/bbox.hpp>
@@ -24,28 +33,18 @@
 namespace entwine
 {
 
-class Branch
+// An existing chunk, as enumerated by Traverser::frontier.
+struct FrontierChunk
 {
-public:
-    Branch() : m_children() { }
-
-    template<typename F> void recurse(const std::size_t depth, const F& f) const
-    {
-        if (m_children.size())
-        {
-            for (const auto& c : m_children)
-            {
-                f(c.first, depth);
-                c.second.recurse(depth + 1, f);
-            }
-        }
-    }
-
-    Branch& operator[](const Id& id) { return m_children[id]; }
-    const Branch& operator[](const Id& id) const { return m_children.at(id); }
+    FrontierChunk(const Id& chunkId, std::size_t depth, const BBox& bbox)
+        : chunkId(chunkId)
+        , depth(depth)
+        , bbox(bbox)
+    { }
 
-private:
-    std::map<Id, Branch> m_children;
+    Id chunkId;
+    std::size_t depth;
+    BBox bbox;
 };
 
 class Traverser
@@ -53,7 +52,7 @@ class Traverser
 public:
     // TODO This class really only works for hybrid trees right now.  It should
     // be genericized similar to Climber.
-    Traverser(const Builder& builder, const std::set<Id>* ids = nullptr)
+    Traverser(const Builder& builder, const ChunkIds* ids = nullptr)
         : m_builder(builder)
         , m_structure(m_builder.structure())
         , m_ids(ids ? *ids : m_builder.registry().ids())
@@ -71,45 +70,88 @@ public:
         }
     }
 
-    template<typename F> void tree(const F& f)
+    // Returns every existing cold chunk in breadth-first order.  Within a
+    // depth, chunks are in ascending ID order, so spatially nearby chunks are
+    // adjacent.
+    std::vector<FrontierChunk> frontier() const
     {
-        if (m_structure.hasCold())
+        std::vector<FrontierChunk> result;
+        if (!m_structure.hasCold()) return result;
+
+        const std::size_t cold(m_structure.coldDepthBegin());
+
+        std::vector<FrontierChunk> current;
+        std::vector<FrontierChunk> next;
+
+        auto add([&next, cold](
+                const Id& chunkId,
+                std::size_t depth,
+                const BBox& bbox,
+                bool exists)
         {
-            tree(
-                    f,
-                    m_structure.nominalChunkIndex(),
-                    m_structure.nominalChunkDepth(),
-                    m_builder.bbox());
+            if (exists || depth < cold) next.emplace_back(chunkId, depth, bbox);
+        });
+
+        add(
+                m_structure.nominalChunkIndex(),
+                m_structure.nominalChunkDepth(),
+                m_builder.bbox(),
+                m_ids.has(m_structure.nominalChunkIndex()));
+
+        while (next.size())
+        {
+            current.swap(next);
+            next.clear();
+
+            for (const auto& c : current)
+            {
+                if (c.depth >= cold) result.push_back(c);
+                recurse(add, c.chunkId, c.depth, c.bbox);
+            }
         }
+
+        return result;
     }
 
+    // Call _f_ with each chunk of the frontier, and its data as returned by
+    // _fetch_, from up to _threads_ threads.  Data is fetched concurrently
+    // ahead of the consumers, with at most _prefetch_ chunks fetched but not
+    // yet consumed at any time.  Any errors are rethrown after all chunks
+    // have been visited.
+    template<typename Fetch, typename F>
+    void each(
+            std::size_t threads,
+            std::size_t prefetch,
+            const Fetch& fetch,
+            const F& f) const;
+
 private:
     template<typename F>
     void recurse(
             const F& f,
             const Id& chunkId,
             std::size_t depth,
-            const BBox& bbox)
+            const BBox& bbox) const
     {
         Id nextId(chunkId << m_structure.dimensions());
         nextId.incSimple();
 
         if (++depth <= m_structure.sparseDepthBegin())
         {
-            f(nextId, depth, bbox.getSwd(true), m_ids.count(nextId));
+            f(nextId, depth, bbox.getSwd(true), m_ids.has(nextId));
 
             nextId += m_structure.baseChunkPoints();
-            f(nextId, depth, bbox.getSed(true), m_ids.count(nextId));
+            f(nextId, depth, bbox.getSed(true), m_ids.has(nextId));
 
             nextId += m_structure.baseChunkPoints();
-            f(nextId, depth, bbox.getNwd(true), m_ids.count(nextId));
+            f(nextId, depth, bbox.getNwd(true), m_ids.has(nextId));
 
             nextId += m_structure.baseChunkPoints();
-            f(nextId, depth, bbox.getNed(true), m_ids.count(nextId));
+            f(nextId, depth, bbox.getNed(true), m_ids.has(nextId));
         }
         else
         {
-            f(nextId, depth, bbox, m_ids.count(nextId));
+            f(nextId, depth, bbox, m_ids.has(nextId));
         }
     }
 
@@ -138,59 +180,131 @@ private:
         }
     }
 
-    template<typename F> void tree(
-            const F& f,
-            const Id& chunkId,
-            std::size_t depth,
-            const BBox& bbox)
+    const Builder& m_builder;
+    const Structure& m_structure;
+    const ChunkIds m_ids;
+};
+
+template<typename Fetch, typename F>
+void Traverser::each(
+        std::size_t threads,
+        std::size_t prefetch,
+        const Fetch& fetch,
+        const F& f) const
+{
+    typedef std::pair<const FrontierChunk*, std::vector<char>> Ready;
+
+    const std::vector<FrontierChunk> chunks(frontier());
+
+    threads = std::max<std::size_t>(threads, 1);
+    prefetch = std::max<std::size_t>(prefetch, 1);
+
+    std::deque<Ready> ready;
+    std::size_t outstanding(0);     // Fetching, or fetched and unconsumed.
+    bool fetching(true);
+
+    std::vector<std::string> errors;
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    auto error([&](const Id& chunkId, const std::string& message)
     {
-        if (depth < m_structure.coldDepthBegin())
+        std::lock_guard<std::mutex> lock(mutex);
+        errors.push_back(chunkId.str() + ": " + message);
+    });
+
+    Pool consumers(threads);
+
+    for (std::size_t i(0); i < threads; ++i)
+    {
+        consumers.add([&]()
         {
-            auto next([this, &f](
-                    const Id& chunkId,
-                    std::size_t depth,
-                    const BBox& bbox,
-                    bool exists)
+            std::unique_lock<std::mutex> lock(mutex);
+
+            while (true)
             {
-                if (exists) tree(f, chunkId, depth, bbox);
-            });
+                cv.wait(lock, [&]() { return ready.size() || !fetching; });
+                if (ready.empty()) return;
 
-            recurse(next, chunkId, depth, bbox);
-        }
-        else if (depth == m_structure.coldDepthBegin())
-        {
-            std::unique_ptr<Branch> branch(new Branch());
-            buildBranch(*branch, chunkId, depth, bbox);
-            f(std::move(branch));
-        }
-        else
-        {
-            throw std::runtime_error("Invalid nominal chunk depth");
-        }
+                Ready current(std::move(ready.front()));
+                ready.pop_front();
+
+                lock.unlock();
+
+                try { f(*current.first, current.second); }
+                catch (std::exception& e)
+                {
+                    error(current.first->chunkId, e.what());
+                }
+                catch (...)
+                {
+                    error(current.first->chunkId, "Unknown error");
+                }
+
+                current.second.clear();
+
+                lock.lock();
+                --outstanding;
+                cv.notify_all();
+            }
+        });
     }
 
-    void buildBranch(
-            Branch& branch,
-            const Id& chunkId,
-            std::size_t depth,
-            const BBox& bbox)
+    Pool fetchers(threads);
+
+    for (const FrontierChunk& chunk : chunks)
     {
-        auto next([this, &branch](
-                const Id& chunkId,
-                std::size_t depth,
-                const BBox& bbox,
-                bool exists)
         {
-            if (exists) buildBranch(branch[chunkId], chunkId, depth, bbox);
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return outstanding < prefetch; });
+            ++outstanding;
+        }
+
+        fetchers.add([&]()
+        {
+            try
+            {
+                std::vector<char> data(fetch(chunk.chunkId));
+
+                std::lock_guard<std::mutex> lock(mutex);
+                ready.emplace_back(&chunk, std::move(data));
+            }
+            catch (std::exception& e)
+            {
+                error(chunk.chunkId, e.what());
+
+                std::lock_guard<std::mutex> lock(mutex);
+                --outstanding;
+            }
+            catch (...)
+            {
+                error(chunk.chunkId, "Unknown error");
+
+                std::lock_guard<std::mutex> lock(mutex);
+                --outstanding;
+            }
+
+            cv.notify_all();
         });
+    }
 
-        recurse(next, chunkId, depth, bbox);
+    fetchers.join();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fetching = false;
     }
 
-    const Builder& m_builder;
-    const Structure& m_structure;
-    const std::set<Id> m_ids;
-};
+    cv.notify_all();
+    consumers.join();
+
+    if (errors.size())
+    {
+        throw std::runtime_error(
+                "Traversal failed for " + std::to_string(errors.size()) +
+                " chunks - " + errors.front());
+    }
+}
 
 } // namespace entwine
 
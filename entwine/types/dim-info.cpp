@@ -51,17 +51,28 @@ DimInfo::DimInfo(
     , m_id(id)
     , m_type(type)
     , m_typeString(pdal::Dimension::toName(pdal::Dimension::base(type)))
+    , m_scale(1.0)
+    , m_offset(0.0)
 { }
 
 DimInfo::DimInfo(
         const std::string& name,
         const std::string& baseTypeName,
-        const std::size_t size)
+        const std::size_t size,
+        const double scale,
+        const double offset)
     : m_name(name)
     , m_id(pdal::Dimension::Id::Unknown)
     , m_type(getType(baseTypeName, size))
     , m_typeString(baseTypeName)
-{ }
+    , m_scale(scale)
+    , m_offset(offset)
+{
+    if (m_scale <= 0)
+    {
+        throw std::runtime_error("Invalid scale for dimension " + m_name);
+    }
+}
 
 std::string DimInfo::name() const
 {
@@ -28,12 +28,19 @@ public:
     DimInfo(
             const std::string& name,
             const std::string& baseTypeName,
-            std::size_t size);
+            std::size_t size,
+            double scale = 1.0,
+            double offset = 0.0);
 
     std::string name() const;
     std::size_t size() const;
     std::string typeString() const;
 
+    // A stored value _v_ represents the value _v_ * scale + offset.
+    double scale() const { return m_scale; }
+    double offset() const { return m_offset; }
+    bool isScaled() const { return m_scale != 1.0 || m_offset != 0.0; }
+
     pdal::Dimension::Id::Enum id() const;
     pdal::Dimension::Type::Enum type() const;
 
@@ -45,13 +52,19 @@ private:
     pdal::Dimension::Id::Enum m_id;
     pdal::Dimension::Type::Enum m_type;
     std::string m_typeString;
+    double m_scale;
+    double m_offset;
 };
 
 using DimList = std::vector<DimInfo>;
 
 inline bool operator==(const DimInfo& lhs, const DimInfo& rhs)
 {
-    return lhs.name() == rhs.name() && lhs.type() == rhs.type();
+    return
+        lhs.name() == rhs.name() &&
+        lhs.type() == rhs.type() &&
+        lhs.scale() == rhs.scale() &&
+        lhs.offset() == rhs.offset();
 }
 
 inline bool operator!=(const DimInfo& lhs, const DimInfo& rhs)
@@ -10,6 +10,8 @@
 
 #include <entwine/types/pooled-point-table.hpp>
 
+#include <entwine/util/transformation.hpp>
+
 namespace entwine
 {
 
@@ -23,14 +25,22 @@ PooledPointTable::PooledPointTable(
         std::function<PooledInfoStack(PooledInfoStack)> process,
         pdal::Dimension::Id::Enum originId,
         Origin origin)
-    : pdal::StreamPointTable(pointPool.schema().pdalLayout())
+    : pdal::StreamPointTable(pointPool.schema().native().pdalLayout())
     , m_pointPool(pointPool)
+    , m_schema(pointPool.schema())
+    , m_nativePointSize(m_schema.native().pointSize())
+    , m_staging(m_schema.quantized() ? blockSize * m_nativePointSize : 0)
+    , m_quantizedTable(m_schema)
     , m_stack(pointPool.infoPool())
     , m_nodes(blockSize, nullptr)
     , m_size(0)
     , m_process(process)
     , m_originId(originId)
     , m_origin(origin)
+    , m_transformation(nullptr)
+    , m_x()
+    , m_y()
+    , m_z()
 {
     allocate();
 }
@@ -48,11 +58,24 @@ void PooledPointTable::reset()
     // which will hammer over our m_size as we're traversing - so store a copy.
     const std::size_t fixedSize(m_size);
 
-    for (std::size_t i(0); i < fixedSize; ++i)
+    if (m_transformation) transform(fixedSize);
+
+    if (m_schema.quantized())
     {
-        pointRef.setPointId(i);
-        m_nodes[i]->val().point(pointRef);
-        if (m_origin != invalidOrigin) pointRef.setField(m_originId, m_origin);
+        quantize(fixedSize);
+    }
+    else
+    {
+        for (std::size_t i(0); i < fixedSize; ++i)
+        {
+            pointRef.setPointId(i);
+            m_nodes[i]->val().point(m_schema, pointRef);
+
+            if (m_origin != invalidOrigin)
+            {
+                pointRef.setField(m_originId, m_origin);
+            }
+        }
     }
 
     m_stack.push(m_process(m_stack.pop(fixedSize)));
@@ -61,6 +84,73 @@ void PooledPointTable::reset()
     allocate();
 }
 
+void PooledPointTable::transform(const std::size_t size)
+{
+    namespace DimId = pdal::Dimension::Id;
+
+    pdal::PointRef pointRef(*this, 0);
+
+    m_x.resize(size);
+    m_y.resize(size);
+    m_z.resize(size);
+
+    for (std::size_t i(0); i < size; ++i)
+    {
+        pointRef.setPointId(i);
+        m_x[i] = pointRef.getFieldAs<double>(DimId::X);
+        m_y[i] = pointRef.getFieldAs<double>(DimId::Y);
+        m_z[i] = pointRef.getFieldAs<double>(DimId::Z);
+    }
+
+    m_transformation->transform(m_x, m_y, m_z);
+
+    for (std::size_t i(0); i < size; ++i)
+    {
+        pointRef.setPointId(i);
+        pointRef.setField(DimId::X, m_x[i]);
+        pointRef.setField(DimId::Y, m_y[i]);
+        pointRef.setField(DimId::Z, m_z[i]);
+    }
+}
+
+void PooledPointTable::quantize(const std::size_t size)
+{
+    const Schema& native(m_schema.native());
+
+    pdal::PointRef nativeRef(*this, 0);
+    pdal::PointRef quantizedRef(m_quantizedTable, 0);
+
+    for (std::size_t i(0); i < size; ++i)
+    {
+        nativeRef.setPointId(i);
+
+        PointInfoShallow& info(m_nodes[i]->val());
+        char* pos(info.data());
+        m_quantizedTable.setPoint(pos);
+
+        for (const auto& dim : m_schema.dims())
+        {
+            if (!Schema::isXyz(dim.id()))
+            {
+                nativeRef.getField(pos, dim.id(), dim.type());
+            }
+
+            pos += dim.size();
+        }
+
+        m_schema.setPoint(quantizedRef, native.point(nativeRef));
+
+        // Read the point back from its quantized form, so the tree sees
+        // exactly the positions that will be stored.
+        info.point(m_schema, quantizedRef);
+
+        if (m_origin != invalidOrigin)
+        {
+            quantizedRef.setField(m_originId, m_origin);
+        }
+    }
+}
+
 void PooledPointTable::allocate()
 {
     const std::size_t needs(blockSize - m_stack.size());
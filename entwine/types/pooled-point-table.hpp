@@ -21,6 +21,8 @@
 namespace entwine
 {
 
+class Transformation;
+
 class BinaryPointTable : public pdal::StreamPointTable
 {
 public:
@@ -52,6 +54,9 @@ class PooledPointTable : public pdal::StreamPointTable
 public:
     // The processing function may acquire nodes from the incoming stack, and
     // can return any that do not need to be kept for reuse.
+    //
+    // If the pool's schema is quantized, points are read in its native
+    // schema and quantized as they are moved into the pooled nodes.
     PooledPointTable(
             PointPool& pointPool,
             std::function<PooledInfoStack(PooledInfoStack)> process,
@@ -61,17 +66,30 @@ public:
     virtual pdal::point_count_t capacity() const override;
     virtual void reset() override;
 
+    // If set, each block of points is transformed in place as a single batch
+    // before being processed.  The transformation must outlive its use here.
+    void setTransformation(Transformation* t) { m_transformation = t; }
+
 protected:
     virtual char* getPoint(pdal::PointId i) override
     {
         m_size = i + 1;
-        return m_nodes[i]->val().data();
+
+        if (m_staging.empty()) return m_nodes[i]->val().data();
+        else return m_staging.data() + i * m_nativePointSize;
     }
 
 private:
     void allocate();
+    void transform(std::size_t size);
+    void quantize(std::size_t size);
 
     PointPool& m_pointPool;
+    const Schema& m_schema;
+    const std::size_t m_nativePointSize;
+    std::vector<char> m_staging;
+    BinaryPointTable m_quantizedTable;
+
     PooledInfoStack m_stack;
     std::deque<RawInfoNode*> m_nodes;   // m_nodes[0] -> m_stack.head()
     std::size_t m_size;
@@ -80,6 +98,11 @@ private:
 
     const pdal::Dimension::Id::Enum m_originId;
     const Origin m_origin;
+
+    Transformation* m_transformation;
+    std::vector<double> m_x;
+    std::vector<double> m_y;
+    std::vector<double> m_z;
 };
 
 } // namespace entwine
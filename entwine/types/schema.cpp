@@ -10,8 +10,13 @@
 
 #include <entwine/types/schema.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
 #include <numeric>
 
+#include <entwine/types/bbox.hpp>
 #include <entwine/types/simple-point-layout.hpp>
 
 namespace entwine
@@ -19,6 +24,20 @@ namespace entwine
 
 namespace
 {
+    namespace DimId = pdal::Dimension::Id;
+
+    const double lowest(std::numeric_limits<int32_t>::lowest());
+    const double highest(std::numeric_limits<int32_t>::max());
+
+    double store(const double v, const double scale, const double offset)
+    {
+        if (scale == 1.0 && offset == 0.0) return v;
+
+        return std::max(
+                lowest,
+                std::min(highest, std::round((v - offset) / scale)));
+    }
+
     DimList makeDims(const Json::Value& json)
     {
         return std::accumulate(
@@ -36,7 +55,9 @@ namespace
                             d["type"].asString(),
                             sizeDim.isIntegral() ?
                                 sizeDim.asUInt64() :
-                                std::stoul(sizeDim.asString())));
+                                std::stoul(sizeDim.asString()),
+                            d.isMember("scale") ? d["scale"].asDouble() : 1.0,
+                            d["offset"].asDouble()));
 
                     return out;
                 });
@@ -60,24 +81,39 @@ namespace
 Schema::Schema()
     : m_layout(new SimplePointLayout())
     , m_dims()
+    , m_scale(1, 1, 1)
+    , m_offset(0, 0, 0)
+    , m_native()
 { }
 
 Schema::Schema(DimList dims)
     : m_layout(makePointLayout(dims))
     , m_dims(dims)
-{ }
+    , m_scale(1, 1, 1)
+    , m_offset(0, 0, 0)
+    , m_native()
+{
+    initQuantization();
+}
 
 Schema::Schema(const Json::Value& json)
     : m_layout()
     , m_dims()
+    , m_scale(1, 1, 1)
+    , m_offset(0, 0, 0)
+    , m_native()
 {
     m_dims = makeDims(json);
     m_layout = makePointLayout(m_dims);
+    initQuantization();
 }
 
 Schema::Schema(const std::string& s)
     : m_layout()
     , m_dims()
+    , m_scale(1, 1, 1)
+    , m_offset(0, 0, 0)
+    , m_native()
 {
     Json::Value json;
     Json::Reader reader;
@@ -86,6 +122,7 @@ Schema::Schema(const std::string& s)
     {
         m_dims = makeDims(json);
         m_layout = makePointLayout(m_dims);
+        initQuantization();
     }
     else
     {
@@ -96,15 +133,21 @@ Schema::Schema(const std::string& s)
 }
 
 Schema::Schema(const Schema& other)
+    : m_layout()
+    , m_dims(other.m_dims)
+    , m_scale(1, 1, 1)
+    , m_offset(0, 0, 0)
+    , m_native()
 {
-    m_dims = other.m_dims;
     m_layout = makePointLayout(m_dims);
+    initQuantization();
 }
 
 Schema& Schema::operator=(const Schema& other)
 {
     m_dims = other.m_dims;
     m_layout = makePointLayout(m_dims);
+    initQuantization();
 
     return *this;
 }
@@ -123,6 +166,89 @@ void Schema::finalize()
     }
 }
 
+void Schema::initQuantization()
+{
+    m_scale = Point(1, 1, 1);
+    m_offset = Point(0, 0, 0);
+    m_native.reset();
+
+    DimList nativeDims;
+    bool quantized(false);
+
+    for (const auto& dim : m_dims)
+    {
+        if (isXyz(dim.id()) && dim.isScaled())
+        {
+            quantized = true;
+            nativeDims.push_back(DimInfo(dim.name(), "floating", 8));
+
+            double& scale(
+                    dim.id() == DimId::X ? m_scale.x :
+                    dim.id() == DimId::Y ? m_scale.y : m_scale.z);
+            double& offset(
+                    dim.id() == DimId::X ? m_offset.x :
+                    dim.id() == DimId::Y ? m_offset.y : m_offset.z);
+
+            scale = dim.scale();
+            offset = dim.offset();
+        }
+        else
+        {
+            nativeDims.push_back(dim);
+        }
+    }
+
+    if (quantized) m_native.reset(new Schema(nativeDims));
+}
+
+Schema Schema::quantize(const BBox& bbox, const double precision) const
+{
+    if (precision <= 0)
+    {
+        throw std::runtime_error("Invalid quantization precision");
+    }
+
+    const Point& min(bbox.min());
+    const Point& max(bbox.max());
+
+    DimList dims;
+
+    for (const auto& dim : m_dims)
+    {
+        double lo(0), hi(0);
+
+        if (dim.id() == DimId::X)       { lo = min.x; hi = max.x; }
+        else if (dim.id() == DimId::Y)  { lo = min.y; hi = max.y; }
+        else if (dim.id() == DimId::Z && bbox.is3d())
+        {
+            lo = min.z;
+            hi = max.z;
+        }
+        else
+        {
+            dims.push_back(dim);
+            continue;
+        }
+
+        // Use an offset that is a multiple of the precision, so stored
+        // values are exact multiples of the precision in real space as well.
+        const double mid((lo + hi) / 2.0);
+        const double offset(std::round(mid / precision) * precision);
+        const double scale(std::max(precision, (hi - lo) / highest));
+
+        dims.push_back(DimInfo(dim.name(), "signed", 4, scale, offset));
+    }
+
+    return Schema(dims);
+}
+
+void Schema::setPoint(pdal::PointRef& pointRef, const Point& point) const
+{
+    pointRef.setField(DimId::X, store(point.x, m_scale.x, m_offset.x));
+    pointRef.setField(DimId::Y, store(point.y, m_scale.y, m_offset.y));
+    pointRef.setField(DimId::Z, store(point.z, m_scale.z, m_offset.z));
+}
+
 Json::Value Schema::toJson() const
 {
     Json::Value json;
@@ -132,6 +258,13 @@ Json::Value Schema::toJson() const
         cur["name"] = dim.name();
         cur["type"] = dim.typeString();
         cur["size"] = static_cast<Json::UInt64>(dim.size());
+
+        if (dim.isScaled())
+        {
+            cur["scale"] = dim.scale();
+            cur["offset"] = dim.offset();
+        }
+
         json.append(cur);
     }
     return json;
@@ -11,16 +11,21 @@
 #pragma once
 
 #include <cstddef>
+#include <memory>
 #include <vector>
 
 #include <pdal/PointLayout.hpp>
+#include <pdal/PointRef.hpp>
 
 #include <entwine/third/json/json.hpp>
 #include <entwine/types/dim-info.hpp>
+#include <entwine/types/point.hpp>
 
 namespace entwine
 {
 
+class BBox;
+
 class Schema
 {
 public:
@@ -66,11 +71,59 @@ public:
         return *m_layout.get();
     }
 
+    // Returns a copy of this schema with X, Y, and Z stored as scaled 32-bit
+    // integers.  The offset is the center of _bbox_, and the scale is
+    // _precision_, coarsened if necessary so that values within twice the
+    // extents of _bbox_ are representable.  Z is only quantized if _bbox_ is
+    // 3D.
+    Schema quantize(const BBox& bbox, double precision) const;
+
+    static bool isXyz(pdal::Dimension::Id::Enum id)
+    {
+        return
+            id == pdal::Dimension::Id::X ||
+            id == pdal::Dimension::Id::Y ||
+            id == pdal::Dimension::Id::Z;
+    }
+
+    // True if any of X, Y, or Z are stored scaled.
+    bool quantized() const { return !!m_native; }
+
+    // The schema in which points are read from their sources - for a
+    // quantized schema, the same dimensions but with X, Y, and Z as doubles.
+    const Schema& native() const { return m_native ? *m_native : *this; }
+
+    // Get or set the real-valued XYZ of a point laid out by this schema.
+    // Values not representable in the quantized form are clamped.
+    Point point(const pdal::PointRef& pointRef) const
+    {
+        return Point(
+                pointRef.getFieldAs<double>(pdal::Dimension::Id::X) *
+                    m_scale.x + m_offset.x,
+                pointRef.getFieldAs<double>(pdal::Dimension::Id::Y) *
+                    m_scale.y + m_offset.y,
+                pointRef.getFieldAs<double>(pdal::Dimension::Id::Z) *
+                    m_scale.z + m_offset.z);
+    }
+
+    void setPoint(pdal::PointRef& pointRef, const Point& point) const;
+
+    // Per-axis scale and offset of XYZ, which are one and zero for axes that
+    // are not quantized.
+    const Point& scale() const { return m_scale; }
+    const Point& offset() const { return m_offset; }
+
     Json::Value toJson() const;
 
 private:
+    void initQuantization();
+
     std::unique_ptr<pdal::PointLayout> m_layout;
     DimList m_dims;
+
+    Point m_scale;
+    Point m_offset;
+    std::unique_ptr<Schema> m_native;
 };
 
 inline bool operator==(const Schema& lhs, const Schema& rhs)
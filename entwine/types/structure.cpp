@@ -131,7 +131,8 @@ Structure::Structure(
         const bool tubular,
         const bool dynamicChunks,
         const bool discardDuplicates,
-        const bool prefixIds)
+        const bool prefixIds,
+        const std::size_t chunkBlocks)
     : m_nullDepthBegin(0)
     , m_nullDepthEnd(nullDepth)
     , m_baseDepthBegin(m_nullDepthEnd)
@@ -147,6 +148,7 @@ Structure::Structure(
     , m_dynamicChunks(dynamicChunks)
     , m_discardDuplicates(discardDuplicates)
     , m_prefixIds(prefixIds)
+    , m_chunkBlocks(chunkBlocks)
     , m_dimensions(dimensions)
     , m_factor(1ULL << m_dimensions)
     , m_numPointsHint(numPointsHint)
@@ -170,6 +172,7 @@ Structure::Structure(const Json::Value& json)
     , m_dynamicChunks(json["dynamicChunks"].asBool())
     , m_discardDuplicates(json["discardDuplicates"].asBool())
     , m_prefixIds(json["prefixIds"].asBool())
+    , m_chunkBlocks(json["chunkBlocks"].asUInt64())
     , m_dimensions(json["dimensions"].asUInt64())
     , m_factor(1ULL << m_dimensions)
     , m_numPointsHint(json["numPointsHint"].asUInt64())
@@ -212,7 +215,7 @@ void Structure::accomodateSubset(
                         m_coldDepthBegin).getSimple());
 
             std::size_t splits(m_factor);
-            while (splits < subset.of()) splits *= m_factor;
+            while (splits < subset.splits()) splits *= m_factor;
 
             if (
                     (coldFirstSpan / m_chunkPoints) < splits ||
@@ -333,6 +336,11 @@ Json::Value Structure::toJson() const
     json["discardDuplicates"] = m_discardDuplicates;
     json["prefixIds"] = m_prefixIds;
 
+    if (m_chunkBlocks)
+    {
+        json["chunkBlocks"] = static_cast<Json::UInt64>(m_chunkBlocks);
+    }
+
     return json;
 }
 
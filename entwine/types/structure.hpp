@@ -77,7 +77,8 @@ public:
             bool tubular,
             bool dynamicChunks,
             bool discardDuplicates,
-            bool prefixIds);
+            bool prefixIds,
+            std::size_t chunkBlocks = 0);
 
     // Lossless.
     Structure(
@@ -152,6 +153,10 @@ public:
     bool dynamicChunks() const      { return m_dynamicChunks; }
     bool discardDuplicates() const  { return m_discardDuplicates; }
     bool prefixIds() const          { return m_prefixIds; }
+
+    // If greater than one, cold chunks are split into this many separately
+    // compressed blocks so that readers may fetch only the parts they need.
+    std::size_t chunkBlocks() const { return m_chunkBlocks; }
     bool is3d() const               { return m_dimensions == 3; }
 
     ChunkInfo getInfo(const Id& index) const { return ChunkInfo(*this, index); }
@@ -237,6 +242,7 @@ private:
     bool m_dynamicChunks;
     bool m_discardDuplicates;
     bool m_prefixIds;
+    std::size_t m_chunkBlocks;
 
     std::size_t m_dimensions;
     std::size_t m_factor;
@@ -10,14 +10,63 @@
 
 #include <entwine/types/subset.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <entwine/third/json/json.hpp>
 #include <entwine/tree/climber.hpp>
 #include <entwine/tree/hierarchy.hpp>
+#include <entwine/tree/manifest.hpp>
+#include <entwine/types/dir.hpp>
 #include <entwine/types/range.hpp>
 #include <entwine/types/structure.hpp>
 
 namespace entwine
 {
 
+namespace
+{
+    // Always split only in X-Y, since data tends not to be dense throughout
+    // the entire Z-range.
+    const std::size_t dimensions(2);
+    const std::size_t factor(4);
+
+    // Number of depths beyond the minimum that balanced partitions are
+    // computed over - each subset boundary may then fall on any of
+    // (factor ^ balanceDepths) cells rather than on a single even split.
+    const std::size_t balanceDepths(2);
+
+    std::size_t getMinNullDepth(const std::size_t of)
+    {
+        std::size_t minNullDepth(1);
+        std::size_t cap(factor);
+
+        while (cap < of)
+        {
+            ++minNullDepth;
+            cap *= factor;
+        }
+
+        return minNullDepth;
+    }
+
+    // Interleave the bits of the X and Y cell indices, so the X bit occupies
+    // the east position and the Y bit the north position of each Dir.
+    std::size_t morton(const std::size_t x, const std::size_t y)
+    {
+        std::size_t result(0);
+
+        for (std::size_t i(0); i < 32; ++i)
+        {
+            result |= ((x >> i) & 1) << (i * dimensions);
+            result |= ((y >> i) & 1) << (i * dimensions + 1);
+        }
+
+        return result;
+    }
+}
+
 Subset::Subset(
         Structure& structure,
         const BBox& bbox,
@@ -25,6 +74,11 @@ Subset::Subset(
         const std::size_t of)
     : m_id(id - 1)
     , m_of(of)
+    , m_depth(0)
+    , m_begin(0)
+    , m_end(0)
+    , m_balanced(false)
+    , m_full(bbox)
     , m_sub()
 {
     if (!id) throw std::runtime_error("Subset IDs should be 1-based.");
@@ -38,9 +92,20 @@ Subset::Subset(
         const Json::Value& json)
     : m_id(json["id"].asUInt64() - 1)
     , m_of(json["of"].asUInt64())
+    , m_depth(json["depth"].asUInt64())
+    , m_begin(json["begin"].asUInt64())
+    , m_end(json["end"].asUInt64())
+    , m_balanced(json.isMember("depth"))
+    , m_full(bbox)
     , m_sub()
 {
-    split(structure, bbox);
+    if (!json["id"].asUInt64())
+    {
+        throw std::runtime_error("Subset IDs should be 1-based.");
+    }
+
+    if (m_balanced) assign(structure, bbox);
+    else split(structure, bbox);
 }
 
 Json::Value Subset::toJson() const
@@ -50,9 +115,224 @@ Json::Value Subset::toJson() const
     json["id"] = static_cast<Json::UInt64>(m_id + 1);
     json["of"] = static_cast<Json::UInt64>(m_of);
 
+    if (m_balanced)
+    {
+        json["depth"] = static_cast<Json::UInt64>(m_depth);
+        json["begin"] = static_cast<Json::UInt64>(m_begin);
+        json["end"] = static_cast<Json::UInt64>(m_end);
+    }
+
+    return json;
+}
+
+Json::Value Subset::partition(
+        const Manifest& manifest,
+        const BBox& bbox,
+        const std::size_t of)
+{
+    if (of <= 1 || of > 64)
+    {
+        throw std::runtime_error("Invalid subset range");
+    }
+
+    const std::size_t depth(getMinNullDepth(of) + balanceDepths);
+    const std::size_t span(1ULL << depth);
+    const std::size_t cells(span * span);
+
+    const double cellWidth(bbox.width() / span);
+    const double cellDepth(bbox.depth() / span);
+
+    // Estimate the point count of each cell by distributing the points of
+    // each file over the cells it overlaps, proportionally to the overlapping
+    // XY area.  Files with unknown bounds are spread evenly.
+    std::vector<double> weights(cells, 0);
+    double unbounded(0);
+
+    auto index([&](double v, double min, double size)
+    {
+        const double i(std::floor((v - min) / size));
+        return static_cast<std::size_t>(
+                std::max<double>(0, std::min<double>(i, span - 1)));
+    });
+
+    for (const FileInfo& f : manifest.paths())
+    {
+        const double numPoints(f.numPoints());
+        if (!numPoints) continue;
+
+        const BBox* fileBBox(f.bbox());
+
+        if (!fileBBox)
+        {
+            unbounded += numPoints;
+            continue;
+        }
+
+        const Point& fMin(fileBBox->min());
+        const Point& fMax(fileBBox->max());
+
+        const std::size_t xBegin(index(fMin.x, bbox.min().x, cellWidth));
+        const std::size_t xEnd(index(fMax.x, bbox.min().x, cellWidth) + 1);
+        const std::size_t yBegin(index(fMin.y, bbox.min().y, cellDepth));
+        const std::size_t yEnd(index(fMax.y, bbox.min().y, cellDepth) + 1);
+
+        const double area(fileBBox->width() * fileBBox->depth());
+
+        if (area <= 0)
+        {
+            weights[morton(xBegin, yBegin)] += numPoints;
+            continue;
+        }
+
+        for (std::size_t y(yBegin); y < yEnd; ++y)
+        {
+            const double cyMin(bbox.min().y + y * cellDepth);
+            const double yOverlap(
+                    std::min(fMax.y, cyMin + cellDepth) -
+                    std::max(fMin.y, cyMin));
+
+            if (yOverlap <= 0) continue;
+
+            for (std::size_t x(xBegin); x < xEnd; ++x)
+            {
+                const double cxMin(bbox.min().x + x * cellWidth);
+                const double xOverlap(
+                        std::min(fMax.x, cxMin + cellWidth) -
+                        std::max(fMin.x, cxMin));
+
+                if (xOverlap <= 0) continue;
+
+                weights[morton(x, y)] += numPoints * xOverlap * yOverlap / area;
+            }
+        }
+    }
+
+    double total(unbounded);
+    for (const double w : weights) total += w;
+
+    // Without any point counts, fall back to an even division of cells.
+    if (total <= 0)
+    {
+        std::fill(weights.begin(), weights.end(), 1);
+        total = cells;
+    }
+    else if (unbounded > 0)
+    {
+        for (double& w : weights) w += unbounded / cells;
+    }
+
+    // Place each boundary at the first cell whose cumulative weight reaches
+    // its share of the total, leaving at least one cell per subset.
+    std::vector<std::size_t> bounds(1, 0);
+    std::size_t cell(0);
+    double cumulative(0);
+
+    for (std::size_t i(1); i < of; ++i)
+    {
+        const double target(total * i / of);
+
+        while (cell < cells && cumulative + weights[cell] <= target)
+        {
+            cumulative += weights[cell++];
+        }
+
+        std::size_t bound(std::max(cell, bounds.back() + 1));
+        bound = std::min(bound, cells - (of - i));
+
+        while (cell < bound) cumulative += weights[cell++];
+
+        bounds.push_back(bound);
+    }
+
+    bounds.push_back(cells);
+
+    Json::Value json;
+
+    for (std::size_t i(0); i < of; ++i)
+    {
+        Json::Value& subset(json.append(Json::Value()));
+
+        subset["id"] = static_cast<Json::UInt64>(i + 1);
+        subset["of"] = static_cast<Json::UInt64>(of);
+        subset["depth"] = static_cast<Json::UInt64>(depth);
+        subset["begin"] = static_cast<Json::UInt64>(bounds[i]);
+        subset["end"] = static_cast<Json::UInt64>(bounds[i + 1]);
+    }
+
     return json;
 }
 
+bool Subset::contains(const Point& point) const
+{
+    if (!m_balanced) return m_sub.contains(point);
+
+    const std::size_t c(cell(point));
+    return c >= m_begin && c < m_end;
+}
+
+std::size_t Subset::splits() const
+{
+    if (m_balanced) return 1ULL << (m_depth * dimensions);
+    else return m_of;
+}
+
+std::size_t Subset::cell(const Point& point) const
+{
+    BBox current(m_full);
+    std::size_t result(0);
+
+    for (std::size_t i(0); i < m_depth; ++i)
+    {
+        const Dir dir(toDir(toIntegral(getDirection(point, current.mid())) % 4));
+
+        result = (result << dimensions) | toIntegral(dir);
+        current.go(dir, true);
+    }
+
+    return result;
+}
+
+void Subset::assign(Structure& structure, const BBox& bbox)
+{
+    const std::size_t cells(1ULL << (m_depth * dimensions));
+
+    if (
+            m_of <= 1 || m_of > 64 || m_id >= m_of ||
+            m_depth < getMinNullDepth(m_of) || m_depth > 16 ||
+            m_begin >= m_end || m_end > cells)
+    {
+        throw std::runtime_error("Invalid subset range");
+    }
+
+    const std::size_t mask(0x3);
+
+    bool set(false);
+
+    for (std::size_t curId(m_begin); curId < m_end; ++curId)
+    {
+        BBox current(bbox);
+
+        for (std::size_t i(m_depth - 1); i < m_depth; --i)
+        {
+            current.go(toDir(curId >> (i * dimensions) & mask), true);
+        }
+
+        if (!set)
+        {
+            m_sub = current;
+            set = true;
+        }
+        else
+        {
+            m_sub.grow(current);
+        }
+    }
+
+    m_sub.growZ(Range(bbox.min().z, bbox.max().z));
+
+    structure.accomodateSubset(*this, m_depth);
+}
+
 void Subset::split(Structure& structure, const BBox& bbox)
 {
     if (m_of <= 1 || m_of > 64)
@@ -60,11 +340,6 @@ void Subset::split(Structure& structure, const BBox& bbox)
         throw std::runtime_error("Invalid subset range");
     }
 
-    // Always split only in X-Y, since data tends not to be dense throughout
-    // the entire Z-range.
-    const std::size_t dimensions(2);
-    const std::size_t factor(4);
-
     const std::size_t log(std::log2(m_of));
 
     if (static_cast<std::size_t>(std::pow(2, log)) != m_of)
@@ -72,18 +347,16 @@ void Subset::split(Structure& structure, const BBox& bbox)
         throw std::runtime_error("Subset range must be a power of 2");
     }
 
-    std::size_t minNullDepth(1);
-    std::size_t cap(factor);
-
-    while (cap < m_of)
-    {
-        ++minNullDepth;
-        cap *= factor;
-    }
+    const std::size_t minNullDepth(getMinNullDepth(m_of));
+    const std::size_t cap(std::pow(factor, minNullDepth));
 
     const std::size_t boxes(cap / m_of);
     const std::size_t startOffset(m_id * boxes);
 
+    m_depth = minNullDepth;
+    m_begin = startOffset;
+    m_end = startOffset + boxes;
+
     const std::size_t iterations(ChunkInfo::logN(cap, factor));
     const std::size_t mask(0x3);
 
@@ -12,6 +12,7 @@
 
 #include <cstddef>
 #include <memory>
+#include <string>
 
 #include <entwine/types/bbox.hpp>
 
@@ -23,8 +24,13 @@ namespace Json
 namespace entwine
 {
 
+class Manifest;
 class Structure;
 
+// A subset covers a contiguous range, in Morton order, of the XY cells at a
+// fixed depth of the tree.  By default the cells are divided evenly, which
+// requires a power-of-two subset count.  Alternatively, the ranges may be
+// balanced by point density with Subset::partition.
 class Subset
 {
 public:
@@ -38,19 +44,48 @@ public:
 
     Json::Value toJson() const;
 
+    // Divide _bbox_ into _of_ subsets containing roughly equal numbers of
+    // points, estimated from the per-file bounds and point counts of the
+    // manifest.  Returns an array of subset JSON specifications, in order of
+    // subset ID, which may each be passed to the JSON constructor.
+    static Json::Value partition(
+            const Manifest& manifest,
+            const BBox& bbox,
+            std::size_t of);
+
     std::size_t id() const { return m_id; }
     std::size_t of() const { return m_of; }
+
+    // Bounds of the entire subset region.  Only for balanced subsets may
+    // this contain points that do not belong to this subset.
     const BBox& bbox() const { return m_sub; }
 
+    bool contains(const Point& point) const;
+
+    // The minimum number of XY divisions of the cold depths required so that
+    // no chunk spans multiple subsets.
+    std::size_t splits() const;
+
     std::string postfix() const { return "-" + std::to_string(m_id); }
     bool primary() const { return !m_id; }
 
 private:
     void split(Structure& structure, const BBox& fullBBox);
+    void assign(Structure& structure, const BBox& fullBBox);
+
+    std::size_t cell(const Point& point) const;
 
     std::size_t m_id;
     std::size_t m_of;
 
+    // Cell depth, and the range of cells [begin, end) belonging to this
+    // subset.
+    std::size_t m_depth;
+    std::size_t m_begin;
+    std::size_t m_end;
+    bool m_balanced;
+
+    BBox m_full;
     BBox m_sub;
 };
 
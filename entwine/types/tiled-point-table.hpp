@@ -10,3 +10,87 @@
 
 #pragma once
 
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include <pdal/PointTable.hpp>
+
+#include <entwine/types/schema.hpp>
+
+namespace entwine
+{
+
+// A read-only point table over points scattered across any number of
+// buffers.  Points are referenced rather than copied, so the buffers must
+// outlive this table.
+class TiledPointTable : public pdal::BasePointTable
+{
+public:
+    explicit TiledPointTable(const Schema& schema)
+        : BasePointTable(schema.pdalLayout())
+        , m_schema(schema)
+        , m_points()
+    { }
+
+    // Reference every point of a contiguous buffer.
+    void append(std::vector<char>& data)
+    {
+        const std::size_t pointSize(m_schema.pointSize());
+        const std::size_t numPoints(data.size() / pointSize);
+
+        m_points.reserve(m_points.size() + numPoints);
+
+        char* pos(data.data());
+        for (std::size_t i(0); i < numPoints; ++i)
+        {
+            m_points.push_back(pos);
+            pos += pointSize;
+        }
+    }
+
+    // Reference individual points.
+    void append(const std::vector<char*>& points)
+    {
+        m_points.insert(m_points.end(), points.begin(), points.end());
+    }
+
+    std::size_t size() const { return m_points.size(); }
+
+    virtual char* getPoint(pdal::PointId i) override
+    {
+        return m_points[i];
+    }
+
+private:
+    virtual void setFieldInternal(
+            pdal::Dimension::Id::Enum dimId,
+            pdal::PointId i,
+            const void* pos) override
+    {
+        throw std::runtime_error("TiledPointTable is read-only");
+    }
+
+    virtual void getFieldInternal(
+            pdal::Dimension::Id::Enum dimId,
+            pdal::PointId i,
+            void* pos) const override
+    {
+        const pdal::Dimension::Detail& dimDetail(
+                *m_schema.pdalLayout().dimDetail(dimId));
+        const char* src(m_points[i] + dimDetail.offset());
+
+        std::copy(src, src + dimDetail.size(), static_cast<char*>(pos));
+    }
+
+    virtual pdal::PointId addPoint() override
+    {
+        throw std::runtime_error("Cannot add points to a TiledPointTable");
+    }
+
+    const Schema& m_schema;
+    std::vector<char*> m_points;
+};
+
+} // namespace entwine
+
@@ -10,8 +10,6 @@
 
 #include <entwine/util/executor.hpp>
 
-#include <pdal/BufferReader.hpp>
-#include <pdal/Filter.hpp>
 #include <pdal/QuickInfo.hpp>
 #include <pdal/Reader.hpp>
 #include <pdal/SpatialReference.hpp>
@@ -21,6 +19,7 @@
 #include <entwine/types/pooled-point-table.hpp>
 #include <entwine/types/reprojection.hpp>
 #include <entwine/types/schema.hpp>
+#include <entwine/util/synthetic.hpp>
 
 namespace entwine
 {
@@ -37,57 +36,13 @@ namespace
 
     const double hi(std::numeric_limits<double>::max());
     const double lo(std::numeric_limits<double>::lowest());
-
-    class BufferState
-    {
-    public:
-        BufferState(const BBox& bbox)
-            : m_table()
-            , m_view(new pdal::PointView(m_table))
-            , m_buffer()
-        {
-            namespace DimId = pdal::Dimension::Id;
-
-            auto layout(m_table.layout());
-            layout->registerDim(DimId::X);
-            layout->registerDim(DimId::Y);
-            layout->registerDim(DimId::Z);
-            layout->finalize();
-
-            m_view->setField(DimId::X, 0, bbox.min().x);
-            m_view->setField(DimId::Y, 0, bbox.min().y);
-            m_view->setField(DimId::Z, 0, bbox.min().z);
-
-            m_view->setField(DimId::X, 1, bbox.max().x);
-            m_view->setField(DimId::Y, 1, bbox.max().y);
-            m_view->setField(DimId::Z, 1, bbox.max().z);
-
-            m_view->setField(DimId::X, 2, bbox.min().x);
-            m_view->setField(DimId::Y, 2, bbox.max().y);
-            m_view->setField(DimId::Z, 2, bbox.min().z);
-
-            m_view->setField(DimId::X, 3, bbox.max().x);
-            m_view->setField(DimId::Y, 3, bbox.min().y);
-            m_view->setField(DimId::Z, 3, bbox.max().z);
-
-            m_buffer.addView(m_view);
-        }
-
-        pdal::PointTable& getTable() { return m_table; }
-        pdal::PointView& getView() { return *m_view; }
-        pdal::BufferReader& getBuffer() { return m_buffer; }
-
-    private:
-        pdal::PointTable m_table;
-        pdal::PointViewPtr m_view;
-        pdal::BufferReader m_buffer;
-    };
 }
 
 Executor::Executor(bool is3d)
     : m_is3d(is3d)
     , m_stageFactory(new pdal::StageFactory())
     , m_factoryMutex()
+    , m_transformationCache()
 { }
 
 Executor::~Executor()
@@ -98,16 +53,21 @@ bool Executor::run(
         const std::string path,
         const Reprojection* reprojection)
 {
+    if (Synthetic::is(path))
+    {
+        Synthetic::create(path)->run(table);
+        return true;
+    }
+
     UniqueStage scopedReader(createReader(path));
     if (!scopedReader) return false;
 
     pdal::Reader* reader(scopedReader->getAs<pdal::Reader*>());
-    pdal::Stage* executor(reader);
 
     // Needed so that getSpatialReference has been initialized.
     { auto lock(getLock()); reader->prepare(table); }
 
-    UniqueStage scopedFilter;
+    UniqueTransformation transformation;
 
     if (reprojection)
     {
@@ -115,23 +75,22 @@ bool Executor::run(
                 srsFoundOrDefault(
                     reader->getSpatialReference(), *reprojection));
 
-        scopedFilter = createReprojectionFilter(srs);
-        if (!scopedFilter) return false;
-
-        pdal::Filter* filter(scopedFilter->getAs<pdal::Filter*>());
-        filter->setInput(*reader);
-
-        executor = filter;
+        // Rather than running a reprojection filter per point, transform each
+        // block of points in the table at once with a cached transformation.
+        transformation = m_transformationCache.acquire(srs);
+        table.setTransformation(transformation.get());
     }
 
-    { auto lock(getLock()); executor->prepare(table); }
-    executor->execute(table);
+    reader->execute(table);
+    table.setTransformation(nullptr);
 
     return true;
 }
 
 bool Executor::good(const std::string path) const
 {
+    if (Synthetic::is(path)) return true;
+
     auto ext(arbiter::Arbiter::getExtension(path));
     if (ext == "txt" || ext == "text") return false;
     return !m_stageFactory->inferReaderDriver(path).empty();
@@ -143,6 +102,21 @@ std::unique_ptr<Preview> Executor::preview(
 {
     std::unique_ptr<Preview> result;
 
+    if (Synthetic::is(path))
+    {
+        // Synthetic sources are generated in the output coordinate system.
+        auto synthetic(Synthetic::create(path));
+
+        result.reset(
+                new Preview(
+                    synthetic->bbox(),
+                    synthetic->numPoints(),
+                    "",
+                    Synthetic::dimNames()));
+
+        return result;
+    }
+
     UniqueStage scopedReader(createReader(path));
     if (!scopedReader) return result;
 
@@ -169,39 +143,33 @@ std::unique_ptr<Preview> Executor::preview(
     }
     else
     {
-        namespace DimId = pdal::Dimension::Id;
-
-        BufferState bufferState(bbox);
-
         const auto selectedSrs(
                 srsFoundOrDefault(qi.m_srs, *reprojection));
 
-        UniqueStage scopedFilter(createReprojectionFilter(selectedSrs));
-        if (!scopedFilter) return result;
-
-        pdal::Filter* filter(scopedFilter->getAs<pdal::Filter*>());
+        std::vector<double> x {
+            bbox.min().x, bbox.max().x, bbox.min().x, bbox.max().x
+        };
+        std::vector<double> y {
+            bbox.min().y, bbox.max().y, bbox.max().y, bbox.min().y
+        };
+        std::vector<double> z {
+            bbox.min().z, bbox.max().z, bbox.min().z, bbox.max().z
+        };
 
-        filter->setInput(bufferState.getBuffer());
-        { auto lock(getLock()); filter->prepare(bufferState.getTable()); }
-        filter->execute(bufferState.getTable());
+        m_transformationCache.acquire(selectedSrs)->transform(x, y, z);
 
         Point min(hi, hi, hi);
         Point max(lo, lo, lo);
 
-        for (std::size_t i(0); i < bufferState.getView().size(); ++i)
+        for (std::size_t i(0); i < x.size(); ++i)
         {
-            const Point p(
-                    bufferState.getView().getFieldAs<double>(DimId::X, i),
-                    bufferState.getView().getFieldAs<double>(DimId::Y, i),
-                    bufferState.getView().getFieldAs<double>(DimId::Z, i));
-
-            min.x = std::min(min.x, p.x);
-            min.y = std::min(min.y, p.y);
-            min.z = std::min(min.z, p.z);
-
-            max.x = std::max(max.x, p.x);
-            max.y = std::max(max.y, p.y);
-            max.z = std::max(max.z, p.z);
+            min.x = std::min(min.x, x[i]);
+            min.y = std::min(min.y, y[i]);
+            min.z = std::min(min.z, z[i]);
+
+            max.x = std::max(max.x, x[i]);
+            max.y = std::max(max.y, y[i]);
+            max.z = std::max(max.z, z[i]);
         }
 
         bbox = BBox(min, max, m_is3d);
@@ -246,37 +214,6 @@ UniqueStage Executor::createReader(const std::string path) const
     return result;
 }
 
-UniqueStage Executor::createReprojectionFilter(
-        const Reprojection& reproj) const
-{
-    UniqueStage result;
-
-    if (reproj.in().empty())
-    {
-        throw std::runtime_error("No default SRS supplied, and none inferred");
-    }
-
-    auto lock(getLock());
-
-    if (pdal::Filter* filter =
-            static_cast<pdal::Filter*>(
-                m_stageFactory->createStage("filters.reprojection")))
-    {
-        pdal::Options options;
-        options.add(pdal::Option("in_srs", reproj.in()));
-        options.add(pdal::Option("out_srs", reproj.out()));
-        filter->setOptions(options);
-
-        // Unlock before creating the ScopedStage, in case of a throw we can't
-        // hold the lock during its destructor.
-        lock.unlock();
-
-        result.reset(new ScopedStage(filter, *m_stageFactory, m_factoryMutex));
-    }
-
-    return result;
-}
-
 std::unique_lock<std::mutex> Executor::getLock() const
 {
     return std::unique_lock<std::mutex>(m_factoryMutex);
@@ -17,11 +17,11 @@
 
 #include <entwine/types/bbox.hpp>
 #include <entwine/types/structure.hpp>
+#include <entwine/util/transformation.hpp>
 
 namespace pdal
 {
     class BasePointTable;
-    class Filter;
     class PointView;
     class Reader;
     class Stage;
@@ -87,7 +87,8 @@ public:
             std::string path,
             const Reprojection* reprojection);
 
-    // True if this path is recognized as a point cloud file.
+    // True if this path is recognized as a point cloud file, or is a
+    // synthetic source descriptor (see Synthetic).
     bool good(std::string path) const;
 
     // If available, return the bounds specified in the file header without
@@ -100,13 +101,14 @@ public:
 
 private:
     UniqueStage createReader(std::string path) const;
-    UniqueStage createReprojectionFilter(const Reprojection& r) const;
 
     std::unique_lock<std::mutex> getLock() const;
 
     bool m_is3d;
     std::unique_ptr<pdal::StageFactory> m_stageFactory;
     mutable std::mutex m_factoryMutex;
+
+    TransformationCache m_transformationCache;
 };
 
 } // namespace entwine
@@ -0,0 +1,197 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/util/inference-cache.hpp>
+
+#include <sys/stat.h>
+
+#include <iostream>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/types/reprojection.hpp>
+
+namespace entwine
+{
+
+InferenceCache::Entry::Entry(
+        const std::string fingerprint,
+        const std::size_t numPoints,
+        const BBox& bbox,
+        const std::string srs,
+        const std::vector<std::string> dimNames,
+        const bool exact)
+    : fingerprint(fingerprint)
+    , numPoints(numPoints)
+    , bbox(bbox)
+    , srs(srs)
+    , dimNames(dimNames)
+    , exact(exact)
+{ }
+
+InferenceCache::Entry::Entry(const Json::Value& json)
+    : fingerprint(json["fingerprint"].asString())
+    , numPoints(json["numPoints"].asUInt64())
+    , bbox(json["bbox"])
+    , srs(json["srs"].asString())
+    , dimNames()
+    , exact(json["exact"].asBool())
+{
+    const Json::Value& dims(json["dims"]);
+    for (Json::ArrayIndex i(0); i < dims.size(); ++i)
+    {
+        dimNames.push_back(dims[i].asString());
+    }
+}
+
+Json::Value InferenceCache::Entry::toJson() const
+{
+    Json::Value json;
+
+    json["fingerprint"] = fingerprint;
+    json["numPoints"] = static_cast<Json::UInt64>(numPoints);
+    json["bbox"] = bbox.toJson();
+    json["srs"] = srs;
+    json["exact"] = exact;
+
+    Json::Value& dims(json["dims"]);
+    for (const auto& d : dimNames) dims.append(d);
+
+    return json;
+}
+
+InferenceCache::InferenceCache(
+        const arbiter::Arbiter& arbiter,
+        const std::string path,
+        const Reprojection* reprojection)
+    : m_arbiter(arbiter)
+    , m_path(path)
+    , m_reprojection(reprojection ? reprojection->toJson() : Json::Value())
+    , m_entries()
+    , m_mutex()
+{
+    std::unique_ptr<std::string> data(m_arbiter.tryGet(m_path));
+    if (!data) return;
+
+    Json::Value json;
+    Json::Reader reader;
+
+    if (!reader.parse(*data, json, false))
+    {
+        std::cout << "Ignoring invalid inference cache: " << m_path <<
+            std::endl;
+        return;
+    }
+
+    if (json["reprojection"] != m_reprojection)
+    {
+        std::cout << "Reprojection changed - ignoring inference cache" <<
+            std::endl;
+        return;
+    }
+
+    const Json::Value& files(json["files"]);
+
+    for (const auto& key : files.getMemberNames())
+    {
+        m_entries.insert(std::make_pair(key, Entry(files[key])));
+    }
+}
+
+std::string InferenceCache::fingerprint(const std::string& path) const
+{
+    std::string result;
+
+    if (m_arbiter.isRemote(path))
+    {
+        if (auto size = m_arbiter.tryGetSize(path))
+        {
+            result = std::to_string(*size);
+
+            // Objects are commonly rewritten at the same size, so the size
+            // alone cannot tell whether this one has changed.
+            if (auto version = m_arbiter.tryGetVersion(path))
+            {
+                result += "-" + *version;
+            }
+        }
+    }
+    else
+    {
+        const std::string local(
+                arbiter::fs::expandTilde(arbiter::Arbiter::stripType(path)));
+
+        struct stat info;
+
+        if (stat(local.c_str(), &info) == 0)
+        {
+            result =
+                std::to_string(info.st_size) + "-" +
+                std::to_string(info.st_mtime);
+        }
+    }
+
+    return result;
+}
+
+std::unique_ptr<InferenceCache::Entry> InferenceCache::get(
+        const std::string& path,
+        const std::string& fingerprint,
+        const bool trustHeaders) const
+{
+    std::unique_ptr<Entry> result;
+    if (fingerprint.empty()) return result;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it(m_entries.find(path));
+
+    if (
+            it != m_entries.end() &&
+            it->second.fingerprint == fingerprint &&
+            (trustHeaders || it->second.exact))
+    {
+        result.reset(new Entry(it->second));
+    }
+
+    return result;
+}
+
+void InferenceCache::set(const std::string& path, const Entry& entry)
+{
+    if (entry.fingerprint.empty()) return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it(m_entries.find(path));
+    if (it != m_entries.end()) it->second = entry;
+    else m_entries.insert(std::make_pair(path, entry));
+}
+
+void InferenceCache::save(const std::set<std::string>& paths) const
+{
+    Json::Value json;
+    json["reprojection"] = m_reprojection;
+
+    Json::Value& files(json["files"]);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& p : m_entries)
+        {
+            if (paths.count(p.first)) files[p.first] = p.second.toJson();
+        }
+    }
+
+    Json::FastWriter writer;
+    m_arbiter.put(m_path, writer.write(json));
+}
+
+} // namespace entwine
+
@@ -0,0 +1,105 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <entwine/third/json/json.hpp>
+#include <entwine/types/bbox.hpp>
+
+namespace arbiter
+{
+    class Arbiter;
+}
+
+namespace entwine
+{
+
+class Reprojection;
+
+// Persisted per-file inference results, so that repeated inferences over a
+// mostly unchanged set of inputs only need to examine new or changed files.
+class InferenceCache
+{
+public:
+    class Entry
+    {
+    public:
+        Entry(
+                std::string fingerprint,
+                std::size_t numPoints,
+                const BBox& bbox,
+                std::string srs,
+                std::vector<std::string> dimNames,
+                bool exact);
+
+        explicit Entry(const Json::Value& json);
+
+        Json::Value toJson() const;
+
+        std::string fingerprint;
+        std::size_t numPoints;
+        BBox bbox;
+        std::string srs;
+        std::vector<std::string> dimNames;
+
+        // True if the bounds were calculated from the actual points rather
+        // than the file header.
+        bool exact;
+    };
+
+    // If the cache at this path was created with a different reprojection,
+    // its contents are discarded.
+    InferenceCache(
+            const arbiter::Arbiter& arbiter,
+            std::string path,
+            const Reprojection* reprojection);
+
+    // Returns an identifier that changes whenever the file at this path
+    // changes, or an empty string if one cannot be determined.  For local
+    // files this is composed of the size and modification time - for remote
+    // files, of the size and the ETag or Last-Modified time, if the server
+    // provides either.
+    std::string fingerprint(const std::string& path) const;
+
+    // Returns a cached entry matching this fingerprint, if one exists.  If
+    // headers are not trusted, only exact entries are returned.
+    std::unique_ptr<Entry> get(
+            const std::string& path,
+            const std::string& fingerprint,
+            bool trustHeaders) const;
+
+    void set(const std::string& path, const Entry& entry);
+
+    // Write the cache back to its source path, keeping only the entries for
+    // _paths_ so that files removed from the inputs are forgotten.
+    void save(const std::set<std::string>& paths) const;
+
+private:
+    const arbiter::Arbiter& m_arbiter;
+    const std::string m_path;
+    Json::Value m_reprojection;
+
+    std::map<std::string, Entry> m_entries;
+    mutable std::mutex m_mutex;
+
+    InferenceCache(const InferenceCache&);
+    InferenceCache& operator=(const InferenceCache&);
+};
+
+} // namespace entwine
+
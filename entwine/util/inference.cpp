@@ -10,6 +10,8 @@
 
 #include <entwine/util/inference.hpp>
 
+#include <set>
+
 #include <pdal/PointView.hpp>
 
 #include <entwine/types/reprojection.hpp>
@@ -38,6 +40,8 @@ namespace
         return b;
     })());
 
+    typedef std::vector<std::string> DimNames;
+
     const Schema xyzSchema(([]()
     {
         DimList dims;
@@ -55,7 +59,8 @@ Inference::Inference(
         const bool verbose,
         const Reprojection* reprojection,
         const bool trustHeaders,
-        arbiter::Arbiter* arbiter)
+        arbiter::Arbiter* arbiter,
+        const std::string cachePath)
     : m_executor(true)
     , m_pointPool(xyzSchema)
     , m_reproj(reprojection)
@@ -67,6 +72,10 @@ Inference::Inference(
     , m_arbiter(arbiter ? arbiter : m_ownedArbiter.get())
     , m_tmp(m_arbiter->getEndpoint(tmpPath))
     , m_manifest(m_arbiter->resolve(path, verbose))
+    , m_cache(
+            cachePath.size() ?
+                new InferenceCache(*m_arbiter, cachePath, reprojection) :
+                nullptr)
     , m_index(0)
     , m_dimVec()
     , m_dimSet()
@@ -80,7 +89,8 @@ Inference::Inference(
         const bool verbose,
         const Reprojection* reprojection,
         const bool trustHeaders,
-        arbiter::Arbiter* arbiter)
+        arbiter::Arbiter* arbiter,
+        const std::string cachePath)
     : m_executor(true)
     , m_pointPool(xyzSchema)
     , m_reproj(reprojection)
@@ -92,6 +102,10 @@ Inference::Inference(
     , m_arbiter(arbiter ? arbiter : m_ownedArbiter.get())
     , m_tmp(m_arbiter->getEndpoint(tmpPath))
     , m_manifest(manifest)
+    , m_cache(
+            cachePath.size() ?
+                new InferenceCache(*m_arbiter, cachePath, reprojection) :
+                nullptr)
     , m_index(0)
     , m_dimVec()
     , m_dimSet()
@@ -123,46 +137,23 @@ void Inference::go()
         if (m_executor.good(f.path()))
         {
             valid = true;
-
-            if (m_arbiter->isHttpDerived(f.path()))
-            {
-                const arbiter::http::Headers range(([&f]()
-                {
-                    arbiter::http::Headers h;
-                    h["Range"] = "bytes=0-16384";
-                    return h;
-                })());
-
-                m_pool->add([this, &f, range]()
-                {
-                    const auto data(m_arbiter->getBinary(f.path(), range));
-
-                    std::string name(f.path());
-                    std::replace(name.begin(), name.end(), '/', '-');
-                    std::replace(name.begin(), name.end(), '\\', '-');
-
-                    m_tmp.putSubpath(name, data);
-
-                    add(m_tmp.fullPath(name), f);
-
-                    arbiter::fs::remove(m_tmp.fullPath(name));
-                });
-            }
-            else
-            {
-                m_pool->add([&f, this]()
-                {
-                    auto localHandle(
-                        m_arbiter->getLocalHandle(f.path(), m_tmp));
-
-                    add(localHandle->localPath(), f);
-                });
-            }
+            m_pool->add([this, &f]() { infer(f); });
         }
     }
 
     m_pool->join();
 
+    if (m_cache)
+    {
+        std::set<std::string> paths;
+        for (std::size_t i(0); i < size; ++i)
+        {
+            paths.insert(m_manifest.get(i).path());
+        }
+
+        m_cache->save(paths);
+    }
+
     if (!valid)
     {
         throw std::runtime_error("No point cloud files found");
@@ -183,34 +174,82 @@ void Inference::go()
     m_done = true;
 }
 
-void Inference::add(const std::string localPath, FileInfo& fileInfo)
+void Inference::infer(FileInfo& f)
+{
+    const std::string fingerprint(
+            m_cache ? m_cache->fingerprint(f.path()) : "");
+
+    if (m_cache)
+    {
+        if (auto entry = m_cache->get(f.path(), fingerprint, m_trustHeaders))
+        {
+            addDims(entry->dimNames);
+            f.numPoints(entry->numPoints);
+            f.bbox(entry->bbox);
+            return;
+        }
+    }
+
+    if (m_arbiter->isHttpDerived(f.path()))
+    {
+        arbiter::http::Headers range;
+        range["Range"] = "bytes=0-16384";
+
+        const auto data(m_arbiter->getBinary(f.path(), range));
+
+        std::string name(f.path());
+        std::replace(name.begin(), name.end(), '/', '-');
+        std::replace(name.begin(), name.end(), '\\', '-');
+
+        m_tmp.putSubpath(name, data);
+
+        add(m_tmp.fullPath(name), f, fingerprint);
+
+        arbiter::fs::remove(m_tmp.fullPath(name));
+    }
+    else
+    {
+        auto localHandle(m_arbiter->getLocalHandle(f.path(), m_tmp));
+        add(localHandle->localPath(), f, fingerprint);
+    }
+}
+
+void Inference::add(
+        const std::string localPath,
+        FileInfo& fileInfo,
+        const std::string& fingerprint)
 {
     std::unique_ptr<Preview> preview(m_executor.preview(localPath, m_reproj));
 
-    auto update([&fileInfo](std::size_t numPoints, const BBox& bbox)
+    auto update([this, &fileInfo, &fingerprint, &preview](
+                std::size_t numPoints,
+                const BBox& bbox,
+                bool exact)
     {
         fileInfo.numPoints(numPoints);
         fileInfo.bbox(bbox);
+
+        if (m_cache)
+        {
+            m_cache->set(
+                    fileInfo.path(),
+                    InferenceCache::Entry(
+                        fingerprint,
+                        numPoints,
+                        bbox,
+                        preview ? preview->srs : "",
+                        preview ? preview->dimNames : DimNames(),
+                        exact));
+        }
     });
 
     if (preview)
     {
-        {
-            std::lock_guard<std::mutex> lock(m_mutex);
-
-            for (const auto& d : preview->dimNames)
-            {
-                if (!m_dimSet.count(d))
-                {
-                    m_dimSet.insert(d);
-                    m_dimVec.push_back(d);
-                }
-            }
-        }
+        addDims(preview->dimNames);
 
         if (m_trustHeaders)
         {
-            update(preview->numPoints, preview->bbox);
+            update(preview->numPoints, preview->bbox, false);
             return;
         }
     }
@@ -237,7 +276,21 @@ void Inference::add(const std::string localPath, FileInfo& fileInfo)
 
     if (m_executor.run(table, localPath, m_reproj))
     {
-        update(curNumPoints, curBBox);
+        update(curNumPoints, curBBox, true);
+    }
+}
+
+void Inference::addDims(const std::vector<std::string>& dimNames)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (const auto& d : dimNames)
+    {
+        if (!m_dimSet.count(d))
+        {
+            m_dimSet.insert(d);
+            m_dimVec.push_back(d);
+        }
     }
 }
 
@@ -20,6 +20,7 @@
 #include <entwine/types/bbox.hpp>
 #include <entwine/types/schema.hpp>
 #include <entwine/util/executor.hpp>
+#include <entwine/util/inference-cache.hpp>
 #include <entwine/util/pool.hpp>
 
 namespace entwine
@@ -38,7 +39,8 @@ public:
             bool verbose = false,
             const Reprojection* reprojection = nullptr,
             bool trustHeaders = true,
-            arbiter::Arbiter* arbiter = nullptr);
+            arbiter::Arbiter* arbiter = nullptr,
+            std::string cachePath = "");
 
     Inference(
             const Manifest& manifest,
@@ -47,7 +49,8 @@ public:
             bool verbose = false,
             const Reprojection* reprojection = nullptr,
             bool trustHeaders = true,
-            arbiter::Arbiter* arbiter = nullptr);
+            arbiter::Arbiter* arbiter = nullptr,
+            std::string cachePath = "");
 
     void go();
     bool done() const { return m_done; }
@@ -65,7 +68,12 @@ public:
     const Reprojection* reprojection() const { return m_reproj; }
 
 private:
-    void add(std::string localPath, FileInfo& fileInfo);
+    void infer(FileInfo& fileInfo);
+    void add(
+            std::string localPath,
+            FileInfo& fileInfo,
+            const std::string& fingerprint);
+    void addDims(const std::vector<std::string>& dimNames);
 
     Executor m_executor;
     PointPool m_pointPool;
@@ -80,6 +88,7 @@ private:
     arbiter::Arbiter* m_arbiter;
     arbiter::Endpoint m_tmp;
     Manifest m_manifest;
+    std::unique_ptr<InferenceCache> m_cache;
     std::size_t m_index;
 
     std::vector<std::string> m_dimVec;
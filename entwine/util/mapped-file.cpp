@@ -0,0 +1,68 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/util/mapped-file.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace entwine
+{
+
+MappedFile::MappedFile(const char* data, const std::size_t size)
+    : m_data(data)
+    , m_size(size)
+{ }
+
+MappedFile::~MappedFile()
+{
+    munmap(const_cast<char*>(m_data), m_size);
+}
+
+std::unique_ptr<MappedFile> MappedFile::map(const std::string& path)
+{
+    std::unique_ptr<MappedFile> mapped;
+
+    const int fd(::open(path.c_str(), O_RDONLY));
+    if (fd == -1) return mapped;
+
+    struct stat info;
+
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        const std::size_t size(info.st_size);
+        void* data(mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0));
+
+        if (data != MAP_FAILED)
+        {
+            // Chunks are decompressed front to back.
+            madvise(data, size, MADV_SEQUENTIAL);
+            mapped.reset(new MappedFile(static_cast<const char*>(data), size));
+        }
+    }
+
+    // The mapping remains valid after the descriptor is closed.
+    ::close(fd);
+
+    return mapped;
+}
+
+std::unique_ptr<MappedFile> MappedFile::map(
+        const arbiter::Endpoint& endpoint,
+        const std::string& subpath)
+{
+    if (endpoint.isRemote()) return std::unique_ptr<MappedFile>();
+    return map(endpoint.fullPath(subpath));
+}
+
+} // namespace entwine
+
@@ -0,0 +1,52 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+
+namespace entwine
+{
+
+// A read-only memory mapping of an entire local file, so that its contents
+// may be read in place rather than copied into a buffer.
+class MappedFile
+{
+public:
+    ~MappedFile();
+
+    // Returns nullptr if the file cannot be opened or mapped.  An empty file
+    // cannot be mapped.
+    static std::unique_ptr<MappedFile> map(const std::string& path);
+
+    // Returns nullptr if _endpoint_ is remote, or as above.
+    static std::unique_ptr<MappedFile> map(
+            const arbiter::Endpoint& endpoint,
+            const std::string& subpath);
+
+    const char* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+
+private:
+    MappedFile(const char* data, std::size_t size);
+
+    const char* m_data;
+    const std::size_t m_size;
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+} // namespace entwine
+
@@ -0,0 +1,507 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/util/metrics.hpp>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace entwine
+{
+
+namespace
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    // Beyond this many unwritten trace events, new events are dropped.
+    const std::size_t maxEvents(1 << 20);
+
+    template<typename T>
+    struct Entry
+    {
+        Entry(std::string help, T* metric) : help(help), metric(metric) { }
+
+        std::string help;
+        std::unique_ptr<T> metric;
+    };
+
+    struct Registry
+    {
+        Registry()
+            : mutex()
+            , counters()
+            , gauges()
+            , histograms()
+            , tracing(false)
+            , eventMutex()
+            , events()
+            , origin(Clock::now())
+        { }
+
+        std::mutex mutex;
+        std::map<std::string, Entry<Counter>> counters;
+        std::map<std::string, Entry<Gauge>> gauges;
+        std::map<std::string, Entry<Histogram>> histograms;
+
+        std::atomic_bool tracing;
+        std::mutex eventMutex;
+        std::vector<Json::Value> events;
+        const Clock::time_point origin;
+    };
+
+    Registry& registry()
+    {
+        static Registry r;
+        return r;
+    }
+
+    template<typename T>
+    T& insert(
+            std::map<std::string, Entry<T>>& map,
+            const std::string& name,
+            const std::string& help,
+            std::function<T*()> create)
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+
+        auto it(map.find(name));
+        if (it == map.end())
+        {
+            it = map.insert(std::make_pair(name, Entry<T>(help, create())))
+                .first;
+        }
+
+        return *it->second.metric;
+    }
+
+    std::string format(const double d)
+    {
+        std::ostringstream ss;
+        ss << d;
+        return ss.str();
+    }
+
+    std::size_t micros(const Clock::time_point t)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                t - registry().origin).count();
+    }
+
+    bool endsWith(const std::string& s, const std::string& end)
+    {
+        return
+            s.size() >= end.size() &&
+            s.compare(s.size() - end.size(), end.size(), end) == 0;
+    }
+}
+
+Histogram::Histogram(std::vector<double> bounds)
+    : m_bounds(bounds)
+    , m_counts(new std::atomic_size_t[bounds.size() + 1])
+    , m_count(0)
+    , m_sum(0)
+{
+    if (!std::is_sorted(m_bounds.begin(), m_bounds.end()))
+    {
+        throw std::runtime_error("Histogram bounds must be sorted");
+    }
+
+    for (std::size_t i(0); i <= m_bounds.size(); ++i) m_counts[i].store(0);
+}
+
+void Histogram::observe(const double value)
+{
+    const std::size_t bucket(
+            std::lower_bound(m_bounds.begin(), m_bounds.end(), value) -
+            m_bounds.begin());
+
+    m_counts[bucket].fetch_add(1);
+    m_count.fetch_add(1);
+
+    double sum(m_sum.load());
+    while (!m_sum.compare_exchange_weak(sum, sum + value))
+        ;
+}
+
+std::vector<std::size_t> Histogram::counts() const
+{
+    std::vector<std::size_t> results;
+
+    for (std::size_t i(0); i <= m_bounds.size(); ++i)
+    {
+        results.push_back(m_counts[i].load());
+    }
+
+    return results;
+}
+
+Json::Value Histogram::toJson() const
+{
+    const std::vector<std::size_t> buckets(counts());
+
+    Json::Value json;
+    json["count"] = static_cast<Json::UInt64>(count());
+    json["sum"] = sum();
+
+    std::size_t cumulative(0);
+
+    for (std::size_t i(0); i < buckets.size(); ++i)
+    {
+        cumulative += buckets[i];
+
+        Json::Value bucket;
+        if (i < m_bounds.size()) bucket["le"] = m_bounds[i];
+        else bucket["le"] = "+Inf";
+        bucket["count"] = static_cast<Json::UInt64>(cumulative);
+
+        json["buckets"].append(bucket);
+    }
+
+    return json;
+}
+
+std::vector<double> Histogram::seconds()
+{
+    return std::vector<double> {
+        0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+        0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60
+    };
+}
+
+std::vector<double> Histogram::exponential(
+        const double start,
+        const double factor,
+        const std::size_t count)
+{
+    std::vector<double> bounds;
+    double bound(start);
+
+    for (std::size_t i(0); i < count; ++i)
+    {
+        bounds.push_back(bound);
+        bound *= factor;
+    }
+
+    return bounds;
+}
+
+Counter& Metrics::counter(const std::string& name, const std::string& help)
+{
+    return insert<Counter>(
+            registry().counters,
+            name,
+            help,
+            []() { return new Counter(); });
+}
+
+Gauge& Metrics::gauge(const std::string& name, const std::string& help)
+{
+    return insert<Gauge>(
+            registry().gauges,
+            name,
+            help,
+            []() { return new Gauge(); });
+}
+
+Gauge& Metrics::gauge(
+        const std::string& name,
+        const std::string& help,
+        std::function<double()> source)
+{
+    return insert<Gauge>(
+            registry().gauges,
+            name,
+            help,
+            [source]() { return new Gauge(source); });
+}
+
+Histogram& Metrics::histogram(
+        const std::string& name,
+        const std::string& help,
+        std::vector<double> bounds)
+{
+    return insert<Histogram>(
+            registry().histograms,
+            name,
+            help,
+            [&bounds]() { return new Histogram(bounds); });
+}
+
+Json::Value Metrics::toJson()
+{
+    Registry& r(registry());
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    Json::Value json;
+
+    for (const auto& p : r.counters)
+    {
+        json["counters"][p.first] =
+            static_cast<Json::UInt64>(p.second.metric->value());
+    }
+
+    for (const auto& p : r.gauges)
+    {
+        json["gauges"][p.first] = p.second.metric->value();
+    }
+
+    for (const auto& p : r.histograms)
+    {
+        json["histograms"][p.first] = p.second.metric->toJson();
+    }
+
+    return json;
+}
+
+std::string Metrics::toPrometheus()
+{
+    Registry& r(registry());
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    std::ostringstream ss;
+
+    auto header([&ss](
+                const std::string& name,
+                const std::string& help,
+                const std::string& type)
+    {
+        ss << "# HELP " << name << " " << help << "\n";
+        ss << "# TYPE " << name << " " << type << "\n";
+    });
+
+    for (const auto& p : r.counters)
+    {
+        header(p.first, p.second.help, "counter");
+        ss << p.first << " " << p.second.metric->value() << "\n";
+    }
+
+    for (const auto& p : r.gauges)
+    {
+        header(p.first, p.second.help, "gauge");
+        ss << p.first << " " << format(p.second.metric->value()) << "\n";
+    }
+
+    for (const auto& p : r.histograms)
+    {
+        const Histogram& h(*p.second.metric);
+        const std::vector<std::size_t> counts(h.counts());
+
+        header(p.first, p.second.help, "histogram");
+
+        std::size_t cumulative(0);
+
+        for (std::size_t i(0); i < counts.size(); ++i)
+        {
+            cumulative += counts[i];
+
+            const std::string le(
+                    i < h.bounds().size() ? format(h.bounds()[i]) : "+Inf");
+
+            ss << p.first << "_bucket{le=\"" << le << "\"} " <<
+                cumulative << "\n";
+        }
+
+        ss << p.first << "_sum " << format(h.sum()) << "\n";
+        ss << p.first << "_count " << h.count() << "\n";
+    }
+
+    return ss.str();
+}
+
+void Metrics::trace(const bool enable)
+{
+    registry().tracing.store(enable);
+}
+
+bool Metrics::tracing()
+{
+    return registry().tracing.load();
+}
+
+std::vector<Json::Value> Metrics::takeTrace()
+{
+    Registry& r(registry());
+    std::lock_guard<std::mutex> lock(r.eventMutex);
+
+    std::vector<Json::Value> events;
+    events.swap(r.events);
+    return events;
+}
+
+void Metrics::addEvent(Json::Value event)
+{
+    Registry& r(registry());
+    std::lock_guard<std::mutex> lock(r.eventMutex);
+
+    if (r.events.size() < maxEvents) r.events.push_back(event);
+}
+
+Span::Span(Histogram& histogram, const char* name)
+    : m_histogram(histogram)
+    , m_name(name)
+    , m_start(Clock::now())
+    , m_stopped(false)
+{ }
+
+Span::~Span()
+{
+    stop();
+}
+
+void Span::stop()
+{
+    if (m_stopped) return;
+    m_stopped = true;
+
+    const auto end(Clock::now());
+    m_histogram.observe(std::chrono::duration<double>(end - m_start).count());
+
+    if (Metrics::tracing())
+    {
+        const std::size_t begin(micros(m_start));
+
+        Json::Value event;
+        event["name"] = m_name;
+        event["ph"] = "X";
+        event["ts"] = static_cast<Json::UInt64>(begin);
+        event["dur"] = static_cast<Json::UInt64>(micros(end) - begin);
+        event["pid"] = static_cast<Json::UInt64>(getpid());
+        event["tid"] = static_cast<Json::UInt64>(
+                std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+        Metrics::addEvent(event);
+    }
+}
+
+MetricsWriter::MetricsWriter(
+        const std::string path,
+        const std::size_t intervalSeconds)
+    : m_path(path)
+    , m_interval(std::max<std::size_t>(intervalSeconds, 1))
+    , m_last()
+    , m_lastTime(Clock::now())
+    , m_traceStarted(false)
+    , m_stop(false)
+    , m_mutex()
+    , m_cv()
+    , m_thread()
+{
+    m_thread = std::thread([this]()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        while (!m_cv.wait_for(lock, m_interval, [this]() { return m_stop; }))
+        {
+            try
+            {
+                write();
+            }
+            catch (std::exception& e)
+            {
+                std::cout << "Could not write metrics: " << e.what() <<
+                    std::endl;
+            }
+        }
+    });
+}
+
+MetricsWriter::~MetricsWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_cv.notify_all();
+    m_thread.join();
+
+    try
+    {
+        write();
+    }
+    catch (std::exception& e)
+    {
+        std::cout << "Could not write metrics: " << e.what() << std::endl;
+    }
+}
+
+void MetricsWriter::write()
+{
+    std::string data;
+
+    if (endsWith(m_path, ".prom"))
+    {
+        data = Metrics::toPrometheus();
+    }
+    else
+    {
+        Json::Value json(Metrics::toJson());
+
+        const auto now(Clock::now());
+        const double elapsed(
+                std::chrono::duration<double>(now - m_lastTime).count());
+
+        for (const std::string& name : json["counters"].getMemberNames())
+        {
+            const std::size_t value(json["counters"][name].asUInt64());
+            const std::size_t last(m_last.count(name) ? m_last[name] : 0);
+
+            json["rates"][name] = elapsed > 0 ? (value - last) / elapsed : 0;
+            m_last[name] = value;
+        }
+
+        m_lastTime = now;
+        data = json.toStyledString();
+    }
+
+    const std::string tmp(m_path + ".tmp");
+
+    {
+        std::ofstream file(tmp, std::ofstream::out | std::ofstream::trunc);
+        file << data;
+        if (!file.good()) throw std::runtime_error("Could not write " + tmp);
+    }
+
+    if (std::rename(tmp.c_str(), m_path.c_str()) != 0)
+    {
+        throw std::runtime_error("Could not rename " + tmp);
+    }
+
+    const std::vector<Json::Value> events(Metrics::takeTrace());
+
+    if (!events.empty() || (Metrics::tracing() && !m_traceStarted))
+    {
+        // The trace-event format permits an unterminated array, so events
+        // may be appended indefinitely.
+        Json::FastWriter writer;
+        std::ofstream file(
+                m_path + ".trace",
+                m_traceStarted ? std::ofstream::app : std::ofstream::trunc);
+
+        if (!m_traceStarted) file << "[\n";
+        m_traceStarted = true;
+
+        for (const Json::Value& event : events)
+        {
+            std::string line(writer.write(event));
+            if (!line.empty() && line.back() == '\n') line.pop_back();
+            file << line << ",\n";
+        }
+    }
+}
+
+} // namespace entwine
+
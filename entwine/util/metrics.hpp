@@ -0,0 +1,191 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <entwine/third/json/json.hpp>
+
+namespace entwine
+{
+
+// A monotonically increasing count.
+class Counter
+{
+public:
+    Counter() : m_value(0) { }
+
+    void add(std::size_t n = 1) { m_value.fetch_add(n); }
+    std::size_t value() const { return m_value.load(); }
+
+private:
+    std::atomic_size_t m_value;
+};
+
+// A value that may rise and fall.  If constructed with a source function,
+// the value is sampled from it when read.
+class Gauge
+{
+public:
+    Gauge() : m_value(0), m_source() { }
+    explicit Gauge(std::function<double()> source)
+        : m_value(0)
+        , m_source(source)
+    { }
+
+    void set(int64_t value) { m_value.store(value); }
+    void add(int64_t n) { m_value.fetch_add(n); }
+
+    double value() const { return m_source ? m_source() : m_value.load(); }
+
+private:
+    std::atomic<int64_t> m_value;
+    const std::function<double()> m_source;
+};
+
+// A distribution of observed values over fixed buckets, each bucket counting
+// the observations less than or equal to its upper bound.
+class Histogram
+{
+public:
+    explicit Histogram(std::vector<double> bounds);
+
+    void observe(double value);
+
+    // Upper bounds in increasing order, excluding the implicit infinity.
+    const std::vector<double>& bounds() const { return m_bounds; }
+
+    // Non-cumulative counts per bucket, with one more entry than bounds().
+    std::vector<std::size_t> counts() const;
+
+    std::size_t count() const { return m_count.load(); }
+    double sum() const { return m_sum.load(); }
+
+    // The count, sum, and cumulative bucket counts.
+    Json::Value toJson() const;
+
+    // Latency buckets in seconds, from one millisecond to one minute.
+    static std::vector<double> seconds();
+
+    // The bounds _start_, _start_ * _factor_, ..., for _count_ buckets.
+    static std::vector<double> exponential(
+            double start,
+            double factor,
+            std::size_t count);
+
+private:
+    const std::vector<double> m_bounds;
+    std::unique_ptr<std::atomic_size_t[]> m_counts;
+    std::atomic_size_t m_count;
+    std::atomic<double> m_sum;
+};
+
+// A process-wide registry of named metrics.  Registration returns a
+// reference that remains valid for the life of the process, so hot paths
+// should look up their metrics once and hold on to them, for example in a
+// function-local static.  Registering an existing name returns the existing
+// metric.
+class Metrics
+{
+public:
+    static Counter& counter(const std::string& name, const std::string& help);
+    static Gauge& gauge(const std::string& name, const std::string& help);
+    static Gauge& gauge(
+            const std::string& name,
+            const std::string& help,
+            std::function<double()> source);
+    static Histogram& histogram(
+            const std::string& name,
+            const std::string& help,
+            std::vector<double> bounds = Histogram::seconds());
+
+    static Json::Value toJson();
+
+    // The Prometheus text exposition format.
+    static std::string toPrometheus();
+
+    // While tracing is enabled, completed Spans are also recorded as
+    // individual events, which are retrieved and cleared by takeTrace().
+    static void trace(bool enable);
+    static bool tracing();
+
+    // Events in the Chrome trace-event format, one JSON object per entry.
+    static std::vector<Json::Value> takeTrace();
+
+    static void addEvent(Json::Value event);
+};
+
+// Time a scope, observing its duration in seconds into _histogram_.  When
+// tracing is enabled, the span is also recorded as a named trace event.
+class Span
+{
+public:
+    Span(Histogram& histogram, const char* name);
+    ~Span();
+
+    // Record the span now rather than on destruction.
+    void stop();
+
+private:
+    Histogram& m_histogram;
+    const char* const m_name;
+    const std::chrono::high_resolution_clock::time_point m_start;
+    bool m_stopped;
+
+    Span(const Span&);
+    Span& operator=(const Span&);
+};
+
+// Periodically write all metrics to _path_ from a background thread, as
+// Prometheus text if the path ends in ".prom" or as JSON otherwise.  JSON
+// output also includes the per-second rate of each counter since the
+// previous write.  If tracing, events are appended to _path_ + ".trace".
+//
+// Files are written to a temporary path and renamed into place, so readers
+// never observe a partial write.  A final write is made on destruction.
+class MetricsWriter
+{
+public:
+    MetricsWriter(std::string path, std::size_t intervalSeconds);
+    ~MetricsWriter();
+
+private:
+    void write();
+
+    const std::string m_path;
+    const std::chrono::seconds m_interval;
+
+    std::map<std::string, std::size_t> m_last;
+    std::chrono::high_resolution_clock::time_point m_lastTime;
+    bool m_traceStarted;
+
+    bool m_stop;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::thread m_thread;
+
+    MetricsWriter(const MetricsWriter&);
+    MetricsWriter& operator=(const MetricsWriter&);
+};
+
+} // namespace entwine
+
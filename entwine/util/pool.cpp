@@ -10,22 +10,53 @@
 
 #include <entwine/util/pool.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 
+#include <entwine/util/metrics.hpp>
+
 namespace entwine
 {
 
-Pool::Pool(const std::size_t numThreads, const std::size_t queueSize)
+Pool::Pool(
+        const std::size_t numThreads,
+        const std::size_t queueSize,
+        const std::string name)
     : m_numThreads(numThreads)
     , m_queueSize(std::min(queueSize, std::size_t(1)))
+    , m_limit(numThreads)
+    , m_running(0)
+    , m_blocked(0)
     , m_threads()
     , m_tasks()
     , m_stop(true)
     , m_mutex()
     , m_produceCv()
     , m_consumeCv()
+    , m_threadsGauge(nullptr)
+    , m_busyGauge(nullptr)
+    , m_queuedGauge(nullptr)
+    , m_tasksCounter(nullptr)
 {
+    if (!name.empty())
+    {
+        const std::string prefix("entwine_" + name + "_pool_");
+
+        m_threadsGauge = &Metrics::gauge(
+                prefix + "threads",
+                "Worker threads of running " + name + " pools");
+        m_busyGauge = &Metrics::gauge(
+                prefix + "busy",
+                "Threads running a task in " + name + " pools");
+        m_queuedGauge = &Metrics::gauge(
+                prefix + "queued",
+                "Tasks waiting for a thread in " + name + " pools");
+        m_tasksCounter = &Metrics::counter(
+                prefix + "tasks_total",
+                "Tasks completed by " + name + " pools");
+    }
+
     go();
 }
 
@@ -50,6 +81,8 @@ void Pool::go()
     {
         m_threads.emplace_back([this]() { work(); });
     }
+
+    if (m_threadsGauge) m_threadsGauge->add(m_limit);
 }
 
 void Pool::join()
@@ -67,7 +100,33 @@ void Pool::join()
         std::lock_guard<std::mutex> lock(m_mutex);
         m_threads.clear();
         assert(m_tasks.empty());
+
+        if (m_threadsGauge) m_threadsGauge->add(-int64_t(m_limit));
+    }
+}
+
+void Pool::limit(std::size_t limit)
+{
+    limit = std::max<std::size_t>(std::min(limit, m_numThreads), 1);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_threadsGauge && !stop())
+        {
+            m_threadsGauge->add(int64_t(limit) - int64_t(m_limit));
+        }
+
+        m_limit = limit;
     }
+
+    m_consumeCv.notify_all();
+}
+
+std::size_t Pool::queued() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_tasks.size();
 }
 
 void Pool::add(std::function<void()> task)
@@ -84,8 +143,12 @@ void Pool::add(std::function<void()> task)
 
     std::unique_lock<std::mutex> lock(m_mutex);
 
+    ++m_blocked;
     m_produceCv.wait(lock, [this]() { return m_tasks.size() < m_queueSize; });
+    --m_blocked;
+
     m_tasks.emplace(task);
+    if (m_queuedGauge) m_queuedGauge->add(1);
 
     lock.unlock();
 
@@ -97,14 +160,30 @@ void Pool::work()
 {
     std::unique_lock<std::mutex> lock(m_mutex);
 
+    // A task may be started only while fewer than m_limit are running.
+    auto ready([this]()
+    {
+        return !m_tasks.empty() && m_running < m_limit;
+    });
+
     while (!stop() || !m_tasks.empty())
     {
-        m_consumeCv.wait(lock, [this]() { return !m_tasks.empty() || stop(); });
+        m_consumeCv.wait(lock, [this, &ready]()
+        {
+            return ready() || (stop() && m_tasks.empty());
+        });
 
-        if (!m_tasks.empty())
+        if (ready())
         {
             auto task(std::move(m_tasks.front()));
             m_tasks.pop();
+            ++m_running;
+
+            if (m_queuedGauge)
+            {
+                m_queuedGauge->add(-1);
+                m_busyGauge->add(1);
+            }
 
             lock.unlock();
 
@@ -126,7 +205,17 @@ void Pool::work()
                     "Unknown exception caught in pool task." << std::endl;
             }
 
+            if (m_busyGauge)
+            {
+                m_busyGauge->add(-1);
+                m_tasksCounter->add();
+            }
+
             lock.lock();
+            --m_running;
+
+            // A worker held back by the limit may now start a task.
+            if (m_limit < m_numThreads) m_consumeCv.notify_one();
         }
     }
 }
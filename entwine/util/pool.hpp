@@ -16,12 +16,16 @@
 #include <functional>
 #include <mutex>
 #include <queue>
+#include <string>
 #include <thread>
 #include <vector>
 
 namespace entwine
 {
 
+class Counter;
+class Gauge;
+
 class Pool
 {
 public:
@@ -29,7 +33,13 @@ public:
     // been enqueued to wait for an available worker thread, subsequent calls
     // to Pool::add will block until an enqueued task has been popped from the
     // queue.
-    Pool(std::size_t numThreads, std::size_t queueSize = 1);
+    //
+    // If _name_ is given, the pool reports its thread limit, busy threads,
+    // queued tasks, and completed tasks as metrics named with that prefix.
+    Pool(
+            std::size_t numThreads,
+            std::size_t queueSize = 1,
+            std::string name = "");
     ~Pool();
 
     // Start worker threads
@@ -47,6 +57,18 @@ public:
 
     std::size_t numThreads() const { return m_numThreads; }
 
+    // Allow at most _limit_ tasks to run concurrently, clamped to between one
+    // and numThreads().  Running tasks are not interrupted, so lowering the
+    // limit takes effect as they complete.  Initially numThreads().
+    void limit(std::size_t limit);
+    std::size_t limit() const { return m_limit.load(); }
+
+    // Tasks currently running, tasks waiting in the queue, and callers of
+    // add() blocked waiting for space in the queue.
+    std::size_t running() const { return m_running.load(); }
+    std::size_t queued() const;
+    std::size_t blocked() const { return m_blocked.load(); }
+
 private:
     // Worker thread function.  Wait for a task and run it - or if stop() is
     // called, complete any outstanding task and return.
@@ -58,6 +80,9 @@ private:
 
     std::size_t m_numThreads;
     std::size_t m_queueSize;
+    std::atomic_size_t m_limit;
+    std::atomic_size_t m_running;
+    std::atomic_size_t m_blocked;
     std::vector<std::thread> m_threads;
     std::queue<std::function<void()>> m_tasks;
 
@@ -65,10 +90,15 @@ private:
     std::mutex m_errorMutex;
 
     std::atomic<bool> m_stop;
-    std::mutex m_mutex;
+    mutable std::mutex m_mutex;
     std::condition_variable m_produceCv;
     std::condition_variable m_consumeCv;
 
+    Gauge* m_threadsGauge;
+    Gauge* m_busyGauge;
+    Gauge* m_queuedGauge;
+    Counter* m_tasksCounter;
+
     // Disable copy/assignment.
     Pool(const Pool& other);
     Pool& operator=(const Pool& other);
@@ -8,102 +8,599 @@
 *
 ******************************************************************************/
 
+#include <entwine/util/storage.hpp>
+
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <condition_variable>
 #include <iostream>
+#include <map>
 #include <mutex>
+#include <random>
 #include <thread>
 
 #include <entwine/third/arbiter/arbiter.hpp>
 #include <entwine/tree/chunk.hpp>
-#include <entwine/util/storage.hpp>
+#include <entwine/util/metrics.hpp>
+
+namespace entwine
+{
 
 namespace
 {
-    const std::size_t retries(40);
-    std::mutex mutex;
+    typedef std::chrono::steady_clock Clock;
+
+    const double baseBackoffSeconds(0.5);
+    const double maxBackoffSeconds(30);
+
+    Counter& retried(
+            Metrics::counter(
+                "entwine_storage_retries_total",
+                "Failed storage requests which were retried"));
+
+    Counter& hedged(
+            Metrics::counter(
+                "entwine_storage_hedges_total",
+                "Slow storage reads raced against a duplicate request"));
+
+    Counter& failed(
+            Metrics::counter(
+                "entwine_storage_failures_total",
+                "Storage requests abandoned after exhausting retries"));
+
+    Gauge& outstanding(
+            Metrics::gauge(
+                "entwine_storage_requests_outstanding",
+                "Storage requests queued, running, or awaiting a retry"));
 
-    void sleep(std::size_t tried, std::string method, std::string path)
+    Histogram& putTime(
+            Metrics::histogram(
+                "entwine_storage_put_seconds",
+                "Time to write a file to storage, including retries"));
+
+    Histogram& getTime(
+            Metrics::histogram(
+                "entwine_storage_get_seconds",
+                "Time to read a file from storage, including retries"));
+
+    // A single request, which may be attempted many times and, if hedged,
+    // by more than one thread at once.
+    class Operation
     {
-        std::this_thread::sleep_for(std::chrono::seconds(tried));
+    public:
+        Operation(
+                const arbiter::Endpoint& endpoint,
+                const std::string& path,
+                std::size_t retries)
+            : endpoint(endpoint)
+            , path(path)
+            , retries(retries)
+            , start(Clock::now())
+            , tried(0)
+            , running(0)
+            , complete(false)
+            , done(false)
+        { }
 
-        std::lock_guard<std::mutex> lock(mutex);
-        std::cout <<
-            "\tFailed " << method << " attempt " << tried << ": " << path <<
-            std::endl;
-    }
+        virtual ~Operation() { }
+
+        // Make one attempt, returning false or throwing if it failed.  The
+        // first successful attempt fulfills the request.
+        virtual bool attempt() = 0;
+
+        virtual void fail(const std::string& message) = 0;
+
+        virtual std::string method() const = 0;
+        virtual bool hedgeable() const = 0;
+        virtual Histogram& histogram() const = 0;
+
+        const arbiter::Endpoint endpoint;
+        const std::string path;
+        const std::size_t retries;
+        const Clock::time_point start;
+
+        // Guarded by the Service mutex.
+        std::size_t tried;
+        std::size_t running;
+        bool complete;
+
+    protected:
+        // True once the promise has been satisfied.
+        bool claim() { return !done.exchange(true); }
+
+    private:
+        std::atomic_bool done;
+    };
 
-    void suicide(std::string method)
+    class Put : public Operation
     {
-        std::lock_guard<std::mutex> lock(mutex);
-        std::cout <<
-            "\tFailed to " << method << " data: persistent failure.\n" <<
-            "\tThis is a non-recoverable error - Abandoning index." <<
-            std::endl;
+    public:
+        Put(
+                const arbiter::Endpoint& endpoint,
+                const std::string& path,
+                std::size_t retries,
+                std::shared_ptr<const std::vector<char>> data)
+            : Operation(endpoint, path, retries)
+            , m_data(data)
+            , m_promise()
+        { }
 
-        exit(1);
-    }
-}
+        std::future<void> future() { return m_promise.get_future(); }
 
-namespace entwine
-{
+        virtual bool attempt() override
+        {
+            endpoint.putSubpath(path, *m_data);
+            if (claim()) m_promise.set_value();
+            return true;
+        }
 
-void Storage::ensurePut(
-        const arbiter::Endpoint& endpoint,
-        const std::string& path,
-        const std::vector<char>& data)
-{
-    bool done(false);
-    std::size_t tried(0);
+        virtual void fail(const std::string& message) override
+        {
+            if (claim())
+            {
+                m_promise.set_exception(
+                        std::make_exception_ptr(StorageError(message)));
+            }
+        }
+
+        virtual std::string method() const override { return "PUT"; }
+        virtual bool hedgeable() const override { return false; }
+        virtual Histogram& histogram() const override { return putTime; }
+
+    private:
+        std::shared_ptr<const std::vector<char>> m_data;
+        std::promise<void> m_promise;
+    };
+
+    // Reads some or all of a file from an endpoint and path.
+    typedef std::function<
+        Storage::Data(const arbiter::Endpoint&, const std::string&)> Read;
+
+    class Get : public Operation
+    {
+    public:
+        Get(
+                const arbiter::Endpoint& endpoint,
+                const std::string& path,
+                std::size_t retries,
+                Read read)
+            : Operation(endpoint, path, retries)
+            , m_read(read)
+            , m_promise()
+        { }
+
+        std::future<Storage::Data> future() { return m_promise.get_future(); }
+
+        virtual bool attempt() override
+        {
+            Storage::Data data(m_read(endpoint, path));
+            if (!data) return false;
+
+            if (claim()) m_promise.set_value(std::move(data));
+            return true;
+        }
+
+        virtual void fail(const std::string& message) override
+        {
+            if (claim())
+            {
+                m_promise.set_exception(
+                        std::make_exception_ptr(StorageError(message)));
+            }
+        }
 
-    if (data.empty())
+        virtual std::string method() const override { return "GET"; }
+        virtual bool hedgeable() const override { return true; }
+        virtual Histogram& histogram() const override { return getTime; }
+
+    private:
+        const Read m_read;
+        std::promise<Storage::Data> m_promise;
+    };
+
+    class Service
     {
-        throw std::runtime_error("Tried to save empty chunk");
+    public:
+        explicit Service(const Json::Value& json)
+            : m_concurrency(json.get("concurrency", 8).asUInt64())
+            , m_maxOutstanding(json.get("outstanding", 64).asUInt64())
+            , m_retries(json.get("retries", 40).asUInt64())
+            , m_hedge(json.get("hedge", 2.0).asDouble())
+            , m_queue()
+            , m_inFlight()
+            , m_outstanding(0)
+            , m_random(std::random_device()())
+            , m_stop(false)
+            , m_mutex()
+            , m_consumeCv()
+            , m_produceCv()
+            , m_threads()
+        {
+            const std::size_t threads(json.get("threads", 8).asUInt64());
+
+            if (!threads || !m_concurrency || !m_maxOutstanding || !m_retries)
+            {
+                throw std::runtime_error("Invalid storage configuration");
+            }
+
+            for (std::size_t i(0); i < threads; ++i)
+            {
+                m_threads.emplace_back([this]() { work(); });
+            }
+        }
+
+        ~Service()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+
+            m_consumeCv.notify_all();
+            for (auto& t : m_threads) t.join();
+        }
+
+        std::size_t retries() const { return m_retries; }
+
+        void submit(std::shared_ptr<Operation> op)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_produceCv.wait(lock, [this]()
+            {
+                return m_outstanding < m_maxOutstanding;
+            });
+
+            outstanding.set(++m_outstanding);
+            schedule(op, Clock::now(), false);
+
+            lock.unlock();
+            m_consumeCv.notify_one();
+        }
+
+    private:
+        struct Entry
+        {
+            Entry(std::shared_ptr<Operation> op, bool hedge)
+                : op(op)
+                , hedge(hedge)
+            { }
+
+            std::shared_ptr<Operation> op;
+            bool hedge;
+        };
+
+        typedef std::multimap<Clock::time_point, Entry> Queue;
+
+        void schedule(
+                std::shared_ptr<Operation> op,
+                Clock::time_point when,
+                bool hedge)
+        {
+            m_queue.insert(std::make_pair(when, Entry(op, hedge)));
+        }
+
+        // The first due entry whose endpoint has capacity, discarding any
+        // hedges that are no longer needed.
+        Queue::iterator next(const Clock::time_point now)
+        {
+            auto it(m_queue.begin());
+
+            while (it != m_queue.end() && it->first <= now)
+            {
+                const Operation& op(*it->second.op);
+
+                if (it->second.hedge && (op.complete || !op.running))
+                {
+                    it = m_queue.erase(it);
+                }
+                else if (m_inFlight[op.endpoint.root()] < m_concurrency)
+                {
+                    return it;
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+
+            return m_queue.end();
+        }
+
+        void work()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            while (!m_stop)
+            {
+                const Clock::time_point now(Clock::now());
+                auto it(next(now));
+
+                if (it == m_queue.end())
+                {
+                    if (m_queue.empty() || m_queue.begin()->first <= now)
+                    {
+                        m_consumeCv.wait(lock);
+                    }
+                    else
+                    {
+                        m_consumeCv.wait_until(lock, m_queue.begin()->first);
+                    }
+
+                    continue;
+                }
+
+                std::shared_ptr<Operation> op(it->second.op);
+                const bool hedge(it->second.hedge);
+                m_queue.erase(it);
+
+                if (hedge) hedged.add();
+                else if (op->hedgeable() && m_hedge > 0)
+                {
+                    schedule(
+                            op,
+                            now + std::chrono::duration_cast<Clock::duration>(
+                                std::chrono::duration<double>(m_hedge)),
+                            true);
+                }
+
+                const std::string root(op->endpoint.root());
+                ++m_inFlight[root];
+                ++op->running;
+
+                lock.unlock();
+
+                bool success(false);
+                std::string error("not found");
+
+                try
+                {
+                    success = op->attempt();
+                }
+                catch (std::exception& e)
+                {
+                    error = e.what();
+                }
+                catch (...)
+                {
+                    error = "unknown error";
+                }
+
+                lock.lock();
+
+                --m_inFlight[root];
+                --op->running;
+
+                if (success) finish(*op);
+                else if (!op->complete && !op->running) retry(op, error);
+
+                m_consumeCv.notify_all();
+            }
+        }
+
+        void finish(Operation& op)
+        {
+            if (op.complete) return;
+            op.complete = true;
+
+            op.histogram().observe(
+                    std::chrono::duration<double>(
+                        Clock::now() - op.start).count());
+
+            outstanding.set(--m_outstanding);
+            m_produceCv.notify_all();
+        }
+
+        void retry(std::shared_ptr<Operation> op, const std::string& error)
+        {
+            if (++op->tried < op->retries)
+            {
+                retried.add();
+
+                std::cout <<
+                    "\tFailed " << op->method() << " attempt " << op->tried <<
+                    ": " << op->path << " - " << error << std::endl;
+
+                schedule(op, Clock::now() + backoff(op->tried), false);
+            }
+            else
+            {
+                failed.add();
+                finish(*op);
+
+                op->fail(
+                        "Failed to " + op->method() + " " + op->path +
+                        " after " + std::to_string(op->tried) +
+                        " attempts: " + error);
+            }
+        }
+
+        // Full-range jitter over the upper half of an exponentially growing
+        // delay, so that many concurrent failures do not retry in lockstep.
+        Clock::duration backoff(const std::size_t tried)
+        {
+            const double ceiling(
+                    std::min(
+                        maxBackoffSeconds,
+                        baseBackoffSeconds * std::pow(2.0, tried - 1)));
+
+            std::uniform_real_distribution<double> jitter(0.5, 1.0);
+
+            return std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(ceiling * jitter(m_random)));
+        }
+
+        const std::size_t m_concurrency;
+        const std::size_t m_maxOutstanding;
+        const std::size_t m_retries;
+        const double m_hedge;
+
+        Queue m_queue;
+        std::map<std::string, std::size_t> m_inFlight;
+        std::size_t m_outstanding;
+        std::mt19937 m_random;
+
+        bool m_stop;
+        std::mutex m_mutex;
+        std::condition_variable m_consumeCv;
+        std::condition_variable m_produceCv;
+        std::vector<std::thread> m_threads;
+    };
+
+    std::mutex configMutex;
+    Json::Value config;
+    bool started(false);
+
+    Json::Value start()
+    {
+        std::lock_guard<std::mutex> lock(configMutex);
+        started = true;
+        return config;
     }
-    else if (data.back() != Chunk::Contiguous && data.back() != Chunk::Sparse)
+
+    Service& service()
     {
-        throw std::runtime_error("Tried to save improperly marked chunk");
+        static Service s(start());
+        return s;
     }
 
-    while (!done)
+    void validate(const std::vector<char>& data)
     {
-        try
+        if (data.empty())
         {
-            endpoint.putSubpath(path, data);
-            done = true;
+            throw std::runtime_error("Tried to save empty chunk");
         }
-        catch (...)
+        else if (
+                data.back() != Chunk::Contiguous &&
+                data.back() != Chunk::Sparse)
         {
-            if (++tried < retries) sleep(tried, "PUT", path);
-            else suicide("PUT");
+            throw std::runtime_error("Tried to save improperly marked chunk");
         }
     }
 }
 
-std::unique_ptr<std::vector<char>> Storage::ensureGet(
+void Storage::configure(const Json::Value& json)
+{
+    std::lock_guard<std::mutex> lock(configMutex);
+
+    if (started)
+    {
+        throw std::runtime_error("Storage configured after first use");
+    }
+
+    config = json;
+}
+
+std::future<void> Storage::put(
         const arbiter::Endpoint& endpoint,
-        const std::string& path)
+        const std::string& path,
+        Data data)
 {
-    std::unique_ptr<std::vector<char>> data;
+    validate(*data);
 
-    bool done(false);
-    std::size_t tried(0);
+    Service& s(service());
+    std::shared_ptr<Put> op(
+            new Put(endpoint, path, s.retries(), std::move(data)));
 
-    while (!done)
-    {
-        data = endpoint.tryGetSubpathBinary(path);
+    std::future<void> future(op->future());
+    s.submit(op);
+    return future;
+}
 
-        if (data)
-        {
-            done = true;
-        }
-        else
-        {
-            if (++tried < retries) sleep(tried, "GET", path);
-            else suicide("GET");
-        }
-    }
+std::future<Storage::Data> Storage::get(
+        const arbiter::Endpoint& endpoint,
+        const std::string& path,
+        const std::size_t retries)
+{
+    return get(
+            endpoint,
+            path,
+            retries,
+            [](const arbiter::Endpoint& endpoint, const std::string& path)
+            {
+                return endpoint.tryGetSubpathBinary(path);
+            });
+}
+
+std::future<Storage::Data> Storage::getRange(
+        const arbiter::Endpoint& endpoint,
+        const std::string& path,
+        const std::size_t begin,
+        const std::size_t end,
+        const std::size_t retries)
+{
+    return get(
+            endpoint,
+            path,
+            retries,
+            [begin, end](
+                const arbiter::Endpoint& endpoint,
+                const std::string& path)
+            {
+                return endpoint.tryGetSubpathBinaryRange(path, begin, end);
+            });
+}
+
+std::future<Storage::Data> Storage::getSuffix(
+        const arbiter::Endpoint& endpoint,
+        const std::string& path,
+        const std::size_t size,
+        const std::size_t retries)
+{
+    return get(
+            endpoint,
+            path,
+            retries,
+            [size](const arbiter::Endpoint& endpoint, const std::string& path)
+            {
+                return endpoint.tryGetSubpathBinarySuffix(path, size);
+            });
+}
+
+std::future<Storage::Data> Storage::get(
+        const arbiter::Endpoint& endpoint,
+        const std::string& path,
+        const std::size_t retries,
+        const Read read)
+{
+    Service& s(service());
+    std::shared_ptr<Get> op(
+            new Get(endpoint, path, retries ? retries : s.retries(), read));
+
+    std::future<Data> future(op->future());
+    s.submit(op);
+    return future;
+}
+
+void Storage::ensurePut(
+        const arbiter::Endpoint& endpoint,
+        const std::string& path,
+        const std::vector<char>& data)
+{
+    validate(data);
+
+    // Since we block until completion, the data need not be copied.
+    Service& s(service());
+    std::shared_ptr<Put> op(
+            new Put(
+                endpoint,
+                path,
+                s.retries(),
+                std::shared_ptr<const std::vector<char>>(
+                    &data,
+                    [](const std::vector<char>*) { })));
 
-    return data;
+    std::future<void> future(op->future());
+    s.submit(op);
+    future.get();
+}
+
+Storage::Data Storage::ensureGet(
+        const arbiter::Endpoint& endpoint,
+        const std::string& path)
+{
+    return get(endpoint, path).get();
 }
 
 } // namespace entwine
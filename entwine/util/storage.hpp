@@ -8,9 +8,18 @@
 *
 ******************************************************************************/
 
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
+#include <entwine/third/json/json.hpp>
+
 namespace arbiter
 {
     class Endpoint;
@@ -19,21 +28,86 @@ namespace arbiter
 namespace entwine
 {
 
+// Thrown when a storage request has persistently failed.
+class StorageError : public std::runtime_error
+{
+public:
+    StorageError(std::string what)
+        : std::runtime_error(what)
+    { }
+};
+
+// Requests run on a dedicated pool of I/O threads, with a bounded number
+// in flight per endpoint root.  Failed attempts are retried with jittered
+// exponential backoff, without holding a thread while waiting.  A GET that
+// is still running after the hedge delay is raced against a duplicate
+// request, and whichever completes first wins.
+//
+// When too many requests are outstanding, new requests block until some
+// complete.  The caller must keep the endpoint's Arbiter alive until each
+// request has completed.
 class Storage
 {
 public:
-    // Functions from this class perform exit(1) if they cannot perform the
-    // requested operation, as this indicates a fatal error with the underlying
-    // storage mechanism.
+    typedef std::unique_ptr<std::vector<char>> Data;
+
+    // Options, all optional, are:
+    //      threads:        I/O threads (default 8).
+    //      concurrency:    Requests in flight per endpoint root (default 8).
+    //      outstanding:    Requests queued or running before new requests
+    //                      block (default 64).
+    //      retries:        Attempts before failing (default 40).
+    //      hedge:          Seconds before a slow GET is hedged, or zero to
+    //                      disable hedging (default 2).
+    //
+    // Must be called before the first request, if at all.
+    static void configure(const Json::Value& json);
+
+    // The future throws StorageError if every attempt failed.
+    static std::future<void> put(
+            const arbiter::Endpoint& endpoint,
+            const std::string& path,
+            Data data);
+
+    // As above.  If _retries_ is zero, the configured value is used.
+    static std::future<Data> get(
+            const arbiter::Endpoint& endpoint,
+            const std::string& path,
+            std::size_t retries = 0);
+
+    // Reads only the bytes in [_begin_, _end_), which may be fewer than
+    // requested if the file ends first.
+    static std::future<Data> getRange(
+            const arbiter::Endpoint& endpoint,
+            const std::string& path,
+            std::size_t begin,
+            std::size_t end,
+            std::size_t retries = 0);
 
+    // Reads the final _size_ bytes, or the whole file if it is smaller.
+    static std::future<Data> getSuffix(
+            const arbiter::Endpoint& endpoint,
+            const std::string& path,
+            std::size_t size,
+            std::size_t retries = 0);
+
+    // Blocking versions of the above, which throw StorageError on failure.
     static void ensurePut(
             const arbiter::Endpoint& endpoint,
             const std::string& path,
             const std::vector<char>& data);
 
-    static std::unique_ptr<std::vector<char>> ensureGet(
+    static Data ensureGet(
             const arbiter::Endpoint& endpoint,
             const std::string& path);
+
+private:
+    static std::future<Data> get(
+            const arbiter::Endpoint& endpoint,
+            const std::string& path,
+            std::size_t retries,
+            std::function<
+                Data(const arbiter::Endpoint&, const std::string&)> read);
 };
 
 } // namespace entwine
@@ -0,0 +1,418 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/util/synthetic.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+
+#include <pdal/PointRef.hpp>
+#include <pdal/PointTable.hpp>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+
+namespace entwine
+{
+
+namespace
+{
+    const double pi(3.14159265358979323846);
+
+    const std::size_t numWaves(6);
+    const std::size_t numBuildings(64);
+    const std::size_t numClusters(16);
+
+    // ASPRS classification values.
+    const uint8_t unclassifiedClass(1);
+    const uint8_t groundClass(2);
+    const uint8_t buildingClass(6);
+
+    struct Sample
+    {
+        Sample() : u(0), v(0), w(0), intensity(0), classification(0) { }
+
+        // Coordinates normalized to the unit cube of the bounds.
+        double u;
+        double v;
+        double w;
+
+        uint16_t intensity;
+        uint8_t classification;
+    };
+
+    struct Wave
+    {
+        Wave(double fu, double fv, double pu, double pv, double amplitude)
+            : fu(fu), fv(fv), pu(pu), pv(pv), amplitude(amplitude)
+        { }
+
+        double fu, fv;
+        double pu, pv;
+        double amplitude;
+    };
+
+    struct Building
+    {
+        Building(double u, double v, double halfWidth, double top)
+            : minU(u - halfWidth)
+            , minV(v - halfWidth)
+            , maxU(u + halfWidth)
+            , maxV(v + halfWidth)
+            , top(top)
+        { }
+
+        double minU, minV;
+        double maxU, maxV;
+        double top;
+    };
+
+    struct Cluster
+    {
+        Cluster(double u, double v, double w, double sigma)
+            : u(u), v(v), w(w), sigma(sigma)
+        { }
+
+        double u, v, w;
+        double sigma;
+    };
+
+    double clamp(const double val)
+    {
+        return std::max(0.0, std::min(1.0, val));
+    }
+
+    // All features of a distribution are drawn up front, before any points,
+    // so that they depend only on the seed.
+    class Generator
+    {
+    public:
+        explicit Generator(const Synthetic& synthetic)
+            : m_distribution(synthetic.distribution())
+            , m_gen(synthetic.seed())
+            , m_unit(0, 1)
+            , m_normal(0, 1)
+            , m_waves()
+            , m_buildings()
+            , m_clusters()
+            , m_pickCluster()
+        {
+            for (std::size_t i(0); i < numWaves; ++i)
+            {
+                const double f(std::pow(2.0, i));
+
+                m_waves.emplace_back(
+                        f * (0.5 + unit()),
+                        f * (0.5 + unit()),
+                        2 * pi * unit(),
+                        2 * pi * unit(),
+                        std::pow(0.5, i));
+            }
+
+            for (std::size_t i(0); i < numBuildings; ++i)
+            {
+                const double halfWidth(0.005 + 0.02 * unit());
+                const double top(0.1 + 0.5 * unit());
+
+                m_buildings.emplace_back(
+                        halfWidth + (1 - 2 * halfWidth) * unit(),
+                        halfWidth + (1 - 2 * halfWidth) * unit(),
+                        halfWidth,
+                        top);
+            }
+
+            std::vector<double> weights;
+
+            for (std::size_t i(0); i < numClusters; ++i)
+            {
+                m_clusters.emplace_back(
+                        unit(),
+                        unit(),
+                        unit(),
+                        0.01 + 0.04 * unit());
+
+                weights.push_back(0.1 + unit());
+            }
+
+            m_pickCluster = std::discrete_distribution<std::size_t>(
+                    weights.begin(),
+                    weights.end());
+        }
+
+        void next(Sample& s)
+        {
+            switch (m_distribution)
+            {
+                case Synthetic::Distribution::Uniform:
+                    s.u = unit();
+                    s.v = unit();
+                    s.w = unit();
+                    s.intensity = intensity(32768);
+                    s.classification = unclassifiedClass;
+                    break;
+
+                case Synthetic::Distribution::Terrain:
+                    s.u = unit();
+                    s.v = unit();
+                    s.w = clamp(
+                            0.1 + 0.5 * surface(s.u, s.v) +
+                            0.002 * normal());
+                    s.intensity = intensity(1000 + 8000 * s.w);
+                    s.classification = groundClass;
+                    break;
+
+                case Synthetic::Distribution::Urban:
+                    if (unit() < 0.5) building(s);
+                    else
+                    {
+                        s.u = unit();
+                        s.v = unit();
+                        s.w = base(s.u, s.v);
+                        s.intensity = intensity(2000);
+                        s.classification = groundClass;
+                    }
+                    break;
+
+                case Synthetic::Distribution::Clustered:
+                {
+                    const Cluster& c(m_clusters[m_pickCluster(m_gen)]);
+                    s.u = clamp(c.u + c.sigma * normal());
+                    s.v = clamp(c.v + c.sigma * normal());
+                    s.w = clamp(c.w + c.sigma * normal());
+                    s.intensity = intensity(16384);
+                    s.classification = unclassifiedClass;
+                    break;
+                }
+            }
+        }
+
+    private:
+        double unit() { return m_unit(m_gen); }
+        double normal() { return m_normal(m_gen); }
+
+        uint16_t intensity(const double mean)
+        {
+            return std::max(0.0, std::min(65535.0, mean + 500 * normal()));
+        }
+
+        // A smooth surface in [0, 1] over the unit square.
+        double surface(const double u, const double v) const
+        {
+            double sum(0);
+            double total(0);
+
+            for (const Wave& wave : m_waves)
+            {
+                sum +=
+                    wave.amplitude *
+                    std::sin(2 * pi * wave.fu * u + wave.pu) *
+                    std::cos(2 * pi * wave.fv * v + wave.pv);
+
+                total += wave.amplitude;
+            }
+
+            return (sum / total + 1) / 2;
+        }
+
+        // The nearly flat ground of the urban distribution.
+        double base(const double u, const double v) const
+        {
+            return 0.05 * surface(u, v);
+        }
+
+        // A point on the roof or on a wall of a random building.
+        void building(Sample& s)
+        {
+            const Building& b(m_buildings[unit() * m_buildings.size()]);
+
+            if (unit() < 0.7)
+            {
+                s.u = b.minU + (b.maxU - b.minU) * unit();
+                s.v = b.minV + (b.maxV - b.minV) * unit();
+                s.w = b.top;
+            }
+            else
+            {
+                const double t(unit());
+
+                const double u(b.minU + t * (b.maxU - b.minU));
+                const double v(b.minV + t * (b.maxV - b.minV));
+
+                switch (static_cast<int>(unit() * 4))
+                {
+                    case 0:     s.u = b.minU;   s.v = v;        break;
+                    case 1:     s.u = b.maxU;   s.v = v;        break;
+                    case 2:     s.u = u;        s.v = b.minV;   break;
+                    default:    s.u = u;        s.v = b.maxV;   break;
+                }
+
+                const double floor(base(s.u, s.v));
+                s.w = floor + (b.top - floor) * unit();
+            }
+
+            s.intensity = intensity(20000);
+            s.classification = buildingClass;
+        }
+
+        const Synthetic::Distribution m_distribution;
+
+        std::mt19937_64 m_gen;
+        std::uniform_real_distribution<double> m_unit;
+        std::normal_distribution<double> m_normal;
+
+        std::vector<Wave> m_waves;
+        std::vector<Building> m_buildings;
+        std::vector<Cluster> m_clusters;
+        std::discrete_distribution<std::size_t> m_pickCluster;
+    };
+}
+
+Synthetic::Synthetic(
+        const Distribution distribution,
+        const std::size_t numPoints,
+        const BBox& bbox,
+        const std::size_t seed)
+    : m_distribution(distribution)
+    , m_numPoints(numPoints)
+    , m_bbox(bbox)
+    , m_seed(seed)
+{ }
+
+Synthetic::Synthetic(const Json::Value& json)
+    : m_distribution(toDistribution(json["distribution"].asString()))
+    , m_numPoints(json["points"].asUInt64())
+    , m_bbox(json["bounds"])
+    , m_seed(json["seed"].asUInt64())
+{ }
+
+std::unique_ptr<Synthetic> Synthetic::create(const std::string path)
+{
+    std::ifstream file(path, std::ifstream::in | std::ifstream::binary);
+
+    if (!file.good())
+    {
+        throw std::runtime_error("Could not open " + path);
+    }
+
+    const std::string data(
+            (std::istreambuf_iterator<char>(file)),
+            std::istreambuf_iterator<char>());
+
+    Json::Reader reader;
+    Json::Value json;
+
+    if (!reader.parse(data, json, false))
+    {
+        throw std::runtime_error(
+                "Invalid synthetic source " + path + ": " +
+                reader.getFormattedErrorMessages());
+    }
+
+    return std::unique_ptr<Synthetic>(new Synthetic(json));
+}
+
+bool Synthetic::is(const std::string path)
+{
+    return arbiter::Arbiter::getExtension(path) == "synthetic";
+}
+
+Synthetic::Distribution Synthetic::toDistribution(const std::string name)
+{
+    if (name == "uniform")          return Distribution::Uniform;
+    else if (name == "terrain")     return Distribution::Terrain;
+    else if (name == "urban")       return Distribution::Urban;
+    else if (name == "clustered")   return Distribution::Clustered;
+    else throw std::runtime_error("Invalid synthetic distribution: " + name);
+}
+
+std::string Synthetic::toString(const Distribution distribution)
+{
+    switch (distribution)
+    {
+        case Distribution::Uniform:     return "uniform";
+        case Distribution::Terrain:     return "terrain";
+        case Distribution::Urban:       return "urban";
+        case Distribution::Clustered:   return "clustered";
+    }
+
+    throw std::runtime_error("Invalid synthetic distribution");
+}
+
+Json::Value Synthetic::toJson() const
+{
+    Json::Value json;
+    json["distribution"] = toString(m_distribution);
+    json["points"] = static_cast<Json::UInt64>(m_numPoints);
+    json["bounds"] = m_bbox.toJson();
+    json["seed"] = static_cast<Json::UInt64>(m_seed);
+    return json;
+}
+
+std::vector<std::string> Synthetic::dimNames()
+{
+    return std::vector<std::string> {
+        "X", "Y", "Z", "Intensity", "Classification"
+    };
+}
+
+void Synthetic::run(pdal::StreamPointTable& table) const
+{
+    namespace DimId = pdal::Dimension::Id;
+
+    const pdal::PointLayout& layout(*table.layout());
+    const bool hasIntensity(layout.hasDim(DimId::Intensity));
+    const bool hasClassification(layout.hasDim(DimId::Classification));
+
+    const Point& min(m_bbox.min());
+    const double width(m_bbox.width());
+    const double depth(m_bbox.depth());
+    const double height(m_bbox.height());
+
+    Generator generator(*this);
+    Sample sample;
+
+    pdal::PointRef pointRef(table, 0);
+    const std::size_t capacity(table.capacity());
+    std::size_t i(0);
+
+    for (std::size_t n(0); n < m_numPoints; ++n)
+    {
+        generator.next(sample);
+
+        pointRef.setPointId(i);
+        pointRef.setField(DimId::X, min.x + sample.u * width);
+        pointRef.setField(DimId::Y, min.y + sample.v * depth);
+        pointRef.setField(DimId::Z, min.z + sample.w * height);
+
+        if (hasIntensity)
+        {
+            pointRef.setField(DimId::Intensity, sample.intensity);
+        }
+
+        if (hasClassification)
+        {
+            pointRef.setField(DimId::Classification, sample.classification);
+        }
+
+        if (++i == capacity)
+        {
+            table.reset();
+            i = 0;
+        }
+    }
+
+    if (i) table.reset();
+}
+
+} // namespace entwine
+
@@ -0,0 +1,93 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <entwine/third/json/json.hpp>
+#include <entwine/types/bbox.hpp>
+
+namespace pdal
+{
+    class StreamPointTable;
+}
+
+namespace entwine
+{
+
+// A point cloud source generated in memory rather than read through PDAL, so
+// that indexing may be measured without input decoding costs.  A source is
+// described by a small JSON file with the extension ".synthetic":
+//
+//      {
+//          "distribution": "terrain",
+//          "points": 1000000,
+//          "bounds": [xmin, ymin, zmin, xmax, ymax, zmax],
+//          "seed": 0
+//      }
+//
+// The same descriptor always generates the same points.  Synthetic sources
+// have no spatial reference and are never reprojected.
+class Synthetic
+{
+public:
+    enum class Distribution
+    {
+        Uniform,    // Uniformly filling the bounds.
+        Terrain,    // A single smooth surface over XY.
+        Urban,      // Nearly flat ground with tall box-shaped structures.
+        Clustered   // Gaussian clusters of varying density.
+    };
+
+    Synthetic(
+            Distribution distribution,
+            std::size_t numPoints,
+            const BBox& bbox,
+            std::size_t seed = 0);
+
+    explicit Synthetic(const Json::Value& json);
+
+    // Read a descriptor from a local file.
+    static std::unique_ptr<Synthetic> create(std::string path);
+
+    // True if this path names a synthetic descriptor.
+    static bool is(std::string path);
+
+    static Distribution toDistribution(std::string name);
+    static std::string toString(Distribution distribution);
+
+    Json::Value toJson() const;
+
+    Distribution distribution() const   { return m_distribution; }
+    std::size_t numPoints() const       { return m_numPoints; }
+    const BBox& bbox() const            { return m_bbox; }
+    std::size_t seed() const            { return m_seed; }
+
+    // The dimensions written for each point.  Dimensions absent from the
+    // table layout are skipped.
+    static std::vector<std::string> dimNames();
+
+    // Write all points into the table, resetting it after each full block
+    // exactly as a streaming PDAL reader would.
+    void run(pdal::StreamPointTable& table) const;
+
+private:
+    Distribution m_distribution;
+    std::size_t m_numPoints;
+    BBox m_bbox;
+    std::size_t m_seed;
+};
+
+} // namespace entwine
+
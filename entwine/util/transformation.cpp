@@ -0,0 +1,147 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/util/transformation.hpp>
+
+#include <stdexcept>
+
+#include <gdal_version.h>
+#include <ogr_spatialref.h>
+#include <ogr_srs_api.h>
+
+#include <entwine/types/reprojection.hpp>
+
+namespace entwine
+{
+
+namespace
+{
+    void setSrs(OGRSpatialReference& ref, const std::string& srs)
+    {
+        if (ref.SetFromUserInput(srs.c_str()) != OGRERR_NONE)
+        {
+            throw std::runtime_error("Could not parse SRS: " + srs);
+        }
+
+#if GDAL_VERSION_MAJOR >= 3
+        ref.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+#endif
+    }
+
+    void destroy(OGRCoordinateTransformation* transform)
+    {
+        OCTDestroyCoordinateTransformation(
+                reinterpret_cast<OGRCoordinateTransformationH>(transform));
+    }
+}
+
+Transformation::Transformation(const Reprojection& reprojection)
+    : m_transform(nullptr, destroy)
+    , m_success()
+{
+    if (reprojection.in().empty())
+    {
+        throw std::runtime_error("No default SRS supplied, and none inferred");
+    }
+
+    OGRSpatialReference in;
+    OGRSpatialReference out;
+
+    setSrs(in, reprojection.in());
+    setSrs(out, reprojection.out());
+
+    m_transform.reset(OGRCreateCoordinateTransformation(&in, &out));
+
+    if (!m_transform)
+    {
+        throw std::runtime_error(
+                "Could not create transformation from " + reprojection.in() +
+                " to " + reprojection.out());
+    }
+}
+
+Transformation::~Transformation()
+{ }
+
+void Transformation::transform(
+        std::vector<double>& x,
+        std::vector<double>& y,
+        std::vector<double>& z)
+{
+    if (x.size() != y.size() || x.size() != z.size())
+    {
+        throw std::runtime_error("Mismatched transformation batch sizes");
+    }
+
+    if (x.empty()) return;
+
+    m_success.resize(x.size());
+
+    if (!m_transform->Transform(
+                x.size(), x.data(), y.data(), z.data(), m_success.data()))
+    {
+        for (std::size_t i(0); i < m_success.size(); ++i)
+        {
+            if (!m_success[i])
+            {
+                throw std::runtime_error(
+                        "Could not reproject point (" +
+                        std::to_string(x[i]) + ", " +
+                        std::to_string(y[i]) + ", " +
+                        std::to_string(z[i]) + ")");
+            }
+        }
+    }
+}
+
+TransformationCache::TransformationCache()
+    : m_idle()
+    , m_mutex()
+{ }
+
+TransformationCache::~TransformationCache()
+{ }
+
+UniqueTransformation TransformationCache::acquire(
+        const Reprojection& reprojection)
+{
+    const Key key(reprojection.in(), reprojection.out());
+    Transformation* transformation(nullptr);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto& idle(m_idle[key]);
+
+    if (!idle.empty())
+    {
+        transformation = idle.back().release();
+        idle.pop_back();
+    }
+
+    lock.unlock();
+
+    if (!transformation) transformation = new Transformation(reprojection);
+
+    return UniqueTransformation(
+            transformation,
+            [this, key](Transformation* t) { release(key, t); });
+}
+
+void TransformationCache::release(
+        const Key& key,
+        Transformation* transformation)
+{
+    std::unique_ptr<Transformation> owned(transformation);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_idle[key].push_back(std::move(owned));
+}
+
+} // namespace entwine
+
@@ -0,0 +1,86 @@
+/******************************************************************************
+* Copyright (c) 2016, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+class OGRCoordinateTransformation;
+
+namespace entwine
+{
+
+class Reprojection;
+
+// A single coordinate transformation from one SRS to another.  Instances are
+// not thread-safe, so each one should only be used by a single thread at a
+// time - see TransformationCache.
+class Transformation
+{
+public:
+    Transformation(const Reprojection& reprojection);
+    ~Transformation();
+
+    // Transform these coordinates in place as a single batch.  The vectors
+    // must be the same size.  Throws if any point cannot be transformed.
+    void transform(
+            std::vector<double>& x,
+            std::vector<double>& y,
+            std::vector<double>& z);
+
+private:
+    std::unique_ptr<
+        OGRCoordinateTransformation,
+        std::function<void(OGRCoordinateTransformation*)>> m_transform;
+
+    std::vector<int> m_success;
+
+    Transformation(const Transformation&);
+    Transformation& operator=(const Transformation&);
+};
+
+typedef std::unique_ptr<
+    Transformation,
+    std::function<void(Transformation*)>> UniqueTransformation;
+
+// Keeps idle Transformation instances keyed by their (in, out) SRS pair, so
+// we only pay for their setup once per pair per thread rather than once per
+// file.
+class TransformationCache
+{
+public:
+    TransformationCache();
+    ~TransformationCache();
+
+    // The result is owned exclusively by the caller, and is returned to this
+    // cache for reuse when it goes out of scope.  This cache must outlive all
+    // transformations acquired from it.
+    UniqueTransformation acquire(const Reprojection& reprojection);
+
+private:
+    typedef std::pair<std::string, std::string> Key;
+
+    void release(const Key& key, Transformation* transformation);
+
+    std::map<Key, std::vector<std::unique_ptr<Transformation>>> m_idle;
+    std::mutex m_mutex;
+
+    TransformationCache(const TransformationCache&);
+    TransformationCache& operator=(const TransformationCache&);
+};
+
+} // namespace entwine
+
@@ -10,19 +10,30 @@
 
 #include "entwine.hpp"
 
+#include <atomic>
 #include <chrono>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include <entwine/third/arbiter/arbiter.hpp>
 #include <entwine/tree/builder.hpp>
+#include <entwine/tree/chunk.hpp>
 #include <entwine/tree/config-parser.hpp>
+#include <entwine/tree/coordinator.hpp>
+#include <entwine/tree/merger.hpp>
 #include <entwine/types/bbox.hpp>
 #include <entwine/types/reprojection.hpp>
 #include <entwine/types/schema.hpp>
 #include <entwine/types/structure.hpp>
 #include <entwine/types/subset.hpp>
+#include <entwine/util/metrics.hpp>
+#include <entwine/util/storage.hpp>
 
 using namespace entwine;
 
@@ -111,6 +122,10 @@ namespace
             "\t\tDo not trust file headers when determining bounds.  By\n"
             "\t\tdefault, the headers are considered to be good.\n\n"
 
+            "\t-c <inference cache path>\n"
+            "\t\tIf inference is required, persist per-file results to\n"
+            "\t\tthis file so later builds only examine changed files.\n\n"
+
             "\t-s <subset-number> <subset-total>\n"
             "\t\tBuild only a portion of the index.  If output paths are\n"
             "\t\tall the same, 'merge' should be run after all subsets are\n"
@@ -119,7 +134,88 @@ namespace
             "\t\tsubset-number - One-based subset ID in range\n"
             "\t\t[1, subset-total].\n\n"
             "\t\tsubset-total - Total number of subsets that will be built.\n"
-            "\t\tMust be a binary power.\n\n";
+            "\t\tMust be a binary power, unless -d is specified.\n\n"
+
+            "\t-d\n"
+            "\t\tBalance subsets by point density, estimated from the\n"
+            "\t\tinferred bounds and point counts of each file, rather than\n"
+            "\t\tsplitting the bounds evenly.  Every subset of a build must\n"
+            "\t\tuse the same input and this flag.\n\n"
+
+            "\t-w <lease directory>\n"
+            "\t\tJoin a coordinated build as a worker.  Ranges of the\n"
+            "\t\tmanifest are claimed from this directory, which must be\n"
+            "\t\ton a filesystem shared by all workers, and work is handed\n"
+            "\t\toff to idle workers as they join or finish.  All workers\n"
+            "\t\tshould use the same configuration.\n\n"
+
+            "\t-n <local workers>\n"
+            "\t\tWith -w, coordinate the build: initialize the lease\n"
+            "\t\tdirectory, launch this many local worker processes, and\n"
+            "\t\tmerge the results once all work is done.  Workers on other\n"
+            "\t\thosts may attach at any time with -w.\n\n"
+
+            "\t-M <metrics path>\n"
+            "\t\tPeriodically write build metrics to this local file, as\n"
+            "\t\tPrometheus text if it ends in '.prom' or as JSON\n"
+            "\t\totherwise.  Coordinated workers each write their own file,\n"
+            "\t\tnamed with their worker name.\n\n"
+
+            "\t-T\n"
+            "\t\tWith -M, also record timed stages as trace events,\n"
+            "\t\tappended to the metrics path with a '.trace' suffix.\n\n";
+    }
+
+    // Start writing metrics if a metrics path is configured.  A non-empty
+    // _worker_ name is inserted before the extension of the path.
+    std::unique_ptr<MetricsWriter> startMetrics(
+            const Json::Value& json,
+            const std::string worker = "")
+    {
+        std::unique_ptr<MetricsWriter> writer;
+
+        const Json::Value& metrics(json["metrics"]);
+        if (!metrics["path"].isString()) return writer;
+
+        std::string path(metrics["path"].asString());
+
+        if (!worker.empty())
+        {
+            const std::size_t dot(path.find_last_of('.'));
+            const std::size_t slash(path.find_last_of('/'));
+
+            if (
+                    dot != std::string::npos &&
+                    (slash == std::string::npos || dot > slash))
+            {
+                path.insert(dot, "." + worker);
+            }
+            else
+            {
+                path += "." + worker;
+            }
+        }
+
+        Metrics::trace(metrics["trace"].asBool());
+
+        writer.reset(
+                new MetricsWriter(
+                    path,
+                    metrics.isMember("interval") ?
+                        metrics["interval"].asUInt64() : 10));
+
+        return writer;
+    }
+
+    // Gauges which depend on the configuration of the build.
+    void addBuildGauges(const Builder& builder)
+    {
+        const std::size_t pointSize(builder.schema().pointSize());
+
+        Metrics::gauge(
+                "entwine_chunk_bytes_resident",
+                "Approximate point data bytes of chunks held in memory",
+                [pointSize]() { return Chunk::getChunkMem() * pointSize; });
     }
 
     std::string getDimensionString(const Schema& schema)
@@ -173,6 +269,219 @@ namespace
         }
     }
 
+    const std::chrono::seconds poll(1);
+
+    // Leases not renewed within this many seconds are presumed abandoned.
+    const std::size_t leaseSeconds(60);
+
+    // Claim and build manifest splits until every split of the coordinated
+    // build is complete, handing off half of our remaining work whenever
+    // another worker is idle.
+    void work(
+            const Json::Value& json,
+            const Json::Value& arbiterConfig,
+            const std::string leaseDir)
+    {
+        auto arbiter(
+                std::make_shared<entwine::arbiter::Arbiter>(arbiterConfig));
+
+        Coordinator coordinator(leaseDir, Coordinator::workerName());
+        auto metrics(startMetrics(json, Coordinator::workerName()));
+
+        while (true)
+        {
+            std::unique_ptr<Manifest::Split> split(coordinator.claim());
+
+            if (!split)
+            {
+                if (coordinator.complete()) return;
+
+                coordinator.hungry(true);
+                std::this_thread::sleep_for(poll);
+                continue;
+            }
+
+            coordinator.hungry(false);
+
+            std::cout << "Claimed split [" << split->begin() << ", " <<
+                split->end() << ")" << std::endl;
+
+            std::unique_ptr<Manifest> manifest(
+                    ConfigParser::getManifest(json, *arbiter));
+
+            manifest->split(split->begin(), split->end());
+
+            std::unique_ptr<Builder> builder(
+                    ConfigParser::getBuilder(
+                        json,
+                        arbiter,
+                        std::move(manifest)));
+
+            addBuildGauges(*builder);
+
+            std::atomic_bool done(false);
+            std::atomic_bool lost(false);
+
+            std::thread monitor([&]()
+            {
+                auto lose([&]()
+                {
+                    std::cout << "Lease lost - aborting" << std::endl;
+                    lost = true;
+                    builder->abort();
+                });
+
+                while (!done)
+                {
+                    std::this_thread::sleep_for(poll);
+
+                    if (!coordinator.renew()) return lose();
+
+                    if (coordinator.othersHungry())
+                    {
+                        if (auto remainder = builder->takeWork())
+                        {
+                            std::cout << "Handing off [" <<
+                                remainder->begin() << ", " <<
+                                remainder->end() << ")" << std::endl;
+
+                            if (!coordinator.handOff(*remainder))
+                            {
+                                return lose();
+                            }
+                        }
+                    }
+                }
+            });
+
+            try
+            {
+                builder->go();
+            }
+            catch (...)
+            {
+                done = true;
+                monitor.join();
+                throw;
+            }
+
+            done = true;
+            monitor.join();
+
+            if (!lost) coordinator.finish();
+        }
+    }
+
+    void coordinate(
+            const Json::Value& json,
+            const Json::Value& arbiterConfig,
+            const std::string leaseDir,
+            const std::size_t localWorkers)
+    {
+        if (!localWorkers)
+        {
+            work(json, arbiterConfig, leaseDir);
+            return;
+        }
+
+        Coordinator coordinator(leaseDir, Coordinator::workerName());
+
+        {
+            entwine::arbiter::Arbiter arbiter(arbiterConfig);
+            std::unique_ptr<Manifest> manifest(
+                    ConfigParser::getManifest(json, arbiter));
+
+            if (!manifest)
+            {
+                throw std::runtime_error(
+                        "Coordinated builds require an input manifest");
+            }
+
+            if (coordinator.init(manifest->size(), localWorkers))
+            {
+                std::cout << "Coordinating " << manifest->size() <<
+                    " files in " << leaseDir << std::endl;
+            }
+            else
+            {
+                std::cout << "Attaching to coordinated build in " <<
+                    leaseDir << std::endl;
+            }
+        }
+
+        std::vector<pid_t> children;
+
+        for (std::size_t i(0); i < localWorkers; ++i)
+        {
+            const pid_t pid(fork());
+
+            if (pid < 0) throw std::runtime_error("Could not launch worker");
+
+            if (!pid)
+            {
+                int status(0);
+
+                try
+                {
+                    work(json, arbiterConfig, leaseDir);
+                }
+                catch (std::exception& e)
+                {
+                    std::cout << "Worker error: " << e.what() << std::endl;
+                    status = 1;
+                }
+
+                _exit(status);
+            }
+
+            children.push_back(pid);
+        }
+
+        // Wait for all work to complete, returning abandoned work to the
+        // pending set.  Workers on other hosts may still be contributing
+        // after our local workers have exited.
+        std::size_t running(children.size());
+
+        while (!coordinator.complete())
+        {
+            coordinator.reclaim(leaseSeconds);
+
+            while (running && waitpid(-1, nullptr, WNOHANG) > 0) --running;
+
+            if (!running && !coordinator.numActive())
+            {
+                throw std::runtime_error(
+                        "All local workers exited with work remaining");
+            }
+
+            std::this_thread::sleep_for(poll);
+        }
+
+        while (running && waitpid(-1, nullptr, 0) > 0) --running;
+
+        std::cout << "All " << coordinator.numDone() << " splits done." <<
+            std::endl;
+
+        if (json.isMember("subset"))
+        {
+            std::cout << "Subset complete - merge once all subsets are " <<
+                "built." << std::endl;
+            return;
+        }
+
+        const std::string outPath(json["output"]["path"].asString());
+        const std::size_t threads(json["input"]["threads"].asUInt64());
+
+        auto arbiter(
+                std::make_shared<entwine::arbiter::Arbiter>(arbiterConfig));
+
+        Merger merger(outPath, threads, arbiter);
+
+        std::cout << "Merging " << outPath << "..." << std::endl;
+        merger.go();
+        std::cout << "Done." << std::endl;
+    }
+
     const Json::Value defaults(([]()
     {
         Json::Value json;
@@ -222,6 +531,9 @@ void Kernel::build(std::vector<std::string> args)
     Json::Value json(defaults);
     std::string user;
     bool sse(false);
+    bool balanced(false);
+    std::string leaseDir;
+    std::size_t localWorkers(0);
 
     std::size_t a(0);
 
@@ -297,10 +609,23 @@ void Kernel::build(std::vector<std::string> args)
                 throw std::runtime_error("Invalid bbox: " + str);
             }
         }
+        else if (arg == "-c")
+        {
+            if (++a < args.size())
+            {
+                json["input"]["inferenceCache"] = args[a];
+            }
+            else
+            {
+                throw std::runtime_error("Invalid inference cache path");
+            }
+        }
         else if (arg == "-f") { json["output"]["force"] = true; }
         else if (arg == "-x") { json["input"]["trustHeaders"] = false; }
         else if (arg == "-e") { sse = true; }
         else if (arg == "-p") { json["structure"]["prefixIds"] = true; }
+        else if (arg == "-d") { balanced = true; }
+        else if (arg == "-T") { json["metrics"]["trace"] = true; }
         else if (arg == "-h")
         {
             json["geometry"]["reproject"]["hammer"] = true;
@@ -360,6 +685,39 @@ void Kernel::build(std::vector<std::string> args)
         {
             json["geometry"]["reproject"]["hammer"] = true;
         }
+        else if (arg == "-w")
+        {
+            if (++a < args.size())
+            {
+                leaseDir = args[a];
+            }
+            else
+            {
+                throw std::runtime_error("Invalid lease directory argument");
+            }
+        }
+        else if (arg == "-M")
+        {
+            if (++a < args.size())
+            {
+                json["metrics"]["path"] = args[a];
+            }
+            else
+            {
+                throw std::runtime_error("Invalid metrics path argument");
+            }
+        }
+        else if (arg == "-n")
+        {
+            if (++a < args.size())
+            {
+                localWorkers = std::stoul(args[a]);
+            }
+            else
+            {
+                throw std::runtime_error("Invalid worker count argument");
+            }
+        }
         else if (arg == "-m")
         {
             if (a + 2 < args.size())
@@ -406,10 +764,50 @@ void Kernel::build(std::vector<std::string> args)
         ++a;
     }
 
+    if (balanced)
+    {
+        if (!json.isMember("subset"))
+        {
+            throw std::runtime_error("Balancing requires a subset");
+        }
+
+        json["subset"]["balanced"] = true;
+    }
+
     Json::Value arbiterConfig(json["arbiter"]);
     arbiterConfig["s3"]["profile"] = user;
     if (sse) arbiterConfig["s3"]["sse"] = true;
 
+    // Chunk storage and input reads share the HTTP connection pool, and
+    // hedged reads may briefly double the number of storage requests.
+    if (!arbiterConfig["http"].isMember("concurrent"))
+    {
+        const Json::Value& storage(json["storage"]);
+        const Json::UInt64 storageThreads(
+                storage.isMember("threads") ?
+                    storage["threads"].asUInt64() : 8);
+
+        arbiterConfig["http"]["concurrent"] = std::max<Json::UInt64>(
+                32,
+                storageThreads * 2 + json["input"]["threads"].asUInt64());
+    }
+
+    Storage::configure(json["storage"]);
+
+    if (!leaseDir.empty())
+    {
+        if (split) throw std::runtime_error("Cannot combine -m with -w");
+
+        coordinate(json, arbiterConfig, leaseDir, localWorkers);
+        return;
+    }
+    else if (localWorkers)
+    {
+        throw std::runtime_error("Local workers require a lease directory");
+    }
+
+    auto metrics(startMetrics(json));
+
     auto arbiter(std::make_shared<entwine::arbiter::Arbiter>(arbiterConfig));
 
     std::unique_ptr<Manifest> manifest(
@@ -420,6 +818,8 @@ void Kernel::build(std::vector<std::string> args)
     std::unique_ptr<Builder> builder(
             ConfigParser::getBuilder(json, arbiter, std::move(manifest)));
 
+    addBuildGauges(*builder);
+
     if (builder->isContinuation())
     {
         std::cout << "\nContinuing previous index..." << std::endl;
@@ -44,6 +44,11 @@ namespace
             "\t\twhen one can be found from the file header, set the '-h'\n"
             "\t\tflag.\n\n"
 
+            "\t-c <cache-path>\n"
+            "\t\tIf provided, per-file inference results are persisted to\n"
+            "\t\tthis file.  Subsequent inferences using the same cache\n"
+            "\t\twill only examine files that are new or have changed.\n\n"
+
             "\t-o <output-path>\n"
             "\t\tIf provided, detailed per-file information will be written\n"
             "\t\tto this file in JSON format.\n\n"
@@ -128,6 +133,7 @@ void Kernel::infer(std::vector<std::string> args)
     bool trustHeaders(true);
 
     std::string output;
+    std::string cachePath;
 
     std::size_t a(0);
 
@@ -160,6 +166,17 @@ void Kernel::infer(std::vector<std::string> args)
                 throw std::runtime_error("Invalid tmp specification");
             }
         }
+        else if (arg == "-c")
+        {
+            if (++a < args.size())
+            {
+                cachePath = args[a];
+            }
+            else
+            {
+                throw std::runtime_error("Invalid cache specification");
+            }
+        }
         else if (arg == "-o")
         {
             if (++a < args.size())
@@ -250,6 +267,10 @@ void Kernel::infer(std::vector<std::string> args)
     std::cout << "\tThreads: " << threads << std::endl;
     std::cout << "\tReprojection: " << reprojString << std::endl;
     std::cout << "\tTrust file headers? " << trustHeadersString << std::endl;
+    if (cachePath.size())
+    {
+        std::cout << "\tInference cache: " << cachePath << std::endl;
+    }
 
     Inference inference(
             path,
@@ -258,7 +279,8 @@ void Kernel::infer(std::vector<std::string> args)
             true,
             reprojection.get(),
             trustHeaders,
-            arbiter.get());
+            arbiter.get(),
+            cachePath);
 
     inference.go();
 
@@ -27,7 +27,11 @@ namespace
             "\tOptions:\n"
 
             "\t\t-u <aws-user>\n"
-            "\t\t\tSpecify AWS credential user, if not default\n";
+            "\t\t\tSpecify AWS credential user, if not default\n"
+
+            "\t\t-w <workers>\n"
+            "\t\t\tSubsets to load concurrently (default 2).  Each one\n"
+            "\t\t\tkeeps up to two subsets in memory at once.\n";
     }
 }
 
@@ -45,6 +49,7 @@ void Kernel::merge(std::vector<std::string> args)
 
     std::size_t a(1);
     std::size_t threads(1);
+    std::size_t workers(2);
 
     while (a < args.size())
     {
@@ -73,6 +78,18 @@ void Kernel::merge(std::vector<std::string> args)
             }
         }
 
+        else if (arg == "-w")
+        {
+            if (++a < args.size())
+            {
+                workers = std::stoul(args[a]);
+            }
+            else
+            {
+                throw std::runtime_error("Invalid workers argument");
+            }
+        }
+
         ++a;
     }
 
@@ -81,7 +98,7 @@ void Kernel::merge(std::vector<std::string> args)
 
     auto arbiter(std::make_shared<entwine::arbiter::Arbiter>(arbiterConfig));
 
-    Merger merger(path, threads, arbiter);
+    Merger merger(path, threads, arbiter, workers);
 
     std::cout << "Merging " << path << "..." << std::endl;
     merger.go();